@@ -11,10 +11,10 @@
 		    public int posY;
 		    public int posZ;
 
-            public uint structureLastChanged;
-            public uint propertiesLastChanged;
-            public uint meshLastChanged;
-            public uint nodeOrChildrenLastChanged;
+            public ulong structureLastChanged;
+            public ulong propertiesLastChanged;
+            public ulong meshLastChanged;
+            public ulong nodeOrChildrenLastChanged;
 
 		    public uint childHandle000;
             public uint childHandle001;
@@ -27,7 +27,7 @@ namespace Cubiquity
 			const int CU_OK = 0;
 			
 			const uint requiredMajorVersion = 1;
-			const uint requiredMinorVersion = 3;
+			const uint requiredMinorVersion = 4;
 			const uint requiredPatchVersion = 0;
             const uint requiredBuildVersion = 0;
 			
@@ -166,6 +166,15 @@ namespace Cubiquity
                 return isUpToDate != 0;
 			}
 			
+			[DllImport (dllToImport)]
+			private static extern int cuUpdateVolumeWithBudget(uint volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint budgetInMicroseconds, out uint isUpToDate);
+			public static bool UpdateVolumeWithBudget(uint volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint budgetInMicroseconds)
+			{
+                uint isUpToDate;
+                Validate(cuUpdateVolumeWithBudget(volumeHandle, eyePosX, eyePosY, eyePosZ, lodThreshold, budgetInMicroseconds, out isUpToDate));
+                return isUpToDate != 0;
+			}
+			
 			[DllImport (dllToImport)]
 			private static extern int cuGetEnclosingRegion(uint volumeHandle, out int lowerX, out int lowerY, out int lowerZ, out int upperX, out int upperY, out int upperZ);	
 			public static void GetEnclosingRegion(uint volumeHandle, out int lowerX, out int lowerY, out int lowerZ, out int upperX, out int upperY, out int upperZ)
@@ -173,6 +182,97 @@ namespace Cubiquity
 				Validate(cuGetEnclosingRegion(volumeHandle, out lowerX, out lowerY, out lowerZ, out upperX, out upperY, out upperZ));
 			}
 			
+			[DllImport (dllToImport)]
+			private static extern int cuSetVolumeMemoryBudget(uint volumeHandle, ulong memoryBudgetInBytes);
+			public static void SetVolumeMemoryBudget(uint volumeHandle, ulong memoryBudgetInBytes)
+			{
+				Validate(cuSetVolumeMemoryBudget(volumeHandle, memoryBudgetInBytes));
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuGetVolumeMemoryUsage(uint volumeHandle, out ulong result);
+			public static ulong GetVolumeMemoryUsage(uint volumeHandle)
+			{
+				ulong result;
+				Validate(cuGetVolumeMemoryUsage(volumeHandle, out result));
+				return result;
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuSetPrefetchLookAhead(uint volumeHandle, float lookAheadInSeconds);
+			public static void SetPrefetchLookAhead(uint volumeHandle, float lookAheadInSeconds)
+			{
+				Validate(cuSetPrefetchLookAhead(volumeHandle, lookAheadInSeconds));
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuGetPagingCounters(uint volumeHandle, out ulong noOfHits, out ulong noOfMisses, out ulong noOfPrefetchedChunks);
+			public static void GetPagingCounters(uint volumeHandle, out ulong noOfHits, out ulong noOfMisses, out ulong noOfPrefetchedChunks)
+			{
+				Validate(cuGetPagingCounters(volumeHandle, out noOfHits, out noOfMisses, out noOfPrefetchedChunks));
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuSetVolumeCompressedCacheBudget(uint volumeHandle, ulong compressedCacheBudgetInBytes);
+			public static void SetVolumeCompressedCacheBudget(uint volumeHandle, ulong compressedCacheBudgetInBytes)
+			{
+				Validate(cuSetVolumeCompressedCacheBudget(volumeHandle, compressedCacheBudgetInBytes));
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuGetCompressedCacheCounters(uint volumeHandle, out ulong noOfHits, out ulong sizeInBytes);
+			public static void GetCompressedCacheCounters(uint volumeHandle, out ulong noOfHits, out ulong sizeInBytes)
+			{
+				Validate(cuGetCompressedCacheCounters(volumeHandle, out noOfHits, out sizeInBytes));
+			}
+			
+			// Matches CuMemoryPressureCallback. Note that it can be called from Cubiquity's background threads, so it must not use the Unity API.
+			[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+			public delegate void MemoryPressureCallback(uint reason, ulong usageInBytes, ulong limitInBytes, IntPtr userData);
+			
+			// The native code only holds a function pointer, so we keep the delegate alive here.
+			private static MemoryPressureCallback memoryPressureCallback;
+			
+			[DllImport (dllToImport)]
+			private static extern int cuSetProcessMemoryLimit(ulong limitInBytes);
+			public static void SetProcessMemoryLimit(ulong limitInBytes)
+			{
+				Validate(cuSetProcessMemoryLimit(limitInBytes));
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuGetProcessMemoryUsage(out ulong result);
+			public static ulong GetProcessMemoryUsage()
+			{
+				ulong result;
+				Validate(cuGetProcessMemoryUsage(out result));
+				return result;
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuSetMemoryPressureCallback(MemoryPressureCallback callback, IntPtr userData);
+			public static void SetMemoryPressureCallback(MemoryPressureCallback callback)
+			{
+				Validate(cuSetMemoryPressureCallback(callback, IntPtr.Zero));
+				memoryPressureCallback = callback;
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuReleaseMemory(ulong bytesToRelease, out ulong bytesReleased);
+			public static ulong ReleaseMemory(ulong bytesToRelease)
+			{
+				ulong bytesReleased;
+				Validate(cuReleaseMemory(bytesToRelease, out bytesReleased));
+				return bytesReleased;
+			}
+			
+			[DllImport (dllToImport)]
+			private static extern int cuSetUseHugePages(uint useHugePages);
+			public static void SetUseHugePages(bool useHugePages)
+			{
+				Validate(cuSetUseHugePages(useHugePages ? 1u : 0u));
+			}
+			
 			[DllImport (dllToImport)]
 			private static extern int cuDeleteVolume(uint volumeHandle);
 			public static void DeleteVolume(uint volumeHandle)
@@ -445,10 +545,10 @@ namespace Cubiquity
 			// Clock functions
 			////////////////////////////////////////////////////////////////////////////////
 			[DllImport (dllToImport)]
-			private static extern int cuGetCurrentTime(out uint result);
-			public static uint GetCurrentTime()
+			private static extern int cuGetCurrentTime(out ulong result);
+			public static ulong GetCurrentTime()
 			{
-				uint result;
+				ulong result;
 				Validate(cuGetCurrentTime(out result));
 				return result;
 			}
@@ -16,13 +16,13 @@ namespace Cubiquity
 		public class OctreeNode : MonoBehaviour
 		{
             [System.NonSerialized]
-            public uint structureLastSynced;
+            public ulong structureLastSynced;
 			[System.NonSerialized]
-            public uint propertiesLastSynced;
+            public ulong propertiesLastSynced;
             [System.NonSerialized]
-            public uint meshLastSynced;
+            public ulong meshLastSynced;
             [System.NonSerialized]
-            public uint nodeAndChildrenLastSynced;
+            public ulong nodeAndChildrenLastSynced;
             [System.NonSerialized]
             public bool renderThisNode;
 			[System.NonSerialized]
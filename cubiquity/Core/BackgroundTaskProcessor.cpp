@@ -24,91 +24,232 @@
 
 #include "BackgroundTaskProcessor.h"
 
-/*#include "boost/bind.hpp"
+#include "PolyVox/Impl/ErrorHandling.h"
+
+#include <algorithm>
+#include <exception>
 
 namespace Cubiquity
 {
-	BackgroundTaskProcessor gBackgroundTaskProcessor(1); //Our global instance
+	BackgroundTaskProcessor gBackgroundTaskProcessor; //Our global instance
+	BackgroundTaskProcessor gPrefetchTaskProcessor(1);
 
-	BackgroundTaskProcessor::BackgroundTaskProcessor(uint32_t noOfThreads)
+	BackgroundTaskGroup::BackgroundTaskGroup(BackgroundTaskProcessor* processor)
 		:TaskProcessor()
+		,mProcessor(processor)
+		,mNoOfRunningTasks(0)
+		,mIsBeingRemoved(false)
+		,mNoOfUnfinishedTasks(0)
 	{
-		for(uint32_t ct = 0; ct < noOfThreads; ct++)
-		{
-			boost::thread* taskProcessingThread = new boost::thread(boost::bind(&BackgroundTaskProcessor::processTasks, this));
-			mThreads.push_back(taskProcessingThread);
-		}
+		mProcessor->addGroup(this);
 	}
 
-	BackgroundTaskProcessor::~BackgroundTaskProcessor()
+	BackgroundTaskGroup::~BackgroundTaskGroup()
 	{
-		for(std::list<boost::thread*>::iterator threadIter = mThreads.begin(); threadIter != mThreads.end(); threadIter++)
-		{
-			(*threadIter)->interrupt();
-			(*threadIter)->join();
-			delete *threadIter;
-		}
+		mProcessor->removeGroup(this);
 	}
 
-	void BackgroundTaskProcessor::addTask(Task* task)
+	void BackgroundTaskGroup::addTask(Task* task)
 	{
+		std::unique_lock<std::mutex> lock(mProcessor->mMutex);
+
+		// Counted before it is queued, so that hasTasks() can't miss it.
+		mNoOfUnfinishedTasks++;
 		mPendingTasks.push(task);
+		mProcessor->mNoOfQueuedTasks++;
+
+		lock.unlock();
+		mProcessor->mTaskAdded.notify_one();
 	}
 
-	void BackgroundTaskProcessor::processTasks(void)
+	bool BackgroundTaskGroup::hasTasks(void)
 	{
-		// This is commented out becaue we're not currently using this class, and having this running
-		// causes problems on application shutdown. We probably need a way to stop this background processor.
-		//while(true)
-		//{
-		//	Task* task = 0;
-		//	mPendingTasks.wait_and_pop(task);
-		//	task->process();
-		//}
+		return mNoOfUnfinishedTasks > 0;
 	}
-}*/
-
-namespace Cubiquity
-{
-	BackgroundTaskProcessor gBackgroundTaskProcessor; //Our global instance
 
-	BackgroundTaskProcessor::BackgroundTaskProcessor()
-		:TaskProcessor()
+	BackgroundTaskProcessor::BackgroundTaskProcessor(uint32_t noOfThreads)
+		:mNextGroup(0)
+		,mNoOfQueuedTasks(0)
+		,mShutDown(false)
+		,mNoOfThreads(noOfThreads)
 	{
+		POLYVOX_THROW_IF(noOfThreads == 0, std::invalid_argument, "Background task processor needs at least one thread");
 	}
 
 	BackgroundTaskProcessor::~BackgroundTaskProcessor()
 	{
-		mPendingTasks.clear();
+		// Every group should have been removed (and so the threads stopped) by now, unless a volume was leaked. We
+		// don't log about it as this runs during static destruction, when the logger may already have gone.
+		stopThreads();
 	}
 
-	void BackgroundTaskProcessor::addTask(Task* task)
+	uint32_t BackgroundTaskProcessor::getDefaultNoOfThreads(void)
 	{
-		mPendingTasks.push_back(task);
+		// Note that hardware_concurrency() is allowed to return zero if the value is not computable.
+		uint32_t noOfHardwareThreads = std::thread::hardware_concurrency();
+		return (std::max)(noOfHardwareThreads, 2u) - 1;
 	}
 
-	bool BackgroundTaskProcessor::hasTasks(void)
+	void BackgroundTaskProcessor::addGroup(BackgroundTaskGroup* group)
 	{
-		return mPendingTasks.size() > 0;
+		std::lock_guard<std::mutex> threadsLock(mThreadsMutex);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mGroups.push_back(group);
+		}
+
+		if(mThreads.empty())
+		{
+			startThreads();
+		}
 	}
 
-	void BackgroundTaskProcessor::processOneTask(void)
+	void BackgroundTaskProcessor::removeGroup(BackgroundTaskGroup* group)
 	{
-		if (mPendingTasks.size() > 0)
+		std::lock_guard<std::mutex> threadsLock(mThreadsMutex);
+
+		bool noGroupsLeft;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			// After this no more of the group's tasks can be started, and a stage which is still running won't requeue it's task.
+			mGroups.erase(std::find(mGroups.begin(), mGroups.end(), group));
+			group->mIsBeingRemoved = true;
+
+			// Tasks which are still queued are simply discarded. This includes any which were part way through. It must be done before
+			// waiting, as while they are counted as queued the workers will keep waking up to look for them (and not find them).
+			Task* task;
+			while(group->mPendingTasks.try_pop(task))
+			{
+				delete task;
+				mNoOfQueuedTasks--;
+				group->mNoOfUnfinishedTasks--;
+			}
+
+			// Any stage which is currently being processed is allowed to finish.
+			mTaskFinished.wait(lock, [group]{ return group->mNoOfRunningTasks == 0; });
+
+			noGroupsLeft = mGroups.empty();
+		}
+
+		if(noGroupsLeft)
 		{
-			Task* task = mPendingTasks.front();
-			mPendingTasks.pop_front();
-			task->process();
+			stopThreads();
 		}
 	}
 
-	void BackgroundTaskProcessor::processAllTasks(void)
+	void BackgroundTaskProcessor::startThreads(void)
 	{
-		while (mPendingTasks.size() > 0)
+		for(uint32_t ct = 0; ct < mNoOfThreads; ct++)
 		{
-			Task* task = mPendingTasks.front();
-			mPendingTasks.pop_front();
-			task->process();
+			mThreads.push_back(std::thread(&BackgroundTaskProcessor::processTasks, this));
 		}
 	}
+
+	void BackgroundTaskProcessor::stopThreads(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mShutDown = true;
+		}
+		mTaskAdded.notify_all();
+
+		for(std::vector<std::thread>::iterator threadIter = mThreads.begin(); threadIter != mThreads.end(); threadIter++)
+		{
+			threadIter->join();
+		}
+		mThreads.clear();
+
+		// Ready for the threads to be started again.
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutDown = false;
+	}
+
+	void BackgroundTaskProcessor::processTasks(void)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		while(true)
+		{
+			mTaskAdded.wait(lock, [this]{ return mShutDown || (mNoOfQueuedTasks > 0); });
+			if(mShutDown)
+			{
+				return;
+			}
+
+			// Find the next group (after the one we last took from) which has work for us.
+			BackgroundTaskGroup* group = 0;
+			Task* task = 0;
+			for(uint32_t ct = 0; ct < mGroups.size(); ct++)
+			{
+				uint32_t groupIndex = (mNextGroup + ct) % mGroups.size();
+				if(mGroups[groupIndex]->mPendingTasks.try_pop(task))
+				{
+					group = mGroups[groupIndex];
+					mNextGroup = groupIndex + 1;
+					break;
+				}
+			}
+			POLYVOX_ASSERT(group != 0, "Queued task count does not match the contents of the groups");
+
+			mNoOfQueuedTasks--;
+			group->mNoOfRunningTasks++;
+
+			lock.unlock();
+			bool hasMoreStages = processTask(task);
+			lock.lock();
+
+			if(hasMoreStages && group->mIsBeingRemoved)
+			{
+				// The rest of the task would never be processed.
+				delete task;
+				group->mNoOfUnfinishedTasks--;
+			}
+			else if(hasMoreStages)
+			{
+				// Requeuing doesn't change the number of unfinished tasks.
+				task->mPriority = ResumedTaskPriority;
+				group->mPendingTasks.push(task);
+				mNoOfQueuedTasks++;
+				mTaskAdded.notify_one();
+			}
+			else
+			{
+				// Must come after processing, so that hasTasks() stays true until the task has handed back it's result.
+				group->mNoOfUnfinishedTasks--;
+			}
+
+			group->mNoOfRunningTasks--;
+			mTaskFinished.notify_all();
+		}
+	}
+
+	bool BackgroundTaskProcessor::processTask(Task* task)
+	{
+		// An exception escaping from a thread would terminate the application, so we log it here instead. The
+		// task is still handed over to onFailed(), as it may be referenced (e.g. by the OctreeNode which scheduled it).
+		try
+		{
+			if(task->process())
+			{
+				return true;
+			}
+		}
+		catch(const std::exception& ex)
+		{
+			POLYVOX_LOG_ERROR("Caught exception while processing background task. Message reads: \"", ex.what(), "\"");
+			task->onFailed();
+			return false;
+		}
+		catch(...)
+		{
+			POLYVOX_LOG_ERROR("Caught unknown exception while processing background task.");
+			task->onFailed();
+			return false;
+		}
+
+		// This happens outside the processor's lock, as the task may hand itself back through a queue of it's own.
+		task->onFinished();
+		return false;
+	}
 }
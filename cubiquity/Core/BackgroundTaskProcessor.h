@@ -28,48 +28,128 @@
 #include "ConcurrentQueue.h"
 #include "TaskProcessor.h"
 
-//#include "boost/thread.hpp"
-
-#include <list>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace Cubiquity
 {
-	/*class BackgroundTaskProcessor : public TaskProcessor
+	class BackgroundTaskProcessor;
+
+	extern BackgroundTaskProcessor gBackgroundTaskProcessor;
+
+	// Pages in voxel data ahead of the camera. This is kept apart from the main processor so that waiting on the disk doesn't hold
+	// up surface extraction (and vice versa), and it only needs one thread because each voxel database serialises access to itself anyway.
+	extern BackgroundTaskProcessor gPrefetchTaskProcessor;
+
+	// The tasks which one client (normally a volume) has submitted to a BackgroundTaskProcessor. Within a group the tasks are
+	// processed in priority order, while the processor shares it's threads fairly between all the groups which have work.
+	class BackgroundTaskGroup : public TaskProcessor
 	{
 	public:
-		BackgroundTaskProcessor(uint32_t noOfThreads);
-		virtual ~BackgroundTaskProcessor();
+		BackgroundTaskGroup(BackgroundTaskProcessor* processor = &gBackgroundTaskProcessor);
+
+		// Tasks which have not yet started are deleted, and we wait for those which are being processed to finish. After
+		// this no worker thread will touch anything belonging to the group's tasks (e.g. the volume and its octree).
+		virtual ~BackgroundTaskGroup();
 
 		void addTask(Task* task);
 
-		bool hasAnyFinishedTasks(void);
-		Task* removeFirstFinishedTask(void);
+		// Returns true if there are tasks which are waiting to be processed or which are being processed.
+		bool hasTasks(void);
 
-		void processTasks(void);
+		// Lets the caller change the priorities of tasks which have not yet started. Tasks for which 'func' returns false are
+		// cancelled, which means they are removed and handed back through 'cancelledTasks' (they are not deleted).
+		template<typename Func>
+		void updateTasks(Func func, std::vector<Task*>& cancelledTasks);
 
+	private:
+		friend class BackgroundTaskProcessor;
+
+		BackgroundTaskProcessor* mProcessor;
+
+		// Has it's own lock, but is also only ever accessed with the processor's mutex held
+		// so that the processor's count of queued tasks can be kept in step with it.
 		concurrent_queue<Task*, TaskSortCriterion> mPendingTasks;
 
-		std::list<boost::thread*> mThreads;
-	};
+		// Protected by the processor's mutex.
+		uint32_t mNoOfRunningTasks;
+		bool mIsBeingRemoved;
 
-	extern BackgroundTaskProcessor gBackgroundTaskProcessor;*/
+		// Counts tasks from when they are added until they have finished processing (not just until they are popped).
+		std::atomic<uint32_t> mNoOfUnfinishedTasks;
+	};
 
-	class BackgroundTaskProcessor : public TaskProcessor
+	// Runs tasks on a pool of worker threads which is shared by all volumes. Once a task's last stage has been processed it is passed to
+	// Task::onFinished(), which deletes it unless the task hands itself back (e.g. surface extraction tasks go onto the Octree's finished queue).
+	//
+	// There are no per-thread queues, because tasks need to come out in priority order. Instead any idle worker takes the next task
+	// from whichever group's turn it is, visiting the groups round-robin so that a volume with lots of work can't starve the others.
+	//
+	// A task with several stages goes back into it's group's queue after each one, with a priority higher than any new task. Work in
+	// progress is then finished before more is started (limiting the memory held by partly processed tasks), but any thread can do it.
+	class BackgroundTaskProcessor
 	{
 	public:
-		BackgroundTaskProcessor();
-		virtual ~BackgroundTaskProcessor();
+		// Given to tasks which are part way through. New tasks should use lower priorities than this.
+		static const uint32_t ResumedTaskPriority = 0xFFFFFFFE;
 
-		void addTask(Task* task);
-		bool hasTasks(void);
+		BackgroundTaskProcessor(uint32_t noOfThreads = getDefaultNoOfThreads());
+		~BackgroundTaskProcessor();
 
-		virtual void processOneTask(void)/* = 0*/;
-		virtual void processAllTasks(void)/* = 0*/;
+		uint32_t getNoOfThreads(void) { return mNoOfThreads; }
 
-		std::list<Task*> mPendingTasks;
+		// One less than the number of hardware threads, so that the main thread still has a core to itself.
+		static uint32_t getDefaultNoOfThreads(void);
+
+	private:
+		friend class BackgroundTaskGroup;
+
+		// The threads are only running while there are groups. This means they are normally stopped by the last volume being deleted,
+		// rather than during static destruction (joining threads while a DLL is being unloaded can deadlock on some platforms).
+		void addGroup(BackgroundTaskGroup* group);
+		void removeGroup(BackgroundTaskGroup* group);
+
+		void startThreads(void);
+		void stopThreads(void);
+
+		void processTasks(void);
+
+		// Returns true if the task has more stages. Otherwise it has been passed to Task::onFinished() (or Task::onFailed() if
+		// it threw) and must not be touched again.
+		bool processTask(Task* task);
+
+		// Protects everything below, apart from the threads themselves.
+		std::mutex mMutex;
+		std::condition_variable mTaskAdded;
+		std::condition_variable mTaskFinished;
+
+		std::vector<BackgroundTaskGroup*> mGroups;
+		uint32_t mNextGroup;
+		uint32_t mNoOfQueuedTasks;
+		bool mShutDown;
+
+		// These have their own mutex, as the workers need to take 'mMutex' in order to exit while we are joining them.
+		std::mutex mThreadsMutex;
+		uint32_t mNoOfThreads;
+		std::vector<std::thread> mThreads;
 	};
 
-	//extern BackgroundTaskProcessor gBackgroundTaskProcessor;
+	template<typename Func>
+	void BackgroundTaskGroup::updateTasks(Func func, std::vector<Task*>& cancelledTasks)
+	{
+		std::lock_guard<std::mutex> lock(mProcessor->mMutex);
+
+		uint32_t noOfPreviouslyCancelledTasks = static_cast<uint32_t>(cancelledTasks.size());
+		mPendingTasks.update_and_filter(func, cancelledTasks);
+		uint32_t noOfCancelledTasks = static_cast<uint32_t>(cancelledTasks.size()) - noOfPreviouslyCancelledTasks;
+
+		mProcessor->mNoOfQueuedTasks -= noOfCancelledTasks;
+		mNoOfUnfinishedTasks -= noOfCancelledTasks;
+	}
 }
 
 #endif //CUBIQUITY_BACKGROUNDTASKPROCESSOR_H_
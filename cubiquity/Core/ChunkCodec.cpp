@@ -0,0 +1,423 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+// We only use miniz through the ChunkCodec, so the implementation is compiled here. The zlib-style names are
+// left out as they are macros (e.g. 'compress') which would otherwise rename our own functions.
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "miniz/miniz.c"
+
+#include "ChunkCodec.h"
+
+#include "PolyVox/Impl/ErrorHandling.h"
+
+#include <stdexcept>
+
+#include "Exceptions.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Cubiquity
+{
+	// Deflate, as implemented by miniz. The default and maximum levels produce the same format.
+	class ZlibChunkCodec : public ChunkCodec
+	{
+	public:
+		ZlibChunkCodec(ChunkCompression compression, const char* name, int level)
+			:mCompression(compression)
+			,mName(name)
+			,mLevel(level)
+		{
+		}
+
+		ChunkCompression getCompression(void) const { return mCompression; }
+		const char* getName(void) const { return mName; }
+
+		uint32_t getMaxCompressedLength(uint32_t srcLength, uint32_t /*voxelSizeInBytes*/) const
+		{
+			return static_cast<uint32_t>(mz_compressBound(srcLength));
+		}
+
+		uint32_t compress(const uint8_t* src, uint32_t srcLength, uint32_t /*voxelSizeInBytes*/, uint8_t* dst, uint32_t dstCapacity) const
+		{
+			mz_ulong compressedLength = dstCapacity; // Gets updated when compression happens
+			int status = mz_compress2(dst, &compressedLength, src, srcLength, mLevel);
+			POLYVOX_THROW_IF(status != MZ_OK, CompressionError, "Compression failed with error message \'", mz_error(status), "\'");
+			return static_cast<uint32_t>(compressedLength);
+		}
+
+		void decompress(const uint8_t* src, uint32_t srcLength, uint32_t /*voxelSizeInBytes*/, uint8_t* dst, uint32_t dstLength) const
+		{
+			mz_ulong uncompressedLength = dstLength;
+			int status = mz_uncompress(dst, &uncompressedLength, src, srcLength);
+			POLYVOX_THROW_IF(status != MZ_OK, CompressionError, "Decompression failed with error message \'", mz_error(status), "\'");
+			POLYVOX_THROW_IF(uncompressedLength != dstLength, CompressionError, "Decompressed ", uncompressedLength, " bytes but expected ", dstLength);
+		}
+
+	private:
+		ChunkCompression mCompression;
+		const char* mName;
+		int mLevel;
+	};
+
+	// An LZ77 variant along the lines of LZ4's block format, though it isn't compatible with it. Each sequence is a token byte (literal length in the
+	// high nibble, match length minus four in the low nibble, with 15 meaning more bytes follow), the literals, and a two byte offset back to the match.
+	// The last sequence has literals only. Matches are found through a single hash table with no chaining, which is what makes it fast.
+	class FastChunkCodec : public ChunkCodec
+	{
+	public:
+		ChunkCompression getCompression(void) const { return ChunkCompressions::Fast; }
+		const char* getName(void) const { return "lz"; }
+
+		uint32_t getMaxCompressedLength(uint32_t srcLength, uint32_t /*voxelSizeInBytes*/) const
+		{
+			// Everything as literals, plus the extra length bytes and the final token.
+			return srcLength + srcLength / 255 + 16;
+		}
+
+		uint32_t compress(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstCapacity) const
+		{
+			POLYVOX_THROW_IF(dstCapacity < getMaxCompressedLength(srcLength, voxelSizeInBytes), std::invalid_argument, "Destination is too small for compression");
+
+			// Holds the position (plus one, so zero is empty) where each hash of four bytes was last seen.
+			uint32_t positions[1 << HashBits];
+			std::memset(positions, 0, sizeof(positions));
+
+			const uint8_t* ip = src;
+			const uint8_t* anchor = src;
+			const uint8_t* const end = src + srcLength;
+			// The last few bytes are always literals, so that we can read four bytes at a time without running off the end.
+			const uint8_t* const matchLimit = (srcLength > LastLiterals) ? end - LastLiterals : src;
+			uint8_t* op = dst;
+
+			while (ip + MinMatchLength <= matchLimit)
+			{
+				const uint32_t sequence = read32(ip);
+				const uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+				const uint32_t candidate = positions[hash];
+				positions[hash] = static_cast<uint32_t>(ip - src) + 1;
+
+				if (candidate != 0)
+				{
+					const uint8_t* match = src + candidate - 1;
+					if ((ip - match <= MaxOffset) && (read32(match) == sequence))
+					{
+						// Voxel data often has long runs, so the match is extended eight bytes at a time.
+						const uint8_t* matchEnd = ip + MinMatchLength;
+						const uint8_t* ref = match + MinMatchLength;
+						while ((matchEnd + 8 <= matchLimit) && (read64(matchEnd) == read64(ref)))
+						{
+							matchEnd += 8;
+							ref += 8;
+						}
+						while ((matchEnd < matchLimit) && (*matchEnd == *ref))
+						{
+							matchEnd++;
+							ref++;
+						}
+
+						op = writeSequence(op, anchor, static_cast<uint32_t>(ip - anchor), static_cast<uint32_t>(ip - match), static_cast<uint32_t>(matchEnd - ip));
+						ip = matchEnd;
+						anchor = ip;
+						continue;
+					}
+				}
+
+				// Move faster through data which isn't compressing, as LZ4 does.
+				ip += 1 + ((ip - anchor) >> 6);
+			}
+
+			op = writeSequence(op, anchor, static_cast<uint32_t>(end - anchor), 0, 0);
+			return static_cast<uint32_t>(op - dst);
+		}
+
+		void decompress(const uint8_t* src, uint32_t srcLength, uint32_t /*voxelSizeInBytes*/, uint8_t* dst, uint32_t dstLength) const
+		{
+			const uint8_t* ip = src;
+			const uint8_t* const srcEnd = src + srcLength;
+			uint8_t* op = dst;
+			uint8_t* const dstEnd = dst + dstLength;
+
+			for (;;)
+			{
+				POLYVOX_THROW_IF(ip >= srcEnd, CompressionError, "Decompression failed as the data ended unexpectedly");
+				const uint8_t token = *ip++;
+
+				uint32_t literalLength = token >> 4;
+				if (literalLength == 15)
+				{
+					literalLength += readLength(ip, srcEnd, dstLength);
+				}
+				POLYVOX_THROW_IF((literalLength > static_cast<uint32_t>(srcEnd - ip)) || (literalLength > static_cast<uint32_t>(dstEnd - op)),
+					CompressionError, "Decompression failed as the literals run past the end of the data");
+				std::memcpy(op, ip, literalLength);
+				ip += literalLength;
+				op += literalLength;
+
+				// Only the last sequence ends without a match.
+				if (ip == srcEnd)
+				{
+					break;
+				}
+
+				POLYVOX_THROW_IF(srcEnd - ip < 2, CompressionError, "Decompression failed as the data ended unexpectedly");
+				const uint32_t offset = ip[0] | (ip[1] << 8);
+				ip += 2;
+
+				uint32_t matchLength = token & 15;
+				if (matchLength == 15)
+				{
+					matchLength += readLength(ip, srcEnd, dstLength);
+				}
+				matchLength += MinMatchLength;
+
+				POLYVOX_THROW_IF((offset == 0) || (offset > static_cast<uint32_t>(op - dst)), CompressionError, "Decompression failed due to an invalid match offset");
+				POLYVOX_THROW_IF(matchLength > static_cast<uint32_t>(dstEnd - op), CompressionError, "Decompression failed as a match runs past the end of the data");
+
+				// The match can overlap what it is copying (this is how runs are stored), so the bytes repeat every 'offset'. Copying
+				// everything written so far each time keeps the copies apart, and doubles the amount copied on each pass.
+				const uint8_t* match = op - offset;
+				uint32_t written = 0;
+				while (written < matchLength)
+				{
+					const uint32_t toCopy = (std::min)(offset + written, matchLength - written);
+					std::memcpy(op + written, match, toCopy);
+					written += toCopy;
+				}
+				op += matchLength;
+			}
+
+			POLYVOX_THROW_IF(op != dstEnd, CompressionError, "Decompressed ", op - dst, " bytes but expected ", dstLength);
+		}
+
+	private:
+		static const uint32_t MinMatchLength = 4;
+		static const uint32_t LastLiterals = 5;
+		static const int64_t MaxOffset = 65535;
+		static const uint32_t HashBits = 12;
+
+		static uint32_t read32(const uint8_t* p)
+		{
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		static uint64_t read64(const uint8_t* p)
+		{
+			uint64_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		// Lengths which don't fit in the token continue in bytes of 255, ending with one which is less.
+		static uint8_t* writeLength(uint8_t* op, uint32_t length)
+		{
+			while (length >= 255)
+			{
+				*op++ = 255;
+				length -= 255;
+			}
+			*op++ = static_cast<uint8_t>(length);
+			return op;
+		}
+
+		static uint32_t readLength(const uint8_t*& ip, const uint8_t* srcEnd, uint32_t maxLength)
+		{
+			uint32_t length = 0;
+			uint8_t byte;
+			do
+			{
+				POLYVOX_THROW_IF(ip >= srcEnd, CompressionError, "Decompression failed as the data ended unexpectedly");
+				byte = *ip++;
+				length += byte;
+				POLYVOX_THROW_IF(length > maxLength, CompressionError, "Decompression failed due to an invalid length");
+			} while (byte == 255);
+			return length;
+		}
+
+		// A match length of zero means there is no match (the last sequence).
+		static uint8_t* writeSequence(uint8_t* op, const uint8_t* literals, uint32_t literalLength, uint32_t offset, uint32_t matchLength)
+		{
+			const uint32_t matchCode = (matchLength > 0) ? matchLength - MinMatchLength : 0;
+			*op++ = static_cast<uint8_t>(((std::min)(literalLength, 15u) << 4) | (std::min)(matchCode, 15u));
+			if (literalLength >= 15)
+			{
+				op = writeLength(op, literalLength - 15);
+			}
+
+			std::memcpy(op, literals, literalLength);
+			op += literalLength;
+
+			if (matchLength > 0)
+			{
+				*op++ = static_cast<uint8_t>(offset & 0xFF);
+				*op++ = static_cast<uint8_t>(offset >> 8);
+				if (matchCode >= 15)
+				{
+					op = writeLength(op, matchCode - 15);
+				}
+			}
+			return op;
+		}
+	};
+
+	// Each run is stored as it's length (seven bits per byte, with the top bit set if more follow) and then the voxel. Unlike a byte-oriented
+	// RLE this never splits a voxel, so a chunk of colored cubes which is mostly empty space or a single material ends up as just a few runs.
+	class RunLengthChunkCodec : public ChunkCodec
+	{
+	public:
+		ChunkCompression getCompression(void) const { return ChunkCompressions::RunLength; }
+		const char* getName(void) const { return "rle"; }
+
+		uint32_t getMaxCompressedLength(uint32_t srcLength, uint32_t voxelSizeInBytes) const
+		{
+			// Every voxel in a run of it's own, with a length which takes a single byte.
+			return srcLength + srcLength / voxelSizeInBytes;
+		}
+
+		uint32_t compress(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstCapacity) const
+		{
+			POLYVOX_THROW_IF((voxelSizeInBytes == 0) || (srcLength % voxelSizeInBytes != 0), std::invalid_argument, "Data is not a whole number of voxels");
+			POLYVOX_THROW_IF(dstCapacity < getMaxCompressedLength(srcLength, voxelSizeInBytes), std::invalid_argument, "Destination is too small for compression");
+
+			// The filtered chunks (see ChunkFilter.h) are bytes, and the rest are mostly Color or MaterialSet.
+			switch (voxelSizeInBytes)
+			{
+			case 1: return compressRuns<1>(src, srcLength, voxelSizeInBytes, dst);
+			case 4: return compressRuns<4>(src, srcLength, voxelSizeInBytes, dst);
+			case 8: return compressRuns<8>(src, srcLength, voxelSizeInBytes, dst);
+			default: return compressRuns<0>(src, srcLength, voxelSizeInBytes, dst);
+			}
+		}
+
+		void decompress(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstLength) const
+		{
+			POLYVOX_THROW_IF(voxelSizeInBytes == 0, std::invalid_argument, "Voxel size must be greater than zero");
+
+			const uint8_t* ip = src;
+			const uint8_t* const srcEnd = src + srcLength;
+			uint8_t* op = dst;
+			const uint32_t maxRunLength = dstLength / voxelSizeInBytes;
+
+			while (ip < srcEnd)
+			{
+				uint32_t runLength = 0;
+				uint32_t shift = 0;
+				uint8_t byte;
+				do
+				{
+					POLYVOX_THROW_IF((ip >= srcEnd) || (shift > 28), CompressionError, "Decompression failed due to an invalid run length");
+					byte = *ip++;
+					runLength |= static_cast<uint32_t>(byte & 0x7F) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+
+				POLYVOX_THROW_IF((runLength == 0) || (runLength > maxRunLength), CompressionError, "Decompression failed due to an invalid run length");
+				const uint32_t runLengthInBytes = runLength * voxelSizeInBytes;
+				POLYVOX_THROW_IF(static_cast<uint32_t>(srcEnd - ip) < voxelSizeInBytes, CompressionError, "Decompression failed as the data ended unexpectedly");
+				POLYVOX_THROW_IF(runLengthInBytes > static_cast<uint32_t>((dst + dstLength) - op), CompressionError, "Decompression failed as a run goes past the end of the data");
+
+				// Write the voxel once and then keep doubling what has been written, which needs far fewer copies than one per voxel.
+				std::memcpy(op, ip, voxelSizeInBytes);
+				ip += voxelSizeInBytes;
+				uint32_t written = voxelSizeInBytes;
+				while (written < runLengthInBytes)
+				{
+					const uint32_t toCopy = (std::min)(written, runLengthInBytes - written);
+					std::memcpy(op + written, op, toCopy);
+					written += toCopy;
+				}
+				op += runLengthInBytes;
+			}
+
+			POLYVOX_THROW_IF(op != dst + dstLength, CompressionError, "Decompressed ", op - dst, " bytes but expected ", dstLength);
+		}
+
+	private:
+		// Templated on the voxel size so that the comparisons become single loads for the common sizes. Zero means it is only known at runtime.
+		template <uint32_t FixedSize>
+		static uint32_t compressRuns(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst)
+		{
+			const uint32_t voxelSize = FixedSize ? FixedSize : voxelSizeInBytes;
+
+			uint8_t* op = dst;
+			uint32_t runStart = 0;
+			while (runStart < srcLength)
+			{
+				uint32_t runEnd = runStart + voxelSize;
+				while ((runEnd < srcLength) && (std::memcmp(src + runEnd, src + runStart, voxelSize) == 0))
+				{
+					runEnd += voxelSize;
+				}
+
+				uint32_t runLength = (runEnd - runStart) / voxelSize;
+				while (runLength >= 0x80)
+				{
+					*op++ = static_cast<uint8_t>(runLength | 0x80);
+					runLength >>= 7;
+				}
+				*op++ = static_cast<uint8_t>(runLength);
+
+				std::memcpy(op, src + runStart, voxelSize);
+				op += voxelSize;
+
+				runStart = runEnd;
+			}
+
+			return static_cast<uint32_t>(op - dst);
+		}
+	};
+
+	namespace
+	{
+		ZlibChunkCodec gZlibChunkCodec(ChunkCompressions::Zlib, "zlib", MZ_DEFAULT_LEVEL);
+		FastChunkCodec gFastChunkCodec;
+		ZlibChunkCodec gMaximumChunkCodec(ChunkCompressions::Maximum, "zlib-max", MZ_BEST_COMPRESSION);
+		RunLengthChunkCodec gRunLengthChunkCodec;
+
+		// Indexed by ChunkCompression.
+		const ChunkCodec* const gChunkCodecs[] = { &gZlibChunkCodec, &gFastChunkCodec, &gMaximumChunkCodec, &gRunLengthChunkCodec };
+		const uint32_t gNoOfChunkCodecs = sizeof(gChunkCodecs) / sizeof(gChunkCodecs[0]);
+	}
+
+	const ChunkCodec* ChunkCodec::get(ChunkCompression compression)
+	{
+		POLYVOX_THROW_IF(static_cast<uint32_t>(compression) >= gNoOfChunkCodecs, std::invalid_argument, "Unknown chunk compression (", compression, ")");
+		return gChunkCodecs[compression];
+	}
+
+	const ChunkCodec* ChunkCodec::find(const std::string& name)
+	{
+		for (uint32_t ct = 0; ct < gNoOfChunkCodecs; ct++)
+		{
+			if (name == gChunkCodecs[ct]->getName())
+			{
+				return gChunkCodecs[ct];
+			}
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CUBIQUITY_CHUNKCODEC_H_
+#define CUBIQUITY_CHUNKCODEC_H_
+
+#include <cstdint>
+#include <string>
+
+namespace Cubiquity
+{
+	namespace ChunkCompressions
+	{
+		// The values match the CU_CHUNK_COMPRESSION_* constants in the C interface. Zero is the default so that
+		// it can be left unset in the VolumeOptions, and is the only one which older versions of Cubiquity can read.
+		enum ChunkCompression
+		{
+			Zlib = 0, // Deflate at the default level. A reasonable balance, and what voxel databases have always used.
+			Fast = 1, // A byte-oriented LZ77 in the style of LZ4. Compresses less well but is several times faster, which suits editing.
+			Maximum = 2, // Deflate at the highest level. Slow to compress but no slower to decompress, so suits VDBs which are shipped with a game.
+			RunLength = 3 // Runs of identical voxels. Very fast and works well on colored cubes, where there are large areas of a single color.
+		};
+	}
+	typedef ChunkCompressions::ChunkCompression ChunkCompression;
+
+	// Compresses the voxel data of a chunk before it is written to the voxel database. The data is in linear order and
+	// is a whole number of voxels. The codec which was used is stored in the database (see VoxelDatabase::setChunkCodec()),
+	// because the compressed data doesn't say how it was compressed.
+	//
+	// The codecs have no state, so they are shared between all the databases and can be used from any thread.
+	class ChunkCodec
+	{
+	public:
+		virtual ~ChunkCodec() {}
+
+		// Throws std::invalid_argument if the codec does not exist.
+		static const ChunkCodec* get(ChunkCompression compression);
+		// Looks the codec up by the name stored in the database, returning null if there isn't one with that name.
+		static const ChunkCodec* find(const std::string& name);
+
+		virtual ChunkCompression getCompression(void) const = 0;
+		virtual const char* getName(void) const = 0;
+
+		// The largest compressed length which the given amount of data can produce.
+		virtual uint32_t getMaxCompressedLength(uint32_t srcLength, uint32_t voxelSizeInBytes) const = 0;
+
+		// The destination must have room for getMaxCompressedLength() bytes. Returns the compressed length.
+		virtual uint32_t compress(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstCapacity) const = 0;
+
+		// The data must decompress to exactly 'dstLength' bytes, otherwise a CompressionError is thrown. Corrupt data never
+		// causes reads or writes outside of the buffers, but is only noticed if it ends up malformed or the wrong length.
+		virtual void decompress(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstLength) const = 0;
+	};
+}
+
+#endif //CUBIQUITY_CHUNKCODEC_H_
@@ -0,0 +1,331 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#include "ChunkFilter.h"
+
+#include "ChunkCodec.h"
+
+#include "PolyVox/Impl/ErrorHandling.h"
+
+#include <stdexcept>
+
+#include "Exceptions.h"
+
+#include <climits>
+#include <cstring>
+
+namespace Cubiquity
+{
+	namespace
+	{
+		const uint32_t MaxPaletteSize = 256;
+
+		// Voxels are looked up in the palette through a small hash table, which is twice the size of the palette so it never gets too full.
+		const uint32_t PaletteHashBits = 9;
+		const uint32_t PaletteHashSize = 1 << PaletteHashBits;
+
+		// Smaller chunks are small enough to try the filters on all of it.
+		const uint32_t MinVoxelsToSample = 4096;
+
+		// The loops below are templated on the voxel size so that the compiler can turn the per-voxel copies into single loads and stores for the
+		// common sizes (Color and MaterialSet). A size of zero means it is only known at runtime, which works for any voxel but is much slower.
+		template <uint32_t FixedSize>
+		uint64_t readVoxel(const uint8_t* src, uint32_t voxelSizeInBytes)
+		{
+			uint64_t voxel = 0;
+			std::memcpy(&voxel, src, FixedSize ? FixedSize : voxelSizeInBytes);
+			return voxel;
+		}
+
+		// The byte planes are processed one at a time so that one side of each copy is sequential and the delta only needs a single running value.
+		template <uint32_t FixedSize, bool Delta>
+		void splitBytePlanes(const uint8_t* src, uint32_t noOfVoxels, uint32_t voxelSizeInBytes, uint8_t* dst)
+		{
+			const uint32_t voxelSize = FixedSize ? FixedSize : voxelSizeInBytes;
+			for (uint32_t plane = 0; plane < voxelSize; plane++)
+			{
+				const uint8_t* planeSrc = src + plane;
+				uint8_t* planeDst = dst + plane * noOfVoxels;
+				uint8_t previous = 0;
+				for (uint32_t ct = 0; ct < noOfVoxels; ct++)
+				{
+					uint8_t value = planeSrc[ct * voxelSize];
+					planeDst[ct] = Delta ? static_cast<uint8_t>(value - previous) : value;
+					previous = value;
+				}
+			}
+		}
+
+		template <uint32_t FixedSize, bool Delta>
+		void mergeBytePlanes(const uint8_t* src, uint32_t noOfVoxels, uint32_t voxelSizeInBytes, uint8_t* dst)
+		{
+			const uint32_t voxelSize = FixedSize ? FixedSize : voxelSizeInBytes;
+			for (uint32_t plane = 0; plane < voxelSize; plane++)
+			{
+				const uint8_t* planeSrc = src + plane * noOfVoxels;
+				uint8_t* planeDst = dst + plane;
+				uint8_t previous = 0;
+				for (uint32_t ct = 0; ct < noOfVoxels; ct++)
+				{
+					uint8_t value = planeSrc[ct];
+					if (Delta)
+					{
+						value = static_cast<uint8_t>(value + previous);
+						previous = value;
+					}
+					planeDst[ct * voxelSize] = value;
+				}
+			}
+		}
+
+		template <uint32_t FixedSize>
+		void expandPalette(const uint8_t* palette, const uint8_t* indices, uint32_t noOfVoxels, uint32_t voxelSizeInBytes, uint8_t* dst)
+		{
+			const uint32_t voxelSize = FixedSize ? FixedSize : voxelSizeInBytes;
+			for (uint32_t ct = 0; ct < noOfVoxels; ct++)
+			{
+				std::memcpy(dst + ct * voxelSize, palette + indices[ct] * voxelSize, voxelSize);
+			}
+		}
+
+		template <uint32_t FixedSize>
+		bool applyPalette(const uint8_t* src, uint32_t noOfVoxels, uint32_t voxelSizeInBytes, std::vector<uint8_t>& filtered)
+		{
+			const uint32_t voxelSize = FixedSize ? FixedSize : voxelSizeInBytes;
+
+			// The palette always has room for every entry, so the size of the filtered data doesn't depend on how many are used.
+			// The unused entries are zeros so cost almost nothing once compressed.
+			filtered.assign(MaxPaletteSize * voxelSize + noOfVoxels, 0);
+			uint8_t* palette = &(filtered[0]);
+			uint8_t* indices = palette + MaxPaletteSize * voxelSize;
+
+			uint64_t hashedVoxels[PaletteHashSize];
+			int32_t hashedIndices[PaletteHashSize];
+			for (uint32_t ct = 0; ct < PaletteHashSize; ct++)
+			{
+				hashedIndices[ct] = -1;
+			}
+
+			uint32_t paletteSize = 0;
+			uint64_t previousVoxel = 0;
+			int32_t previousIndex = -1;
+			for (uint32_t ct = 0; ct < noOfVoxels; ct++)
+			{
+				const uint64_t voxel = readVoxel<FixedSize>(src + ct * voxelSize, voxelSize);
+
+				// Neighbouring voxels are usually the same, which saves the lookup.
+				if ((previousIndex >= 0) && (voxel == previousVoxel))
+				{
+					indices[ct] = static_cast<uint8_t>(previousIndex);
+					continue;
+				}
+
+				uint32_t hash = static_cast<uint32_t>((voxel * 0x9E3779B97F4A7C15ull) >> (64 - PaletteHashBits));
+				while ((hashedIndices[hash] >= 0) && (hashedVoxels[hash] != voxel))
+				{
+					hash = (hash + 1) & (PaletteHashSize - 1);
+				}
+
+				if (hashedIndices[hash] < 0)
+				{
+					if (paletteSize == MaxPaletteSize)
+					{
+						return false;
+					}
+
+					hashedVoxels[hash] = voxel;
+					hashedIndices[hash] = paletteSize;
+					std::memcpy(palette + paletteSize * voxelSize, src + ct * voxelSize, voxelSize);
+					paletteSize++;
+				}
+
+				previousVoxel = voxel;
+				previousIndex = hashedIndices[hash];
+				indices[ct] = static_cast<uint8_t>(previousIndex);
+			}
+
+			return true;
+		}
+	}
+
+	ChunkFilter applyBestChunkFilter(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, const ChunkCodec* codec, std::vector<uint8_t>& filtered)
+	{
+		POLYVOX_THROW_IF((voxelSizeInBytes == 0) || (srcLength % voxelSizeInBytes != 0), std::invalid_argument, "Data is not a whole number of voxels");
+
+		const ChunkCodec* probeCodec = codec;
+		if ((codec->getCompression() != ChunkCompressions::Fast) && (codec->getCompression() != ChunkCompressions::RunLength))
+		{
+			probeCodec = ChunkCodec::get(ChunkCompressions::Fast);
+		}
+
+		// Trying every filter on the whole chunk would take longer than compressing it, so they are compared on a sample and only the best is applied
+		// to the whole chunk. The sample is a quarter of the chunk from the middle (i.e. some complete slices), as the top and bottom are often empty.
+		const uint32_t noOfVoxels = srcLength / voxelSizeInBytes;
+		const uint32_t noOfSampleVoxels = (noOfVoxels >= MinVoxelsToSample) ? noOfVoxels / 4 : noOfVoxels;
+		const uint8_t* sample = src + ((noOfVoxels - noOfSampleVoxels) / 2) * voxelSizeInBytes;
+		const uint32_t sampleLength = noOfSampleVoxels * voxelSizeInBytes;
+
+		const ChunkFilter candidateFilters[] = { ChunkFilters::None, ChunkFilters::BytePlanes, ChunkFilters::BytePlanesDelta, ChunkFilters::Palette };
+		const uint32_t noOfCandidates = sizeof(candidateFilters) / sizeof(candidateFilters[0]);
+		uint32_t compressedLengths[noOfCandidates];
+
+		std::vector<uint8_t> compressed;
+		for (uint32_t ct = 0; ct < noOfCandidates; ct++)
+		{
+			compressedLengths[ct] = UINT_MAX;
+			if (applyChunkFilter(candidateFilters[ct], sample, sampleLength, voxelSizeInBytes, filtered))
+			{
+				const uint32_t filteredLength = static_cast<uint32_t>(filtered.size());
+				const uint32_t elementSize = getFilteredChunkElementSize(candidateFilters[ct], voxelSizeInBytes);
+				compressed.resize(probeCodec->getMaxCompressedLength(filteredLength, elementSize));
+				compressedLengths[ct] = probeCodec->compress(&(filtered[0]), filteredLength, elementSize, &(compressed[0]), static_cast<uint32_t>(compressed.size()));
+			}
+		}
+
+		// The palette can work for the sample but not the whole chunk, in which case we fall back on the next best. No filter always works.
+		for (;;)
+		{
+			uint32_t best = 0;
+			for (uint32_t ct = 1; ct < noOfCandidates; ct++)
+			{
+				if (compressedLengths[ct] < compressedLengths[best])
+				{
+					best = ct;
+				}
+			}
+
+			if (applyChunkFilter(candidateFilters[best], src, srcLength, voxelSizeInBytes, filtered))
+			{
+				return candidateFilters[best];
+			}
+			compressedLengths[best] = UINT_MAX;
+		}
+	}
+
+	bool applyChunkFilter(ChunkFilter filter, const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, std::vector<uint8_t>& filtered)
+	{
+		POLYVOX_THROW_IF((voxelSizeInBytes == 0) || (srcLength % voxelSizeInBytes != 0), std::invalid_argument, "Data is not a whole number of voxels");
+		// The planes keep track of the previous voxel in a uint64_t, and the palette compares voxels as integers.
+		POLYVOX_THROW_IF(voxelSizeInBytes > sizeof(uint64_t), std::invalid_argument, "Voxels of more than eight bytes cannot be filtered");
+		const uint32_t noOfVoxels = srcLength / voxelSizeInBytes;
+
+		if (filter == ChunkFilters::None)
+		{
+			filtered.assign(src, src + srcLength);
+		}
+		else if (filter == ChunkFilters::BytePlanes)
+		{
+			filtered.resize(srcLength);
+			switch (voxelSizeInBytes)
+			{
+			case 4: splitBytePlanes<4, false>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			case 8: splitBytePlanes<8, false>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			default: splitBytePlanes<0, false>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			}
+		}
+		else if (filter == ChunkFilters::BytePlanesDelta)
+		{
+			filtered.resize(srcLength);
+			switch (voxelSizeInBytes)
+			{
+			case 4: splitBytePlanes<4, true>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			case 8: splitBytePlanes<8, true>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			default: splitBytePlanes<0, true>(src, noOfVoxels, voxelSizeInBytes, &(filtered[0])); break;
+			}
+		}
+		else if (filter == ChunkFilters::Palette)
+		{
+			switch (voxelSizeInBytes)
+			{
+			case 4: return applyPalette<4>(src, noOfVoxels, voxelSizeInBytes, filtered);
+			case 8: return applyPalette<8>(src, noOfVoxels, voxelSizeInBytes, filtered);
+			default: return applyPalette<0>(src, noOfVoxels, voxelSizeInBytes, filtered);
+			}
+		}
+		else
+		{
+			POLYVOX_THROW(std::invalid_argument, "Unknown chunk filter (", filter, ")");
+		}
+
+		return true;
+	}
+
+	uint32_t getFilteredChunkLength(ChunkFilter filter, uint32_t srcLength, uint32_t voxelSizeInBytes)
+	{
+		// This comes from the database, so it's the data which is wrong rather than the caller.
+		POLYVOX_THROW_IF(static_cast<uint32_t>(filter) > ChunkFilters::Palette, CompressionError, "Unknown chunk filter (", filter, ")");
+
+		return (filter == ChunkFilters::Palette) ? MaxPaletteSize * voxelSizeInBytes + srcLength / voxelSizeInBytes : srcLength;
+	}
+
+	uint32_t getFilteredChunkElementSize(ChunkFilter filter, uint32_t voxelSizeInBytes)
+	{
+		return (filter == ChunkFilters::None) ? voxelSizeInBytes : 1;
+	}
+
+	void removeChunkFilter(ChunkFilter filter, const uint8_t* filtered, uint32_t filteredLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstLength)
+	{
+		POLYVOX_THROW_IF((voxelSizeInBytes == 0) || (dstLength % voxelSizeInBytes != 0), std::invalid_argument, "Data is not a whole number of voxels");
+		POLYVOX_THROW_IF(voxelSizeInBytes > sizeof(uint64_t), std::invalid_argument, "Voxels of more than eight bytes cannot be filtered");
+		POLYVOX_THROW_IF(filteredLength != getFilteredChunkLength(filter, dstLength, voxelSizeInBytes), CompressionError,
+			"Filtered chunk has a length of ", filteredLength, " but should be ", getFilteredChunkLength(filter, dstLength, voxelSizeInBytes));
+		const uint32_t noOfVoxels = dstLength / voxelSizeInBytes;
+
+		if (filter == ChunkFilters::None)
+		{
+			std::memcpy(dst, filtered, dstLength);
+		}
+		else if (filter == ChunkFilters::BytePlanes)
+		{
+			switch (voxelSizeInBytes)
+			{
+			case 4: mergeBytePlanes<4, false>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			case 8: mergeBytePlanes<8, false>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			default: mergeBytePlanes<0, false>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			}
+		}
+		else if (filter == ChunkFilters::BytePlanesDelta)
+		{
+			switch (voxelSizeInBytes)
+			{
+			case 4: mergeBytePlanes<4, true>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			case 8: mergeBytePlanes<8, true>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			default: mergeBytePlanes<0, true>(filtered, noOfVoxels, voxelSizeInBytes, dst); break;
+			}
+		}
+		else if (filter == ChunkFilters::Palette)
+		{
+			// Every index is within the palette (which always has 256 entries), so corrupt data can't take us outside of it.
+			const uint8_t* palette = filtered;
+			const uint8_t* indices = filtered + MaxPaletteSize * voxelSizeInBytes;
+			switch (voxelSizeInBytes)
+			{
+			case 4: expandPalette<4>(palette, indices, noOfVoxels, voxelSizeInBytes, dst); break;
+			case 8: expandPalette<8>(palette, indices, noOfVoxels, voxelSizeInBytes, dst); break;
+			default: expandPalette<0>(palette, indices, noOfVoxels, voxelSizeInBytes, dst); break;
+			}
+		}
+	}
+}
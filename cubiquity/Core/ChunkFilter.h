@@ -0,0 +1,72 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CUBIQUITY_CHUNKFILTER_H_
+#define CUBIQUITY_CHUNKFILTER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace Cubiquity
+{
+	class ChunkCodec;
+
+	namespace ChunkFilters
+	{
+		// Stored as the first byte of each chunk in a voxel database which uses filters, so the values must not change.
+		enum ChunkFilter
+		{
+			None = 0, // The voxels as they are.
+			BytePlanes = 1, // The first byte of every voxel, then the second byte of every voxel, and so on. For MaterialSet this puts each material together.
+			BytePlanesDelta = 2, // As above, but each byte is stored as the difference from the previous voxel (along X). Suits smoothly changing materials.
+			Palette = 3 // A table of the distinct voxels (up to 256) followed by an index into it for each voxel. Suits colored cubes.
+		};
+	}
+	typedef ChunkFilters::ChunkFilter ChunkFilter;
+
+	// Chunks compress better when similar bytes are next to each other, which isn't the case for the voxels as they are stored in memory (e.g. the
+	// four channels of a Color are interleaved). These transforms rearrange the voxels (in linear order) before they are compressed, and are reversed
+	// after decompression. Which one works best depends on the chunk, so they are all tried and the smallest result is kept.
+
+	// Applies each filter which is possible for the data and keeps the one which compresses best. The candidates are compared by compressing them
+	// with 'codec' if it is a fast one, and otherwise with the fast codec, as it would be too slow to try them all with e.g. zlib. The filtered data
+	// is written to 'filtered'.
+	ChunkFilter applyBestChunkFilter(const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, const ChunkCodec* codec, std::vector<uint8_t>& filtered);
+
+	// Applies a particular filter, returning false if it isn't possible for the data (a palette with too many voxels).
+	bool applyChunkFilter(ChunkFilter filter, const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes, std::vector<uint8_t>& filtered);
+
+	// The size of the filtered data for a chunk of the given size. Throws a CompressionError if the filter is unknown.
+	uint32_t getFilteredChunkLength(ChunkFilter filter, uint32_t srcLength, uint32_t voxelSizeInBytes);
+
+	// The size of the elements which make up the filtered data, for passing to the ChunkCodec. Only the unfiltered
+	// data is still made of voxels, as the others split the voxels into bytes.
+	uint32_t getFilteredChunkElementSize(ChunkFilter filter, uint32_t voxelSizeInBytes);
+
+	// Reverses the filter. The filtered data must be getFilteredChunkLength() bytes.
+	void removeChunkFilter(ChunkFilter filter, const uint8_t* filtered, uint32_t filteredLength, uint32_t voxelSizeInBytes, uint8_t* dst, uint32_t dstLength);
+}
+
+#endif //CUBIQUITY_CHUNKFILTER_H_
@@ -0,0 +1,61 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef CUBIQUITY_CHUNKPAGEOUTTASK_H_
+#define CUBIQUITY_CHUNKPAGEOUTTASK_H_
+
+#include "CubiquityForwardDeclarations.h"
+#include "Task.h"
+
+#include "PolyVox/PagedVolume.h"
+
+namespace Cubiquity
+{
+	// Writes modified chunks which have been evicted to the voxel database, so that the eviction itself doesn't have to (see
+	// PagedVolume::setDeferredPageOut()). Each stage writes one batch, in a single transaction, and the task keeps going until
+	// the queue is empty. These run on the prefetch processor, which is the one doing the rest of the database access. Once the
+	// last stage is done the processor deletes the task (see Task::onFinished()), and the volume makes a new one when it's needed.
+	template <typename VoxelType>
+	class ChunkPageOutTask : public Task
+	{
+	public:
+		ChunkPageOutTask(::PolyVox::PagedVolume<VoxelType>* polyVoxVolume)
+			:Task()
+			,mPolyVoxVolume(polyVoxVolume)
+		{
+		}
+
+		bool process(void)
+		{
+			// Small enough that a chunk which is needed while it's batch is being written isn't kept waiting for long.
+			const uint32_t maxChunksPerBatch = 16;
+			mPolyVoxVolume->pageOutQueuedChunks(maxChunksPerBatch);
+			return mPolyVoxVolume->getNoOfQueuedChunks() > 0;
+		}
+
+		::PolyVox::PagedVolume<VoxelType>* mPolyVoxVolume;
+	};
+}
+
+#endif //CUBIQUITY_CHUNKPAGEOUTTASK_H_
@@ -0,0 +1,63 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef CUBIQUITY_CHUNKPREFETCHTASK_H_
+#define CUBIQUITY_CHUNKPREFETCHTASK_H_
+
+#include "CubiquityForwardDeclarations.h"
+#include "Region.h"
+#include "Task.h"
+
+#include "PolyVox/PagedVolume.h"
+
+namespace Cubiquity
+{
+	// Pages in the voxel data which a node's surface extraction will need, so that when the node becomes active the extraction
+	// task finds it already in memory. These run on the prefetch processor rather than with the surface extraction tasks, and
+	// nothing waits for the result so the processor deletes them when they are done.
+	template <typename VoxelType>
+	class ChunkPrefetchTask : public Task
+	{
+	public:
+		ChunkPrefetchTask(OctreeNode<VoxelType>* octreeNode, ::PolyVox::PagedVolume<VoxelType>* polyVoxVolume, const Region& region)
+			:Task()
+			,mOctreeNode(octreeNode)
+			,mPolyVoxVolume(polyVoxVolume)
+			,mRegion(region)
+		{
+		}
+
+		bool process(void)
+		{
+			mPolyVoxVolume->prefetch(mRegion);
+			return false;
+		}
+
+		OctreeNode<VoxelType>* mOctreeNode;
+		::PolyVox::PagedVolume<VoxelType>* mPolyVoxVolume;
+		Region mRegion;
+	};
+}
+
+#endif //CUBIQUITY_CHUNKPREFETCHTASK_H_
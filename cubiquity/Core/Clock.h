@@ -25,11 +25,14 @@
 #ifndef CUBIQUITY_CLOCK_H
 #define CUBIQUITY_CLOCK_H
 
+#include <atomic>
 #include <cstdint>
 
 namespace Cubiquity
 {
-	typedef uint32_t Timestamp;
+	// 64 bits so that the clock never wraps around. Even a server taking a billion timestamps
+	// per second would need centuries, whereas 32 bits would wrap within a few seconds.
+	typedef uint64_t Timestamp;
 
 	class Clock
 	{
@@ -37,9 +40,13 @@ namespace Cubiquity
 		static Timestamp getTimestamp(void);
 
 	private:
-		// This should be atomic but I don't have a recent enough version of boost.
-		// This will be addressed in the future with a new boost version or C++11.
-		static Timestamp mTimestamp;
+		// Atomic because timestamps are taken by the background threads as well as the main thread.
+		//
+		// Note that we don't hand out batches of timestamps to each thread, even though it would avoid contention on this
+		// variable. The surface extraction relies on timestamps being ordered in the same way as the events they record (a
+		// task which started after an edit must have a larger timestamp) and a thread using up an old batch would break that.
+		// In practice the contention is low anyway, as the worker threads only take one timestamp per task.
+		static std::atomic<Timestamp> mTimestamp;
 	};
 }
 
@@ -37,26 +37,32 @@ namespace Cubiquity
 	public:
 		typedef Color VoxelType;
 
-		ColoredCubesVolume(const Region& region, const std::string& pathToNewVoxelDatabase, unsigned int baseNodeSize)
-			:Volume<Color>(region, pathToNewVoxelDatabase, baseNodeSize)
+		ColoredCubesVolume(const Region& region, const std::string& pathToNewVoxelDatabase, unsigned int baseNodeSize, const VolumeOptions& options = VolumeOptions())
+			:Volume<Color>(region, pathToNewVoxelDatabase, baseNodeSize, options)
 		{
 			m_pVoxelDatabase->setProperty("VoxelType", "Color");
 
+			// Most chunks only contain a few different colors, so can be kept in memory as indices into a palette (see PagedVolume).
+			_getPolyVoxVolume()->setPaletteCompression(true);
+
 			mOctree = new Octree<VoxelType>(this, OctreeConstructionModes::BoundVoxels, baseNodeSize);
 		}
 
-		ColoredCubesVolume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, unsigned int baseNodeSize)
-			:Volume<Color>(pathToExistingVoxelDatabase, writePermission, baseNodeSize)
+		ColoredCubesVolume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, unsigned int baseNodeSize, const VolumeOptions& options = VolumeOptions())
+			:Volume<Color>(pathToExistingVoxelDatabase, writePermission, baseNodeSize, options)
 		{
 			std::string voxelType = m_pVoxelDatabase->getPropertyAsString("VoxelType", "");
 			POLYVOX_THROW_IF(voxelType != "Color", std::runtime_error, "VoxelDatabase does not have the expected VoxelType of 'Color'");
 
+			// Most chunks only contain a few different colors, so can be kept in memory as indices into a palette (see PagedVolume).
+			_getPolyVoxVolume()->setPaletteCompression(true);
+
 			mOctree = new Octree<VoxelType>(this, OctreeConstructionModes::BoundVoxels, baseNodeSize);
 		}
 
 		virtual ~ColoredCubesVolume()
 		{
-			delete mOctree;
+			// The octree is deleted by the base class, once the background tasks which refer to it have been stopped.
 		}
 	};
 }
@@ -66,6 +66,9 @@ namespace Cubiquity
 		,mPolyVoxMesh(0)
 		,mProcessingStartedTimestamp((std::numeric_limits<Timestamp>::max)())
 		,mOwnMesh(false)
+		,mStage(SurfaceExtractionStages::Gather)
+		,mGatheredVolume(0)
+		,mResampledVolume(0)
 	{
 	}
 
@@ -77,60 +80,100 @@ namespace Cubiquity
 			mPolyVoxMesh = 0;
 			mOwnMesh = false;
 		}
+
+		// Only set if the task was discarded part way through.
+		delete mGatheredVolume;
+		mGatheredVolume = 0;
+		delete mResampledVolume;
+		mResampledVolume = 0;
 	}
 
-	void ColoredCubicSurfaceExtractionTask::process(void)
+	bool ColoredCubicSurfaceExtractionTask::cancel(void)
 	{
-		mProcessingStartedTimestamp = Clock::getTimestamp();
-
-		Region lod0Region = mOctreeNode->mRegion;
-
-		//Extract the surface
-		mPolyVoxMesh = new ColoredCubesMesh;
-		mOwnMesh = true;
-
-		uint32_t downScaleFactor = 0x0001 << mOctreeNode->mHeight;
-
-		ColoredCubesIsQuadNeeded isQuadNeeded;
+		Timestamp notStarted = (std::numeric_limits<Timestamp>::max)();
+		return mProcessingStartedTimestamp.compare_exchange_strong(notStarted, CancelledTimestamp);
+	}
 
-		if(downScaleFactor == 1) 
+	bool ColoredCubicSurfaceExtractionTask::process(void)
+	{
+		switch(mStage)
+		{
+		case SurfaceExtractionStages::Gather:
 		{
-			extractCubicMeshCustom(mPolyVoxVolume, mOctreeNode->mRegion, mPolyVoxMesh, isQuadNeeded, true);
+			// The timestamp must be taken *before* we read any voxels. Edits take their timestamp after writing the voxels,
+			// so any edit which we fail to see is guaranteed to have a later timestamp (and so will trigger a new extraction).
+			// Setting it also marks the task as started, which must be done atomically as the main thread may be cancelling it.
+			Timestamp notStarted = (std::numeric_limits<Timestamp>::max)();
+			if(!mProcessingStartedTimestamp.compare_exchange_strong(notStarted, Clock::getTimestamp()))
+			{
+				mStage = SurfaceExtractionStages::Finished;
+				return false;
+			}
+
+			gather();
+			mStage = (mOctreeNode->mHeight > 0) ? SurfaceExtractionStages::Downsample : SurfaceExtractionStages::Extract;
+			return true;
 		}
-		else if(downScaleFactor == 2)
+		case SurfaceExtractionStages::Downsample:
 		{
-		
-			Region srcRegion = mOctreeNode->mRegion;
-
-			srcRegion.grow(2);
+			downsample();
+			mStage = SurfaceExtractionStages::Extract;
+			return true;
+		}
+		case SurfaceExtractionStages::Extract:
+		{
+			extract();
+			mStage = SurfaceExtractionStages::Finished;
+			return false;
+		}
+		default:
+		{
+			POLYVOX_THROW(std::logic_error, "Surface extraction task processed after it had finished");
+		}
+		}
 
-			Vector3I lowerCorner = srcRegion.getLowerCorner();
-			Vector3I upperCorner = srcRegion.getUpperCorner();
+		return false; // Not reached, but POLYVOX_THROW isn't marked as not returning.
+	}
 
-			upperCorner = upperCorner - lowerCorner;
-			upperCorner = upperCorner / static_cast<int32_t>(downScaleFactor);
-			upperCorner = upperCorner + lowerCorner;
+	void ColoredCubicSurfaceExtractionTask::onFinished(void)
+	{
+		mOctreeNode->mOctree->mFinishedSurfaceExtractionTasks.push(this);
+	}
 
-			Region dstRegion(lowerCorner, upperCorner);
+	void ColoredCubicSurfaceExtractionTask::onFailed(void)
+	{
+		mStage = SurfaceExtractionStages::Failed;
+		onFinished();
+	}
 
-			::PolyVox::RawVolume<Color> resampledVolume(dstRegion);
-			rescaleCubicVolume(mPolyVoxVolume, srcRegion, &resampledVolume, dstRegion);
+	void ColoredCubicSurfaceExtractionTask::gather(void)
+	{
+		uint32_t downScaleFactor = 0x0001 << mOctreeNode->mHeight;
 
-			dstRegion.shrink(1);
-		
-			//dstRegion.shiftLowerCorner(-1, -1, -1);
+		// Downsampling needs a border of the same size as the scale factor. On top of that the downsampling peeks up to two voxels
+		// beyond each block it averages, and the extractor looks one voxel beyond the region, so we add a bit more.
+		Region gatherRegion = mOctreeNode->mRegion;
+		if(downScaleFactor > 1)
+		{
+			gatherRegion.grow(downScaleFactor);
+		}
+		gatherRegion.grow(2);
 
-			extractCubicMeshCustom(&resampledVolume, dstRegion, mPolyVoxMesh, isQuadNeeded, true);
+		mGatheredVolume = new ::PolyVox::RawVolume<Color>(gatherRegion);
+		gatherVoxels(mPolyVoxVolume, mGatheredVolume);
+	}
 
-			scaleVertices(mPolyVoxMesh, downScaleFactor);
-			//translateVertices(mPolyVoxMesh, Vector3DFloat(0.5f, 0.5f, 0.5f)); // Removed when going from float positions to uin8_t. Do we need this?
-		}
-		else if(downScaleFactor == 4)
-		{
-			Region srcRegion = mOctreeNode->mRegion;
+	void ColoredCubicSurfaceExtractionTask::downsample(void)
+	{
+		uint32_t downScaleFactor = 0x0001 << mOctreeNode->mHeight;
 
-			srcRegion.grow(4);
+		Region srcRegion = mOctreeNode->mRegion;
+		srcRegion.grow(downScaleFactor);
 
+		// Each pass halves the resolution, averaging 2x2x2 blocks.
+		::PolyVox::RawVolume<Color>* srcVolume = mGatheredVolume;
+		for(uint32_t factor = downScaleFactor; factor > 1; factor /= 2)
+		{
 			Vector3I lowerCorner = srcRegion.getLowerCorner();
 			Vector3I upperCorner = srcRegion.getUpperCorner();
 
@@ -140,33 +183,55 @@ namespace Cubiquity
 
 			Region dstRegion(lowerCorner, upperCorner);
 
-			::PolyVox::RawVolume<Color> resampledVolume(dstRegion);
-			rescaleCubicVolume(mPolyVoxVolume, srcRegion, &resampledVolume, dstRegion);
+			::PolyVox::RawVolume<Color>* dstVolume = new ::PolyVox::RawVolume<Color>(dstRegion);
+			rescaleCubicVolume(srcVolume, srcRegion, dstVolume, dstRegion);
 
+			if(srcVolume != mGatheredVolume)
+			{
+				delete srcVolume;
+			}
 
+			srcVolume = dstVolume;
+			srcRegion = dstRegion;
+		}
 
-			lowerCorner = dstRegion.getLowerCorner();
-			upperCorner = dstRegion.getUpperCorner();
+		mResampledVolume = srcVolume;
 
-			upperCorner = upperCorner - lowerCorner;
-			upperCorner = upperCorner / static_cast<int32_t>(2);
-			upperCorner = upperCorner + lowerCorner;
+		delete mGatheredVolume;
+		mGatheredVolume = 0;
+	}
+
+	void ColoredCubicSurfaceExtractionTask::extract(void)
+	{
+		//Extract the surface
+		mPolyVoxMesh = new ColoredCubesMesh;
+		mOwnMesh = true;
+
+		ColoredCubesIsQuadNeeded isQuadNeeded;
 
-			Region dstRegion2(lowerCorner, upperCorner);
+		if(mOctreeNode->mHeight == 0)
+		{
+			extractCubicMeshCustom(mGatheredVolume, mOctreeNode->mRegion, mPolyVoxMesh, isQuadNeeded, true);
 
-			::PolyVox::RawVolume<Color> resampledVolume2(dstRegion2);
-			rescaleCubicVolume(&resampledVolume, dstRegion, &resampledVolume2, dstRegion2);
+			delete mGatheredVolume;
+			mGatheredVolume = 0;
+		}
+		else
+		{
+			uint32_t downScaleFactor = 0x0001 << mOctreeNode->mHeight;
 
-			dstRegion2.shrink(1);
+			Region dstRegion = mResampledVolume->getEnclosingRegion();
+			dstRegion.shrink(1);
 
 			//dstRegion.shiftLowerCorner(-1, -1, -1);
 
-			extractCubicMeshCustom(&resampledVolume2, dstRegion2, mPolyVoxMesh, isQuadNeeded, true);
+			extractCubicMeshCustom(mResampledVolume, dstRegion, mPolyVoxMesh, isQuadNeeded, true);
 
 			scaleVertices(mPolyVoxMesh, downScaleFactor);
-			//translateVertices(mPolyVoxMesh, Vector3DFloat(1.5f, 1.5f, 1.5f)); // Removed when going from float positions to uin8_t. Do we need this?
-		}
+			//translateVertices(mPolyVoxMesh, Vector3DFloat(0.5f, 0.5f, 0.5f)); // Removed when going from float positions to uin8_t. Do we need this?
 
-		mOctreeNode->mOctree->mFinishedSurfaceExtractionTasks.push(this);
+			delete mResampledVolume;
+			mResampledVolume = 0;
+		}
 	}
 }
@@ -29,11 +29,15 @@
 #include "Color.h"
 #include "CubiquityForwardDeclarations.h"
 #include "Region.h"
+#include "SurfaceExtractionStage.h"
 #include "Task.h"
 #include "Vector.h"
 #include "VoxelTraits.h"
 
 #include "PolyVox/PagedVolume.h"
+#include "PolyVox/RawVolume.h"
+
+#include <atomic>
 
 namespace Cubiquity
 {
@@ -43,17 +47,44 @@ namespace Cubiquity
 		ColoredCubicSurfaceExtractionTask(OctreeNode< Color >* octreeNode, ::PolyVox::PagedVolume<Color>* polyVoxVolume);
 		~ColoredCubicSurfaceExtractionTask();
 
-		void process(void);
+		bool process(void);
+
+		// Rather than being deleted, the finished task goes onto the octree's finished queue for the main thread to collect.
+		void onFinished(void);
+
+		// The task still goes onto the finished queue, but marked as failed so that the node gets scheduled again.
+		void onFailed(void);
+		bool hasFailed(void) { return mStage == SurfaceExtractionStages::Failed; }
+
+		// Cancels the task if processing has not yet started, and returns whether it succeeded. A cancelled task is still handed
+		// back through the finished queue (so it can be deleted) but without having extracted a mesh. Main thread only.
+		bool cancel(void);
+		bool isCancelled(void) { return mProcessingStartedTimestamp == CancelledTimestamp; }
+
+		// Clock never hands out zero, so we use it to mark tasks which have been cancelled.
+		static const Timestamp CancelledTimestamp = 0;
 
 	public:
 		OctreeNode< Color >* mOctreeNode;
 		::PolyVox::PagedVolume<Color>* mPolyVoxVolume;
 		ColoredCubesMesh* mPolyVoxMesh;
-		Timestamp mProcessingStartedTimestamp;
+		// Read by the main thread (when deciding whether to reschedule) while a worker thread may be setting it.
+		std::atomic<Timestamp> mProcessingStartedTimestamp;
 
 		// Whether the task owns the mesh, or whether it has been passed to
 		// the OctreeNode. Should probably switch this to use a smart pointer.
 		bool mOwnMesh;
+
+	private:
+		void gather(void);
+		void downsample(void);
+		void extract(void);
+
+		SurfaceExtractionStage mStage;
+
+		// Intermediate data which is passed between the stages.
+		::PolyVox::RawVolume<Color>* mGatheredVolume;
+		::PolyVox::RawVolume<Color>* mResampledVolume;
 	};
 
 	template< typename SrcPolyVoxVolumeType, typename DstPolyVoxVolumeType>
@@ -77,28 +108,26 @@ namespace Cubiquity
 					Vector3I srcPos = regSrc.getLowerCorner() + (Vector3I(x, y, z) * 2);
 					Vector3I dstPos = regDst.getLowerCorner() + Vector3I(x, y, z);
 
+					// The eight children are all within one voxel of the first, so we can peek at them rather than moving the sampler.
+					srcSampler.setPosition(srcPos);
+					Color children[8] =
+					{
+						srcSampler.peekVoxel0px0py0pz(), srcSampler.peekVoxel1px0py0pz(), srcSampler.peekVoxel0px1py0pz(), srcSampler.peekVoxel1px1py0pz(),
+						srcSampler.peekVoxel0px0py1pz(), srcSampler.peekVoxel1px0py1pz(), srcSampler.peekVoxel0px1py1pz(), srcSampler.peekVoxel1px1py1pz()
+					};
+
 					uint32_t noOfSolidVoxels = 0;
 					uint32_t averageOf8Red = 0;
 					uint32_t averageOf8Green = 0;
 					uint32_t averageOf8Blue = 0;
-					for(int32_t childZ = 0; childZ < 2; childZ++)
+					for(uint32_t child = 0; child < 8; child++)
 					{
-						for(int32_t childY = 0; childY < 2; childY++)
+						if(children[child].getAlpha () > 0)
 						{
-							for(int32_t childX = 0; childX < 2; childX++)
-							{
-								srcSampler.setPosition(srcPos + Vector3I(childX, childY, childZ));
-
-								Color child = srcSampler.getVoxel();
-
-								if(child.getAlpha () > 0)
-								{
-									noOfSolidVoxels++;
-									averageOf8Red += child.getRed();
-									averageOf8Green += child.getGreen();
-									averageOf8Blue += child.getBlue();
-								}
-							}
+							noOfSolidVoxels++;
+							averageOf8Red += children[child].getRed();
+							averageOf8Green += children[child].getGreen();
+							averageOf8Blue += children[child].getBlue();
 						}
 					}
 
@@ -159,10 +188,9 @@ namespace Cubiquity
 							{
 								for(int32_t childY = -1; childY < 3; childY++)
 								{
+									srcSampler.setPosition(srcPos + Vector3I(-1, childY, childZ));
 									for(int32_t childX = -1; childX < 3; childX++)
 									{
-										srcSampler.setPosition(srcPos + Vector3I(childX, childY, childZ));
-
 										Color child = srcSampler.getVoxel();
 
 										if(child.getAlpha () > 0)
@@ -182,7 +210,9 @@ namespace Cubiquity
 											totalBlue += child.getBlue() * exposedFaces;
 
 											totalExposedFaces += exposedFaces;
-										}							
+										}
+
+										srcSampler.movePositiveX();
 									}
 								}
 							}
@@ -6,67 +6,109 @@
 #ifndef CUBIQUITY_CONCURRENTQUEUE_H
 #define CUBIQUITY_CONCURRENTQUEUE_H
 
+#include <algorithm>
 #include <cstdint>
-#include <queue>
+#include <limits>
+#include <mutex>
+#include <vector>
 
 namespace Cubiquity
 {
-	// FIXME: THIS QUEUE IS CURRENTLY NOT THREAD SAFE DESPITE IT'S NAME. THE THREADING CODE WAS BASED ON BOOST AND IS COMMENTED OUT
-	// PENDING A STD C++ VERSION. THE STD FUNCTIONS/TYPES DO NOT HAVE A ONE-TO-ONE CORRESPONDANCE TO THE BOOST FUNCTIONS/TYPES SO
-	// I WANT TO TAKE SOME CARE OVER THIS.
+	// A multi-producer, multi-consumer priority queue. A single mutex protects the underlying heap, which is fine
+	// for our usage as the work done per item (surface extraction) is vastly more than the cost of the lock.
+	// Consumers which want several items at once should use try_pop_batch() to only take the lock once.
+	//
+	// There is no blocking pop, as none of our consumers wait on a single queue. The BackgroundTaskProcessor's workers
+	// wait on it's own condition variable (they choose between the queues of several groups) while the main thread polls.
+	//
+	// We manage the heap ourselves (rather than using std::priority_queue) so that update_and_filter() can
+	// reach the items, as the priorities of queued tasks change when the camera moves.
 	template<class Data, class Compare>
 	class concurrent_queue
 	{
 	private:
-		std::priority_queue<Data, std::vector<Data>, Compare> the_queue;
-		//mutable boost::mutex the_mutex;
-		//boost::condition_variable the_condition_variable;
+		std::vector<Data> the_queue;
+		Compare the_compare;
+		mutable std::mutex the_mutex;
 	public:
 		void push(Data const& data)
 		{
-			//boost::mutex::scoped_lock lock(the_mutex);
-			the_queue.push(data);
-			//lock.unlock();
-			//the_condition_variable.notify_one();
+			std::lock_guard<std::mutex> lock(the_mutex);
+			the_queue.push_back(data);
+			std::push_heap(the_queue.begin(), the_queue.end(), the_compare);
 		}
 
 		bool empty() const
 		{
-			//boost::mutex::scoped_lock lock(the_mutex);
+			std::lock_guard<std::mutex> lock(the_mutex);
 			return the_queue.empty();
 		}
 
 		uint32_t size() const
 		{
-			//boost::mutex::scoped_lock lock(the_mutex);
+			std::lock_guard<std::mutex> lock(the_mutex);
 			return the_queue.size();
 		}
 
 		bool try_pop(Data& popped_value)
 		{
-			//boost::mutex::scoped_lock lock(the_mutex);
+			std::lock_guard<std::mutex> lock(the_mutex);
 			if(the_queue.empty())
 			{
 				return false;
 			}
         
-			popped_value=the_queue.top();
-			the_queue.pop();
+			pop_top(popped_value);
 			return true;
 		}
 
-		void wait_and_pop(Data& popped_value)
+		// Appends up to 'max_items' items (highest priority first) to 'popped_values' and returns how many were added. Never blocks.
+		uint32_t try_pop_batch(std::vector<Data>& popped_values, uint32_t max_items = (std::numeric_limits<uint32_t>::max)())
 		{
-			//boost::mutex::scoped_lock lock(the_mutex);
-			//while(the_queue.empty())
-			//{
-			//	the_condition_variable.wait(lock);
-			//}
-        
-			popped_value=the_queue.top();
-			the_queue.pop();
+			std::lock_guard<std::mutex> lock(the_mutex);
+			uint32_t no_of_popped_values = 0;
+			while((!the_queue.empty()) && (no_of_popped_values < max_items))
+			{
+				Data popped_value;
+				pop_top(popped_value);
+				popped_values.push_back(popped_value);
+				no_of_popped_values++;
+			}
+			return no_of_popped_values;
 		}
 
+		// Calls 'func' on every item in the queue. Items for which it returns false are removed and appended to 'removed_values',
+		// and the remaining items are reordered afterwards so 'func' is free to change their priorities. This is O(n) in the
+		// number of queued items and holds the lock throughout, so 'func' should be cheap and must not access the queue.
+		template<typename Func>
+		void update_and_filter(Func func, std::vector<Data>& removed_values)
+		{
+			std::lock_guard<std::mutex> lock(the_mutex);
+			typename std::vector<Data>::iterator kept_end = the_queue.begin();
+			for(typename std::vector<Data>::iterator iter = the_queue.begin(); iter != the_queue.end(); iter++)
+			{
+				if(func(*iter))
+				{
+					*kept_end = *iter;
+					kept_end++;
+				}
+				else
+				{
+					removed_values.push_back(*iter);
+				}
+			}
+			the_queue.erase(kept_end, the_queue.end());
+			std::make_heap(the_queue.begin(), the_queue.end(), the_compare);
+		}
+
+	private:
+		// The caller must hold the lock, and the queue must not be empty.
+		void pop_top(Data& popped_value)
+		{
+			std::pop_heap(the_queue.begin(), the_queue.end(), the_compare);
+			popped_value = the_queue.back();
+			the_queue.pop_back();
+		}
 	};
 }
 
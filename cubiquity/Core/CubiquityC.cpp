@@ -30,6 +30,7 @@
 #include "Brush.h"
 #include "ColoredCubesVolume.h"
 #include "Logging.h"
+#include "MemoryLimit.h"
 #include "OctreeNode.h"
 #include "Raycasting.h"
 #include "TerrainVolume.h"
@@ -61,7 +62,7 @@ using namespace std;
 // I still think the Unity/Unreal wrapper version numbers should follow the Cubiquity ones, and this will be less
 // disruptive once the Cubiquity ones are more settled.
 const uint32_t CuMajorVersion = 1;
-const uint32_t CuMinorVersion = 3;
+const uint32_t CuMinorVersion = 4;
 const uint32_t CuPatchVersion = 0;
 const uint32_t CuBuildVersion = 0;
 
@@ -180,6 +181,23 @@ TerrainVolume* getTerrainVolumeFromHandle(uint32_t volumeIndex)
 	return volume;
 }
 
+// A null pointer means all the defaults should be used.
+VolumeOptions getVolumeOptions(const CuVolumeOptions* options)
+{
+	VolumeOptions volumeOptions;
+	if (options)
+	{
+		volumeOptions.memoryBudgetInBytes = options->memoryBudgetInBytes;
+		volumeOptions.chunkSideLength = options->chunkSideLength;
+		volumeOptions.compressedCacheBudgetInBytes = options->compressedCacheBudgetInBytes;
+		volumeOptions.chunkCompression = static_cast<ChunkCompression>(options->chunkCompression);
+		volumeOptions.useChunkFilters = (options->useChunkFilters != 0);
+		volumeOptions.databaseProfile = static_cast<DatabaseProfile>(options->databaseProfile);
+		volumeOptions.vacuumMode = static_cast<VacuumMode>(options->vacuumMode);
+	}
+	return volumeOptions;
+}
+
 uint32_t encodeHandle(uint32_t volumeType, uint32_t volumeIndex, uint32_t nodeIndex)
 {
 	uint32_t handle = volumeType << (TotalHandleBits - 1);
@@ -346,10 +364,15 @@ CUBIQUITYC_API CuColor cuMakeColor(uint8_t red, uint8_t green, uint8_t blue, uin
 // Volume functions
 ////////////////////////////////////////////////////////////////////////////////
 CUBIQUITYC_API int32_t cuNewEmptyColoredCubesVolume(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, uint32_t* result)
+{
+	return cuNewEmptyColoredCubesVolumeWithOptions(lowerX, lowerY, lowerZ, upperX, upperY, upperZ, pathToNewVoxelDatabase, baseNodeSize, 0, result);
+}
+
+CUBIQUITYC_API int32_t cuNewEmptyColoredCubesVolumeWithOptions(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result)
 {
 	OPEN_C_INTERFACE
 
-	ColoredCubesVolume* volume = new ColoredCubesVolume(Region(lowerX, lowerY, lowerZ, upperX, upperY, upperZ), pathToNewVoxelDatabase, baseNodeSize);
+	ColoredCubesVolume* volume = new ColoredCubesVolume(Region(lowerX, lowerY, lowerZ, upperX, upperY, upperZ), pathToNewVoxelDatabase, baseNodeSize, getVolumeOptions(options));
 	volume->markAsModified(volume->getEnclosingRegion());
 
 	// Replace an existing entry if it has been deleted.
@@ -376,12 +399,17 @@ CUBIQUITYC_API int32_t cuNewEmptyColoredCubesVolume(int32_t lowerX, int32_t lowe
 }
 
 CUBIQUITYC_API int32_t cuNewColoredCubesVolumeFromVDB(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, uint32_t* result)
+{
+	return cuNewColoredCubesVolumeFromVDBWithOptions(pathToExistingVoxelDatabase, writePermissions, baseNodeSize, 0, result);
+}
+
+CUBIQUITYC_API int32_t cuNewColoredCubesVolumeFromVDBWithOptions(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result)
 {
 	OPEN_C_INTERFACE
 
 	// Fixme - Find out how to pass this write permissions enum properly.
 	WritePermission cubiquityWritePermissions = (writePermissions == CU_READONLY) ? WritePermissions::ReadOnly : WritePermissions::ReadWrite;
-	ColoredCubesVolume* volume = new ColoredCubesVolume(pathToExistingVoxelDatabase, cubiquityWritePermissions, baseNodeSize);
+	ColoredCubesVolume* volume = new ColoredCubesVolume(pathToExistingVoxelDatabase, cubiquityWritePermissions, baseNodeSize, getVolumeOptions(options));
 	volume->markAsModified(volume->getEnclosingRegion());
 
 	// Replace an existing entry if it has been deleted.
@@ -408,6 +436,12 @@ CUBIQUITYC_API int32_t cuNewColoredCubesVolumeFromVDB(const char* pathToExisting
 }
 
 CUBIQUITYC_API int32_t cuUpdateVolume(uint32_t volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint32_t* isUpToDate)
+{
+	// A budget of zero means there is no limit on how much work is done.
+	return cuUpdateVolumeWithBudget(volumeHandle, eyePosX, eyePosY, eyePosZ, lodThreshold, 0, isUpToDate);
+}
+
+CUBIQUITYC_API int32_t cuUpdateVolumeWithBudget(uint32_t volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint32_t budgetInMicroseconds, uint32_t* isUpToDate)
 {
 	OPEN_C_INTERFACE
 
@@ -417,12 +451,12 @@ CUBIQUITYC_API int32_t cuUpdateVolume(uint32_t volumeHandle, float eyePosX, floa
 	if (volumeType == CU_COLORED_CUBES)
 	{
 		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
-		*isUpToDate = volume->update(Vector3F(eyePosX, eyePosY, eyePosZ), lodThreshold);
+		*isUpToDate = volume->update(Vector3F(eyePosX, eyePosY, eyePosZ), lodThreshold, budgetInMicroseconds);
 	}
 	else
 	{
 		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
-		*isUpToDate = volume->update(Vector3F(eyePosX, eyePosY, eyePosZ), lodThreshold);
+		*isUpToDate = volume->update(Vector3F(eyePosX, eyePosY, eyePosZ), lodThreshold, budgetInMicroseconds);
 	}
 
 	CLOSE_C_INTERFACE
@@ -489,6 +523,202 @@ CUBIQUITYC_API int32_t cuGetEnclosingRegion(uint32_t volumeHandle, int32_t* lowe
 	CLOSE_C_INTERFACE
 }
 
+CUBIQUITYC_API int32_t cuSetVolumeMemoryBudget(uint32_t volumeHandle, uint64_t memoryBudgetInBytes)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		volume->setMemoryBudget(memoryBudgetInBytes);
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		volume->setMemoryBudget(memoryBudgetInBytes);
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuGetVolumeMemoryUsage(uint32_t volumeHandle, uint64_t* result)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		*result = volume->getMemoryUsage();
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		*result = volume->getMemoryUsage();
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuSetPrefetchLookAhead(uint32_t volumeHandle, float lookAheadInSeconds)
+{
+	OPEN_C_INTERFACE
+
+	POLYVOX_THROW_IF(lookAheadInSeconds < 0.0f, std::invalid_argument, "Prefetch look-ahead cannot be negative");
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		volume->getOctree()->mPrefetchLookAheadInSeconds = lookAheadInSeconds;
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		volume->getOctree()->mPrefetchLookAheadInSeconds = lookAheadInSeconds;
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuGetPagingCounters(uint32_t volumeHandle, uint64_t* noOfHits, uint64_t* noOfMisses, uint64_t* noOfPrefetchedChunks)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		::PolyVox::PagedVolume<Color>::PagingStatistics statistics = volume->getPagingStatistics();
+		*noOfHits = statistics.uNoOfHits;
+		*noOfMisses = statistics.uNoOfMisses;
+		*noOfPrefetchedChunks = statistics.uNoOfPrefetchedChunks;
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		::PolyVox::PagedVolume<MaterialSet>::PagingStatistics statistics = volume->getPagingStatistics();
+		*noOfHits = statistics.uNoOfHits;
+		*noOfMisses = statistics.uNoOfMisses;
+		*noOfPrefetchedChunks = statistics.uNoOfPrefetchedChunks;
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuSetVolumeCompressedCacheBudget(uint32_t volumeHandle, uint64_t compressedCacheBudgetInBytes)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		volume->setCompressedCacheBudget(compressedCacheBudgetInBytes);
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		volume->setCompressedCacheBudget(compressedCacheBudgetInBytes);
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuGetCompressedCacheCounters(uint32_t volumeHandle, uint64_t* noOfHits, uint64_t* sizeInBytes)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		::PolyVox::PagedVolume<Color>::PagingStatistics statistics = volume->getPagingStatistics();
+		*noOfHits = statistics.uNoOfCompressedCacheHits;
+		*sizeInBytes = statistics.uCompressedCacheSizeInBytes;
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		::PolyVox::PagedVolume<MaterialSet>::PagingStatistics statistics = volume->getPagingStatistics();
+		*noOfHits = statistics.uNoOfCompressedCacheHits;
+		*sizeInBytes = statistics.uCompressedCacheSizeInBytes;
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Memory functions
+////////////////////////////////////////////////////////////////////////////////
+CUBIQUITYC_API int32_t cuSetProcessMemoryLimit(uint64_t limitInBytes)
+{
+	OPEN_C_INTERFACE
+
+	gMemoryLimit.setLimit(limitInBytes);
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuGetProcessMemoryUsage(uint64_t* result)
+{
+	OPEN_C_INTERFACE
+
+	*result = gMemoryLimit.getUsage();
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuSetMemoryPressureCallback(CuMemoryPressureCallback callback, void* userData)
+{
+	OPEN_C_INTERFACE
+
+	if (callback)
+	{
+		gMemoryLimit.setPressureCallback([callback, userData](MemoryPressure pressure, uint64_t usageInBytes, uint64_t limitInBytes)
+		{
+			callback(static_cast<uint32_t>(pressure), usageInBytes, limitInBytes, userData);
+		});
+	}
+	else
+	{
+		gMemoryLimit.setPressureCallback(MemoryLimit::PressureCallback());
+	}
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuReleaseMemory(uint64_t bytesToRelease, uint64_t* bytesReleased)
+{
+	OPEN_C_INTERFACE
+
+	*bytesReleased = gMemoryLimit.releaseMemory(bytesToRelease);
+
+	CLOSE_C_INTERFACE
+}
+
+CUBIQUITYC_API int32_t cuSetUseHugePages(uint32_t useHugePages)
+{
+	OPEN_C_INTERFACE
+
+	::PolyVox::MemoryPool::setUseHugePages(useHugePages != 0);
+
+	CLOSE_C_INTERFACE
+}
+
 CUBIQUITYC_API int32_t cuGetVoxel(uint32_t volumeHandle, int32_t x, int32_t y, int32_t z, void* result)
 {
 	OPEN_C_INTERFACE
@@ -580,13 +810,39 @@ CUBIQUITYC_API int32_t cuDiscardOverrideChunks(uint32_t volumeHandle)
 	CLOSE_C_INTERFACE
 }
 
+CUBIQUITYC_API int32_t cuVacuumVolumeDatabase(uint32_t volumeHandle)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		volume->vacuumDatabase();
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		volume->vacuumDatabase();
+	}
+
+	CLOSE_C_INTERFACE
+}
+
 //--------------------------------------------------------------------------------
 
 CUBIQUITYC_API int32_t cuNewEmptyTerrainVolume(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, uint32_t* result)
+{
+	return cuNewEmptyTerrainVolumeWithOptions(lowerX, lowerY, lowerZ, upperX, upperY, upperZ, pathToNewVoxelDatabase, baseNodeSize, 0, result);
+}
+
+CUBIQUITYC_API int32_t cuNewEmptyTerrainVolumeWithOptions(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result)
 {
 	OPEN_C_INTERFACE
 
-	TerrainVolume* volume = new TerrainVolume(Region(lowerX, lowerY, lowerZ, upperX, upperY, upperZ), pathToNewVoxelDatabase, baseNodeSize);
+	TerrainVolume* volume = new TerrainVolume(Region(lowerX, lowerY, lowerZ, upperX, upperY, upperZ), pathToNewVoxelDatabase, baseNodeSize, getVolumeOptions(options));
 	volume->markAsModified(volume->getEnclosingRegion());
 
 	// Replace an existing entry if it has been deleted.
@@ -613,12 +869,17 @@ CUBIQUITYC_API int32_t cuNewEmptyTerrainVolume(int32_t lowerX, int32_t lowerY, i
 }
 
 CUBIQUITYC_API int32_t cuNewTerrainVolumeFromVDB(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, uint32_t* result)
+{
+	return cuNewTerrainVolumeFromVDBWithOptions(pathToExistingVoxelDatabase, writePermissions, baseNodeSize, 0, result);
+}
+
+CUBIQUITYC_API int32_t cuNewTerrainVolumeFromVDBWithOptions(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result)
 {
 	OPEN_C_INTERFACE
 
 	// Fixme - Find out how to pass this write permissions enum properly.
 	WritePermission cubiquityWritePermissions = (writePermissions == CU_READONLY) ? WritePermissions::ReadOnly : WritePermissions::ReadWrite;
-	TerrainVolume* volume = new TerrainVolume(pathToExistingVoxelDatabase, cubiquityWritePermissions, baseNodeSize);
+	TerrainVolume* volume = new TerrainVolume(pathToExistingVoxelDatabase, cubiquityWritePermissions, baseNodeSize, getVolumeOptions(options));
 	volume->markAsModified(volume->getEnclosingRegion());
 
 	// Replace an existing entry if it has been deleted.
@@ -816,6 +1077,29 @@ CUBIQUITYC_API int32_t cuGetOctreeNode(uint32_t nodeHandle, CuOctreeNode* result
 	CLOSE_C_INTERFACE
 }
 
+CUBIQUITYC_API int32_t cuGetSurfaceExtractionTaskCounters(uint32_t volumeHandle, uint32_t* noOfCancelledTasks, uint32_t* noOfCoalescedTasks)
+{
+	OPEN_C_INTERFACE
+
+	uint32_t volumeType, volumeIndex, nodeIndex;
+	decodeHandle(volumeHandle, &volumeType, &volumeIndex, &nodeIndex);
+
+	if (volumeType == CU_COLORED_CUBES)
+	{
+		ColoredCubesVolume* volume = getColoredCubesVolumeFromHandle(volumeIndex);
+		*noOfCancelledTasks = volume->getOctree()->mNoOfCancelledTasks;
+		*noOfCoalescedTasks = volume->getOctree()->mNoOfCoalescedTasks;
+	}
+	else
+	{
+		TerrainVolume* volume = getTerrainVolumeFromHandle(volumeIndex);
+		*noOfCancelledTasks = volume->getOctree()->mNoOfCancelledTasks;
+		*noOfCoalescedTasks = volume->getOctree()->mNoOfCoalescedTasks;
+	}
+
+	CLOSE_C_INTERFACE
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Mesh functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -906,7 +1190,7 @@ CUBIQUITYC_API int32_t cuGetMesh(uint32_t nodeHandle, uint16_t* noOfVertices, vo
 ////////////////////////////////////////////////////////////////////////////////
 // Clock functions
 ////////////////////////////////////////////////////////////////////////////////
-CUBIQUITYC_API int32_t cuGetCurrentTime(uint32_t* result)
+CUBIQUITYC_API int32_t cuGetCurrentTime(uint64_t* result)
 {
 	OPEN_C_INTERFACE
 
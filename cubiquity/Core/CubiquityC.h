@@ -92,6 +92,27 @@ extern "C"
 	const uint32_t CU_TERRAIN = 1;
 	const uint32_t CU_UNKNOWN = 0xFFFFFFFF;
 
+	// C version of Cubiquity::MemoryPressures, passed to the memory pressure callback.
+	const uint32_t CU_MEMORY_LIMIT_EXCEEDED = 1;
+	const uint32_t CU_MEMORY_BUDGET_TOO_LOW = 2;
+	const uint32_t CU_MEMORY_PREFETCH_TOO_LARGE = 3;
+	const uint32_t CU_MEMORY_THRASHING = 4;
+
+	// C version of Cubiquity::ChunkCompressions, for CuVolumeOptions::chunkCompression.
+	const uint32_t CU_CHUNK_COMPRESSION_ZLIB = 0;
+	const uint32_t CU_CHUNK_COMPRESSION_FAST = 1;
+	const uint32_t CU_CHUNK_COMPRESSION_MAXIMUM = 2;
+	const uint32_t CU_CHUNK_COMPRESSION_RUN_LENGTH = 3;
+
+	// C version of Cubiquity::DatabaseProfiles, for CuVolumeOptions::databaseProfile.
+	const uint32_t CU_DATABASE_PROFILE_COMPATIBLE = 0;
+	const uint32_t CU_DATABASE_PROFILE_FAST = 1;
+
+	// C version of Cubiquity::VacuumModes, for CuVolumeOptions::vacuumMode.
+	const uint32_t CU_VACUUM_WHEN_FRAGMENTED = 0;
+	const uint32_t CU_VACUUM_ALWAYS = 1;
+	const uint32_t CU_VACUUM_NEVER = 2;
+
 	struct CuColor_s
 	{
 		uint32_t data;
@@ -140,10 +161,10 @@ extern "C"
 		int32_t posY;
 		int32_t posZ;
 
-		uint32_t structureLastChanged;
-		uint32_t propertiesLastChanged;
-		uint32_t meshLastChanged;
-		uint32_t nodeOrChildrenLastChanged;
+		uint64_t structureLastChanged;
+		uint64_t propertiesLastChanged;
+		uint64_t meshLastChanged;
+		uint64_t nodeOrChildrenLastChanged;
 
 		uint32_t childHandles[2][2][2];
 
@@ -153,6 +174,29 @@ extern "C"
 	};
 	typedef struct CuOctreeNode_s CuOctreeNode;
 
+	// Controls how a volume holds it's voxel data in memory. Zero means 'use the default' for any field. The chunk
+	// side length is stored in the voxel database when it is created, so when opening an existing one it should be zero.
+	// The compressed cache keeps recently evicted chunks in memory (on top of the memory budget) to avoid reading them
+	// from the database again. It can be disabled by passing zero to cuSetVolumeCompressedCacheBudget().
+	// The chunk compression is one of the CU_CHUNK_COMPRESSION_* values and, like the chunk side length, is stored in the voxel
+	// database when it is created. When opening an existing one the stored compression is used. The same goes for 'useChunkFilters',
+	// which makes the chunks smaller by rearranging them before they are compressed but means older versions can't read the database.
+	// The database profile (CU_DATABASE_PROFILE_*) and vacuum mode (CU_VACUUM_*) are not stored, and only affect this volume.
+	struct CuVolumeOptions_s
+	{
+		uint64_t memoryBudgetInBytes;
+		uint32_t chunkSideLength;
+		uint64_t compressedCacheBudgetInBytes;
+		uint32_t chunkCompression;
+		uint32_t useChunkFilters;
+		uint32_t databaseProfile;
+		uint32_t vacuumMode;
+	};
+	typedef struct CuVolumeOptions_s CuVolumeOptions;
+
+	// Called when memory is short, with one of the CU_MEMORY_* reasons. Note that this can be called from Cubiquity's background threads.
+	typedef void (*CuMemoryPressureCallback)(uint32_t reason, uint64_t usageInBytes, uint64_t limitInBytes, void* userData);
+
 	// Version functions
 	CUBIQUITYC_API int32_t cuGetVersionNumber(uint32_t* majorVersion, uint32_t* minorVersion, uint32_t* patchVersion, uint32_t* buildVersion);
 
@@ -175,16 +219,37 @@ extern "C"
 	// Volume functions
 	CUBIQUITYC_API int32_t cuNewEmptyColoredCubesVolume(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, uint32_t* result);
 	CUBIQUITYC_API int32_t cuNewColoredCubesVolumeFromVDB(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, uint32_t* result);
+	CUBIQUITYC_API int32_t cuNewEmptyColoredCubesVolumeWithOptions(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result);
+	CUBIQUITYC_API int32_t cuNewColoredCubesVolumeFromVDBWithOptions(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result);
 	CUBIQUITYC_API int32_t cuUpdateVolume(uint32_t volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint32_t* isUpToDate);
+	CUBIQUITYC_API int32_t cuUpdateVolumeWithBudget(uint32_t volumeHandle, float eyePosX, float eyePosY, float eyePosZ, float lodThreshold, uint32_t budgetInMicroseconds, uint32_t* isUpToDate);
 	CUBIQUITYC_API int32_t cuDeleteVolume(uint32_t volumeHandle);
 
 	CUBIQUITYC_API int32_t cuGetEnclosingRegion(uint32_t volumeHandle, int32_t* lowerX, int32_t* lowerY, int32_t* lowerZ, int32_t* upperX, int32_t* upperY, int32_t* upperZ);
 
+	CUBIQUITYC_API int32_t cuSetVolumeMemoryBudget(uint32_t volumeHandle, uint64_t memoryBudgetInBytes);
+	CUBIQUITYC_API int32_t cuGetVolumeMemoryUsage(uint32_t volumeHandle, uint64_t* result);
+	CUBIQUITYC_API int32_t cuSetPrefetchLookAhead(uint32_t volumeHandle, float lookAheadInSeconds);
+	CUBIQUITYC_API int32_t cuGetPagingCounters(uint32_t volumeHandle, uint64_t* noOfHits, uint64_t* noOfMisses, uint64_t* noOfPrefetchedChunks);
+	CUBIQUITYC_API int32_t cuSetVolumeCompressedCacheBudget(uint32_t volumeHandle, uint64_t compressedCacheBudgetInBytes);
+	CUBIQUITYC_API int32_t cuGetCompressedCacheCounters(uint32_t volumeHandle, uint64_t* noOfHits, uint64_t* sizeInBytes);
+
+	// Memory functions - these apply to all the volumes together. A limit of zero (the default) means there is no limit.
+	CUBIQUITYC_API int32_t cuSetProcessMemoryLimit(uint64_t limitInBytes);
+	CUBIQUITYC_API int32_t cuGetProcessMemoryUsage(uint64_t* result);
+	CUBIQUITYC_API int32_t cuSetMemoryPressureCallback(CuMemoryPressureCallback callback, void* userData);
+	CUBIQUITYC_API int32_t cuReleaseMemory(uint64_t bytesToRelease, uint64_t* bytesReleased);
+	// Backs the voxel data with huge pages where the operating system supports them (currently Linux). Only affects memory allocated afterwards.
+	CUBIQUITYC_API int32_t cuSetUseHugePages(uint32_t useHugePages);
+
 	CUBIQUITYC_API int32_t cuAcceptOverrideChunks(uint32_t volumeHandle);
 	CUBIQUITYC_API int32_t cuDiscardOverrideChunks(uint32_t volumeHandle);
+	CUBIQUITYC_API int32_t cuVacuumVolumeDatabase(uint32_t volumeHandle);
 
 	CUBIQUITYC_API int32_t cuNewEmptyTerrainVolume(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, uint32_t* result);
 	CUBIQUITYC_API int32_t cuNewTerrainVolumeFromVDB(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, uint32_t* result);
+	CUBIQUITYC_API int32_t cuNewEmptyTerrainVolumeWithOptions(int32_t lowerX, int32_t lowerY, int32_t lowerZ, int32_t upperX, int32_t upperY, int32_t upperZ, const char* pathToNewVoxelDatabase, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result);
+	CUBIQUITYC_API int32_t cuNewTerrainVolumeFromVDBWithOptions(const char* pathToExistingVoxelDatabase, uint32_t writePermissions, uint32_t baseNodeSize, const CuVolumeOptions* options, uint32_t* result);
 
 	CUBIQUITYC_API int32_t cuGetVolumeType(uint32_t volumeHandle, uint32_t* result);
 
@@ -196,13 +261,14 @@ extern "C"
 	CUBIQUITYC_API int32_t cuHasRootOctreeNode(uint32_t volumeHandle, uint32_t* result);
 	CUBIQUITYC_API int32_t cuGetRootOctreeNode(uint32_t volumeHandle, uint32_t* result);
 	CUBIQUITYC_API int32_t cuGetOctreeNode(uint32_t nodeHandle, CuOctreeNode* result);
+	CUBIQUITYC_API int32_t cuGetSurfaceExtractionTaskCounters(uint32_t volumeHandle, uint32_t* noOfCancelledTasks, uint32_t* noOfCoalescedTasks);
 
 	// Mesh functions
 	CUBIQUITYC_API int32_t cuSetLodRange(uint32_t volumeHandle, int32_t minimumLOD, int32_t maximumLOD);
 	CUBIQUITYC_API int32_t cuGetMesh(uint32_t nodeHandle, uint16_t* noOfVertices, void** vertices, uint32_t* noOfIndices, uint16_t** indices);
 
 	// Clock functions
-	CUBIQUITYC_API int32_t cuGetCurrentTime(uint32_t* result);
+	CUBIQUITYC_API int32_t cuGetCurrentTime(uint64_t* result);
 
 	// Raycasting functions
 	CUBIQUITYC_API int32_t cuPickFirstSolidVoxel(uint32_t volumeHandle, float rayStartX, float rayStartY, float rayStartZ, float rayDirX, float rayDirY, float rayDirZ, int32_t* resultX, int32_t* resultY, int32_t* resultZ, uint32_t* result);
@@ -28,6 +28,13 @@
 namespace Cubiquity
 {
 	class Brush;
+
+	template <typename VoxelType>
+	class ChunkPageOutTask;
+
+	template <typename VoxelType>
+	class ChunkPrefetchTask;
+
 	class Clock;
 
 	class Color;
@@ -0,0 +1,138 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#include "DatabaseProfile.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "SQLiteUtils.h"
+
+namespace Cubiquity
+{
+	// Negative cache sizes are in kilobytes rather than pages.
+	const int32_t FastCacheSizeInKilobytes = 32 * 1024;
+
+	// Memory mapping uses address space rather than memory, which is only plentiful on 64-bit platforms.
+	const int64_t FastMmapSizeInBytes = (sizeof(void*) >= 8) ? 256 * 1024 * 1024 : 0;
+
+	// Other connections (such as another volume using the same VDB) can briefly lock the database, in which case we wait rather than fail.
+	const int BusyTimeoutInMilliseconds = 1000;
+
+	// Vacuuming is skipped unless at least this fraction of the database is free pages.
+	const float FragmentedFreePageFraction = 0.25f;
+
+	void executePragma(sqlite3* database, const std::string& pragma)
+	{
+		EXECUTE_SQLITE_FUNC(sqlite3_exec(database, ("PRAGMA " + pragma).c_str(), 0, 0, 0));
+	}
+
+	int64_t queryPragma(sqlite3* database, const std::string& pragma)
+	{
+		sqlite3_stmt* statement = nullptr;
+		EXECUTE_SQLITE_FUNC(sqlite3_prepare_v2(database, ("PRAGMA " + pragma).c_str(), -1, &statement, NULL));
+		int64_t result = 0;
+		if (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			result = sqlite3_column_int64(statement, 0);
+		}
+		EXECUTE_SQLITE_FUNC(sqlite3_finalize(statement));
+		return result;
+	}
+
+	void applyDatabaseProfile(sqlite3* database, DatabaseProfile profile)
+	{
+		// Disable syncing
+		executePragma(database, "synchronous = OFF");
+
+		// Needed by both profiles, as even with write-ahead logging a reader can find the database briefly locked (e.g. while the log is
+		// being checkpointed). Page-in throws rather than leaving chunks empty if it still can't get at the data, so it's worth waiting.
+		EXECUTE_SQLITE_FUNC(sqlite3_busy_timeout(database, BusyTimeoutInMilliseconds));
+
+		if (profile == DatabaseProfiles::Fast)
+		{
+			std::stringstream cacheSize;
+			cacheSize << "cache_size = -" << FastCacheSizeInKilobytes;
+			executePragma(database, "main." + cacheSize.str());
+			executePragma(database, "temp." + cacheSize.str());
+
+			std::stringstream mmapSize;
+			mmapSize << "mmap_size = " << FastMmapSizeInBytes;
+			executePragma(database, mmapSize.str());
+
+			if (sqlite3_db_readonly(database, "main") == 0)
+			{
+				// SQLite quietly keeps the old journal mode if it can't use WAL (e.g. for temporary databases), which is fine.
+				executePragma(database, "journal_mode = WAL");
+			}
+		}
+		else
+		{
+			POLYVOX_THROW_IF(profile != DatabaseProfiles::Compatible, std::invalid_argument, "Unknown database profile (", profile, ")");
+		}
+	}
+
+	void restoreRollbackJournal(sqlite3* database)
+	{
+		if (sqlite3_db_readonly(database, "main") != 0)
+		{
+			return;
+		}
+
+		// This also writes everything from the log back into the database. It fails if other connections are still using
+		// the database, in which case the last of them to close takes care of the log and it stays in WAL mode.
+		sqlite3_stmt* statement = nullptr;
+		EXECUTE_SQLITE_FUNC(sqlite3_prepare_v2(database, "PRAGMA journal_mode", -1, &statement, NULL));
+		std::string journalMode;
+		if (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			journalMode = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+		}
+		EXECUTE_SQLITE_FUNC(sqlite3_finalize(statement));
+
+		if (journalMode == "wal")
+		{
+			executePragma(database, "journal_mode = DELETE");
+		}
+	}
+
+	bool shouldVacuumDatabase(sqlite3* database, VacuumMode vacuumMode)
+	{
+		if (sqlite3_db_readonly(database, "main") != 0)
+		{
+			return false;
+		}
+
+		POLYVOX_THROW_IF(vacuumMode > VacuumModes::Never, std::invalid_argument, "Unknown vacuum mode (", vacuumMode, ")");
+		if (vacuumMode != VacuumModes::WhenFragmented)
+		{
+			return vacuumMode == VacuumModes::Always;
+		}
+
+		const int64_t pageCount = queryPragma(database, "page_count");
+		const int64_t freePageCount = queryPragma(database, "freelist_count");
+		return (freePageCount > 0) && (freePageCount >= pageCount * FragmentedFreePageFraction);
+	}
+}
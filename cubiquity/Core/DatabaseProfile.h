@@ -0,0 +1,71 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef CUBIQUITY_DATABASEPROFILE_H_
+#define CUBIQUITY_DATABASEPROFILE_H_
+
+#include "SQLite/sqlite3.h"
+
+#include <cstdint>
+
+namespace Cubiquity
+{
+	namespace DatabaseProfiles
+	{
+		// The values match the CU_DATABASE_PROFILE_* constants in the C interface. Zero is the default so that it can be left unset in the VolumeOptions.
+		enum DatabaseProfile
+		{
+			Compatible = 0, // How voxel databases have always been opened. SQLite's default page cache and journal, and no memory mapping.
+			Fast = 1 // Write-ahead logging (so other connections can read while we write), memory mapped reads and a larger page cache.
+		};
+	}
+	typedef DatabaseProfiles::DatabaseProfile DatabaseProfile;
+
+	namespace VacuumModes
+	{
+		// The values match the CU_VACUUM_* constants in the C interface. Vacuuming rewrites the whole database
+		// to give back the space left by deleted and replaced chunks, which can take seconds for a large one.
+		enum VacuumMode
+		{
+			WhenFragmented = 0, // When the database is closed, but only if enough of it is free space to be worth it.
+			Always = 1, // Every time the database is closed, as older versions of Cubiquity did.
+			Never = 2 // Only when the application asks for it (see Volume::vacuumDatabase()).
+		};
+	}
+	typedef VacuumModes::VacuumMode VacuumMode;
+
+	// Sets up a connection which has just been opened. Write-ahead logging is only turned on for writable databases,
+	// as a read-only connection can't create the files it needs (which matters for VDBs shipped in a read-only folder).
+	// Both profiles wait for a short while if another connection has the database locked.
+	void applyDatabaseProfile(sqlite3* database, DatabaseProfile profile);
+
+	// Should be called before a writable database is closed. Write-ahead logging is a property of the file rather than the connection,
+	// so we switch back to the normal journal to leave a single self-contained file which can be opened read-only (or by older versions).
+	void restoreRollbackJournal(sqlite3* database);
+
+	// Whether the database should be vacuumed as it is closed. Always false for read-only databases.
+	bool shouldVacuumDatabase(sqlite3* database, VacuumMode vacuumMode);
+}
+
+#endif //CUBIQUITY_DATABASEPROFILE_H_
@@ -134,7 +134,6 @@ namespace PolyVox
 		virtual void pageOut(const Region& region, typename PagedVolume<VoxelType>::Chunk* pChunk)
 		{
 			POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
-			POLYVOX_ASSERT(pChunk->getData(), "Chunk must have valid data");
 
 			POLYVOX_LOG_TRACE("Paging out data for ", region);
 
@@ -158,7 +157,17 @@ namespace PolyVox
 			//The file has been created, so add it to the list to delete on shutdown.
 			m_vecCreatedFiles.push_back(filename);
 
-			fwrite(pChunk->getData(), sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
+			// Packed chunks don't have the data in this form, so we unpack a copy.
+			const VoxelType* pData = pChunk->getData();
+			std::vector<VoxelType> vecUnpackedData;
+			if (!pData)
+			{
+				vecUnpackedData.resize(pChunk->getDataSizeInBytes() / sizeof(VoxelType));
+				pChunk->copyData(&(vecUnpackedData[0]));
+				pData = &(vecUnpackedData[0]);
+			}
+
+			fwrite(pData, sizeof(uint8_t), pChunk->getDataSizeInBytes(), pFile);
 
 			if (ferror(pFile))
 			{
@@ -0,0 +1,457 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef __PolyVox_MemoryPool_H__
+#define __PolyVox_MemoryPool_H__
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+	#include <sys/mman.h> //For madvise()
+#endif
+
+namespace PolyVox
+{
+	/**
+	 * Hands out blocks of memory which are all the same size, reusing the ones which have been given back rather than returning
+	 * them to the heap. This is used for the voxel data of the PagedVolume's chunks (which are constantly being paged in and evicted)
+	 * and for smaller RawVolumes (which are mostly short lived copies of voxel data). There is one pool for each block size, shared by
+	 * the whole process, so e.g. all volumes with the same voxel type and chunk size take their chunk data from the same pool.
+	 *
+	 * Each thread mostly uses it's own list of free blocks, so threads allocating at the same time don't wait for each other. The
+	 * memory can optionally be backed by huge pages (see setUseHugePages()), which reduces TLB misses when accessing lots of voxels.
+	 * Free blocks are only given back to the operating system by trim(), which PagedVolume::releaseMemory() calls for the chunk data, and
+	 * by trimAll(), which Cubiquity calls when it is asked to release memory.
+	 */
+	class MemoryPool
+	{
+	public:
+		/// Returns the pool for the given block size, creating it if required.
+		static MemoryPool& get(uint32_t uBlockSizeInBytes)
+		{
+			return getFrom(getPools(), uBlockSizeInBytes);
+		}
+
+		/// Returns the pool for arrays up to the given size, which may use blocks which are somewhat bigger than necessary. Large
+		/// arrays are not worth pooling (and would waste too much memory), in which case this returns null. These pools are kept
+		/// apart from the ones returned by get(), even when the block sizes match, so that getNoOfBytesReservedForArrays() can report them.
+		static MemoryPool* getForArray(uint32_t uSizeInBytes)
+		{
+			if (uSizeInBytes > uMaxPooledArraySizeInBytes)
+			{
+				return nullptr;
+			}
+
+			// Rounding up to a power of two limits the number of different pools.
+			uint32_t uBlockSizeInBytes = uMinBlockSizeInBytes;
+			while (uBlockSizeInBytes < uSizeInBytes)
+			{
+				uBlockSizeInBytes *= 2;
+			}
+			return &getFrom(getArrayPools(), uBlockSizeInBytes);
+		}
+
+		/// Huge pages are only used if the operating system supports them (currently only on Linux, through transparent huge pages),
+		/// and only for memory which the pools allocate after this is set. Each pool then allocates memory in 2Mb slabs.
+		static void setUseHugePages(bool bUseHugePages)
+		{
+			useHugePages() = bUseHugePages;
+		}
+
+		static bool getUseHugePages(void)
+		{
+			return useHugePages();
+		}
+
+		void* allocate(void)
+		{
+			Shard& ownShard = m_arrayShards[getShardIndex()];
+			{
+				std::lock_guard<std::mutex> lock(ownShard.mutex);
+				void* pBlock = popFreeBlock(ownShard);
+				if (pBlock)
+				{
+					return pBlock;
+				}
+			}
+
+			// Blocks are often freed by a different thread from the one which allocated them (e.g. a chunk paged in by the
+			// prefetch thread and evicted by the main thread), so before allocating more memory we use any which other threads have freed.
+			for (uint32_t uShard = 0; uShard < uNoOfShards; uShard++)
+			{
+				Shard& shard = m_arrayShards[uShard];
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				void* pBlock = popFreeBlock(shard);
+				if (pBlock)
+				{
+					return pBlock;
+				}
+			}
+
+			return allocateSlab(ownShard);
+		}
+
+		void deallocate(void* pBlock)
+		{
+			POLYVOX_ASSERT(pBlock, "Attempting to deallocate a null block.");
+
+			Shard& shard = m_arrayShards[getShardIndex()];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			pushFreeBlock(shard, pBlock);
+		}
+
+		/// Allocates a block, and constructs an array of the given size in it. As with new[], the elements are default initialised
+		/// (so e.g. an array of integers is left uninitialised).
+		template <typename Type>
+		Type* newArray(uint32_t uNoOfElements)
+		{
+			POLYVOX_ASSERT(uNoOfElements * sizeof(Type) <= m_uBlockSizeInBytes, "Array does not fit in the pool's blocks.");
+
+			Type* pArray = static_cast<Type*>(allocate());
+			for (uint32_t uElement = 0; uElement < uNoOfElements; uElement++)
+			{
+				new (pArray + uElement) Type;
+			}
+			return pArray;
+		}
+
+		/// Destroys an array created by newArray() and gives the block back to the pool.
+		template <typename Type>
+		void deleteArray(Type* pArray, uint32_t uNoOfElements)
+		{
+			for (uint32_t uElement = 0; uElement < uNoOfElements; uElement++)
+			{
+				pArray[uElement].~Type();
+			}
+			deallocate(pArray);
+		}
+
+		/// Gives memory which isn't being used back to the operating system, returning how much. When using huge pages a slab can
+		/// only be released once all of it's blocks are free, so some free memory may be kept back.
+		uint64_t trim(void)
+		{
+			std::lock_guard<std::mutex> slabsLock(m_slabsMutex);
+
+			// Gather all the free blocks, in the same (address) order as the slabs.
+			std::vector<char*> vecFreeBlocks;
+			for (uint32_t uShard = 0; uShard < uNoOfShards; uShard++)
+			{
+				Shard& shard = m_arrayShards[uShard];
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				while (void* pBlock = popFreeBlock(shard))
+				{
+					vecFreeBlocks.push_back(static_cast<char*>(pBlock));
+				}
+			}
+			std::sort(vecFreeBlocks.begin(), vecFreeBlocks.end());
+
+			uint64_t uBytesReleased = 0;
+			std::vector<char*> vecRemainingFreeBlocks;
+			std::vector<Slab> vecRemainingSlabs;
+			uint32_t uFreeBlock = 0;
+			for (uint32_t uSlab = 0; uSlab < m_vecSlabs.size(); uSlab++)
+			{
+				const Slab& slab = m_vecSlabs[uSlab];
+				const uint32_t uFirstFreeBlock = uFreeBlock;
+				while ((uFreeBlock < vecFreeBlocks.size()) && (vecFreeBlocks[uFreeBlock] < slab.pMemory + slab.uSizeInBytes))
+				{
+					uFreeBlock++;
+				}
+
+				if (uFreeBlock - uFirstFreeBlock == slab.uNoOfBlocks)
+				{
+					uBytesReleased += slab.uSizeInBytes;
+					freeSlabMemory(slab.pMemory);
+				}
+				else
+				{
+					vecRemainingSlabs.push_back(slab);
+					vecRemainingFreeBlocks.insert(vecRemainingFreeBlocks.end(), vecFreeBlocks.begin() + uFirstFreeBlock, vecFreeBlocks.begin() + uFreeBlock);
+				}
+			}
+			m_vecSlabs.swap(vecRemainingSlabs);
+			m_uNoOfBytesReserved -= uBytesReleased;
+
+			// Whatever is left is shared out again.
+			for (uint32_t uBlock = 0; uBlock < vecRemainingFreeBlocks.size(); uBlock++)
+			{
+				Shard& shard = m_arrayShards[uBlock % uNoOfShards];
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				pushFreeBlock(shard, vecRemainingFreeBlocks[uBlock]);
+			}
+
+			return uBytesReleased;
+		}
+
+		/// Trims every pool, returning how much memory was given back to the operating system.
+		static uint64_t trimAll(void)
+		{
+			return trimPools(getPools()) + trimPools(getArrayPools());
+		}
+
+		/// How much memory the pools returned by getForArray() have allocated, whether or not it is in use. Unlike the chunk data this
+		/// doesn't belong to any one volume, so it isn't included in their sizes.
+		static uint64_t getNoOfBytesReservedForArrays(void)
+		{
+			uint64_t uNoOfBytesReserved = 0;
+			std::atomic<MemoryPool*>* arrayPools = getArrayPools();
+			for (uint32_t uPool = 0; uPool < uMaxNoOfPools; uPool++)
+			{
+				MemoryPool* pPool = arrayPools[uPool].load(std::memory_order_acquire);
+				if (pPool == nullptr)
+				{
+					break;
+				}
+				uNoOfBytesReserved += pPool->getNoOfBytesReserved();
+			}
+			return uNoOfBytesReserved;
+		}
+
+		uint32_t getBlockSizeInBytes(void) const { return m_uBlockSizeInBytes; }
+
+		/// How much memory the pool has allocated, whether or not it is in use.
+		uint64_t getNoOfBytesReserved(void) const { return m_uNoOfBytesReserved.load(); }
+
+	private:
+		// Enough for all the chunk and array sizes in practice.
+		static const uint32_t uMaxNoOfPools = 64;
+		static const uint32_t uNoOfShards = 8;
+		static const uint32_t uMinBlockSizeInBytes = 64;
+		static const uint32_t uMaxPooledArraySizeInBytes = 8 * 1024 * 1024;
+		static const uint32_t uHugePageSizeInBytes = 2 * 1024 * 1024;
+		static const uint32_t uCacheLineSizeInBytes = 64;
+
+		struct Slab
+		{
+			char* pMemory;
+			uint32_t uSizeInBytes;
+			uint32_t uNoOfBlocks;
+		};
+
+		// Free blocks are kept in a linked list, with the link stored in the block itself.
+		struct Shard
+		{
+			Shard() : pFreeBlocks(nullptr) {}
+
+			std::mutex mutex;
+			void* pFreeBlocks;
+
+			// So that the shards used by different threads are not in the same cache line.
+			char padding[uCacheLineSizeInBytes];
+		};
+
+		MemoryPool(uint32_t uBlockSizeInBytes)
+			:m_uBlockSizeInBytes((std::max)(uBlockSizeInBytes, static_cast<uint32_t>(sizeof(void*))))
+			,m_uNoOfBytesReserved(0)
+		{
+		}
+
+		// Not implemented, pools are never copied or destroyed.
+		MemoryPool(const MemoryPool&);
+		MemoryPool& operator=(const MemoryPool&);
+		~MemoryPool();
+
+		// The pools are never destroyed, because chunks may be freed very late during shutdown (e.g. when the
+		// thread-local record of a background thread's last accessed chunk goes). Unused entries are null.
+		static std::atomic<MemoryPool*>* getPools(void)
+		{
+			static std::atomic<MemoryPool*> s_arrayPools[uMaxNoOfPools];
+			return s_arrayPools;
+		}
+
+		static std::atomic<MemoryPool*>* getArrayPools(void)
+		{
+			static std::atomic<MemoryPool*> s_arrayPools[uMaxNoOfPools];
+			return s_arrayPools;
+		}
+
+		// Returns the pool with the given block size from one of the lists above, creating it if required.
+		static MemoryPool& getFrom(std::atomic<MemoryPool*>* arrayPools, uint32_t uBlockSizeInBytes)
+		{
+			// The pools are looked up without a lock, as this is done for every allocation.
+			for (uint32_t uPool = 0; uPool < uMaxNoOfPools; uPool++)
+			{
+				MemoryPool* pPool = arrayPools[uPool].load(std::memory_order_acquire);
+				if (pPool == nullptr)
+				{
+					break;
+				}
+				if (pPool->m_uBlockSizeInBytes == uBlockSizeInBytes)
+				{
+					return *pPool;
+				}
+			}
+
+			static std::mutex s_poolsMutex;
+			std::lock_guard<std::mutex> lock(s_poolsMutex);
+			uint32_t uPool = 0;
+			for (; (uPool < uMaxNoOfPools) && (arrayPools[uPool].load() != nullptr); uPool++)
+			{
+				// Another thread may have created it since we looked.
+				if (arrayPools[uPool].load()->m_uBlockSizeInBytes == uBlockSizeInBytes)
+				{
+					return *arrayPools[uPool].load();
+				}
+			}
+
+			POLYVOX_THROW_IF(uPool == uMaxNoOfPools, std::runtime_error, "Too many different block sizes have been requested from the memory pools.");
+			MemoryPool* pPool = new MemoryPool(uBlockSizeInBytes);
+			arrayPools[uPool].store(pPool, std::memory_order_release);
+			return *pPool;
+		}
+
+		static uint64_t trimPools(std::atomic<MemoryPool*>* arrayPools)
+		{
+			uint64_t uBytesReleased = 0;
+			for (uint32_t uPool = 0; uPool < uMaxNoOfPools; uPool++)
+			{
+				MemoryPool* pPool = arrayPools[uPool].load(std::memory_order_acquire);
+				if (pPool == nullptr)
+				{
+					break;
+				}
+				uBytesReleased += pPool->trim();
+			}
+			return uBytesReleased;
+		}
+
+		static std::atomic<bool>& useHugePages(void)
+		{
+			static std::atomic<bool> s_bUseHugePages(false);
+			return s_bUseHugePages;
+		}
+
+		// Threads are spread across the shards in the order they first use a pool.
+		static uint32_t getShardIndex(void)
+		{
+			static std::atomic<uint32_t> s_uNextShardIndex(0);
+			static thread_local uint32_t s_uShardIndex = s_uNextShardIndex.fetch_add(1) % uNoOfShards;
+			return s_uShardIndex;
+		}
+
+		// The caller must hold the shard's lock.
+		static void* popFreeBlock(Shard& shard)
+		{
+			void* pBlock = shard.pFreeBlocks;
+			if (pBlock)
+			{
+				shard.pFreeBlocks = *static_cast<void**>(pBlock);
+			}
+			return pBlock;
+		}
+
+		// The caller must hold the shard's lock.
+		static void pushFreeBlock(Shard& shard, void* pBlock)
+		{
+			*static_cast<void**>(pBlock) = shard.pFreeBlocks;
+			shard.pFreeBlocks = pBlock;
+		}
+
+		// Returns the first block of the new slab, and puts the rest of it's blocks in the given shard.
+		void* allocateSlab(Shard& shard)
+		{
+			// Without huge pages there is nothing to be gained by grouping blocks together, and having one per slab means trim()
+			// can always release all of the free blocks.
+			const bool bUseHugePages = getUseHugePages();
+			Slab slab;
+			slab.uSizeInBytes = m_uBlockSizeInBytes;
+			if (bUseHugePages)
+			{
+				slab.uSizeInBytes = ((m_uBlockSizeInBytes + uHugePageSizeInBytes - 1) / uHugePageSizeInBytes) * uHugePageSizeInBytes;
+			}
+			slab.uNoOfBlocks = slab.uSizeInBytes / m_uBlockSizeInBytes;
+			slab.pMemory = static_cast<char*>(allocateSlabMemory(slab.uSizeInBytes, bUseHugePages ? uHugePageSizeInBytes : uCacheLineSizeInBytes));
+			if (slab.pMemory == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+
+#if defined(__linux__)
+			if (bUseHugePages)
+			{
+				// This is only advice, so if transparent huge pages are disabled we just get normal pages.
+				madvise(slab.pMemory, slab.uSizeInBytes, MADV_HUGEPAGE);
+			}
+#endif
+
+			{
+				std::lock_guard<std::mutex> slabsLock(m_slabsMutex);
+				std::vector<Slab>::iterator iterInsert = std::upper_bound(m_vecSlabs.begin(), m_vecSlabs.end(), slab,
+					[](const Slab& lhs, const Slab& rhs) { return lhs.pMemory < rhs.pMemory; });
+				m_vecSlabs.insert(iterInsert, slab);
+				m_uNoOfBytesReserved += slab.uSizeInBytes;
+			}
+
+			if (slab.uNoOfBlocks > 1)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				for (uint32_t uBlock = 1; uBlock < slab.uNoOfBlocks; uBlock++)
+				{
+					pushFreeBlock(shard, slab.pMemory + uBlock * m_uBlockSizeInBytes);
+				}
+			}
+
+			return slab.pMemory;
+		}
+
+		static void* allocateSlabMemory(uint32_t uSizeInBytes, uint32_t uAlignment)
+		{
+#if defined(_MSC_VER)
+			return _aligned_malloc(uSizeInBytes, uAlignment);
+#else
+			void* pMemory = nullptr;
+			return (posix_memalign(&pMemory, uAlignment, uSizeInBytes) == 0) ? pMemory : nullptr;
+#endif
+		}
+
+		static void freeSlabMemory(void* pMemory)
+		{
+#if defined(_MSC_VER)
+			_aligned_free(pMemory);
+#else
+			free(pMemory);
+#endif
+		}
+
+		const uint32_t m_uBlockSizeInBytes;
+
+		Shard m_arrayShards[uNoOfShards];
+
+		// Sorted by address, so trim() can match up the free blocks with their slabs.
+		std::mutex m_slabsMutex;
+		std::vector<Slab> m_vecSlabs;
+		std::atomic<uint64_t> m_uNoOfBytesReserved;
+	};
+}
+
+#endif //__PolyVox_MemoryPool_H__
@@ -29,18 +29,40 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include "Impl/MemoryPool.h"
+
+#include <atomic>
+#include <condition_variable>
 #include <limits>
 #include <cstdlib> //For abort()
 #include <cstring> //For memcpy
+#include <functional>
 #include <unordered_map>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept> //For invalid_argument
+#include <utility>
 #include <vector>
 
 namespace PolyVox
 {
+	namespace MemoryEvents
+	{
+		/**
+		 * The reasons for calling a PagedVolume's memory event handler (see PagedVolume::setMemoryEventHandler()).
+		 */
+		enum MemoryEvent
+		{
+			UsageIncreased, ///< Chunks have been paged in or recreated (and any which had to be were evicted).
+			LimitTooLow, ///< The target memory usage is too low to work with, so a higher one is being used.
+			PrefetchTooLarge, ///< prefetch() was asked for more chunks than fit within the target memory usage.
+			Thrashing ///< Many of the chunks being paged in had only just been evicted.
+		};
+	}
+	typedef MemoryEvents::MemoryEvent MemoryEvent;
+
 	/// This class provide a volume implementation which avoids storing all the data in memory at all times. Instead it breaks the volume
 	/// down into a set of chunks and moves these into and out of memory on demand. This means it is much more memory efficient than the
 	/// RawVolume, but may also be slower and is more complicated We encourage uses to work with RawVolume initially, and then switch to
@@ -53,6 +75,17 @@ namespace PolyVox
 	///
 	/// A consequence of this paging approach is that (unlike the RawVolume) the PagedVolume does not need to have a predefined size. After
 	/// the volume has been created you can begin acessing voxels anywhere in space and the required data will be created automatically.
+	///
+	/// The PagedVolume can be accessed from several threads at once. Each thread keeps it's own record of the last accessed chunk, the
+	/// chunk table is split into independently locked stripes, and a chunk which is in use by a Sampler is 'pinned' so that another
+	/// thread cannot evict it. The Pager is called from whichever thread needs the chunk, without holding the lock for it's stripe.
+	///
+	/// Only one thread should write voxels at a time. The writes don't have to come from the same thread (e.g. a volume could be filled on
+	/// a loading thread and then edited on the main thread), but it is up to the caller to make sure that they don't overlap. The voxel
+	/// data itself is not synchronised, so threads which read voxels while they are being written may see some of the changes but not
+	/// others (and for voxel types larger than the processor writes in one go, possibly part of a change). Readers which need a consistent
+	/// view must check afterwards whether anything changed while they were reading, as Cubiquity's surface extraction does with timestamps
+	/// taken before reading and after writing.
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
 	class PagedVolume : public BaseVolume<VoxelType>
@@ -63,6 +96,48 @@ namespace PolyVox
 		/// The Pager class is responsible for the loading and unloading of Chunks, and can be subclassed by the user.
 		class Pager;
 
+	private:
+		// A run of identical voxels. Evicted chunks are run-length encoded when they are kept in the compressed chunk cache.
+		struct VoxelRun
+		{
+			VoxelType tValue;
+			uint32_t uLength;
+		};
+
+		// Voxel data stored as indices into a small palette, for chunks which contain only a few different values (see
+		// setPaletteCompression()). Each index is 1, 2, 4 or 8 bits, and the palette has room for as many values as that can refer to.
+		struct PackedData
+		{
+			PackedData(uint32_t uNoOfVoxels, uint8_t uBitsPerIndex);
+			~PackedData();
+
+			VoxelType getVoxel(uint32_t uIndex) const;
+			uint32_t getPaletteIndex(uint32_t uIndex) const;
+			void setPaletteIndex(uint32_t uIndex, uint32_t uPaletteIndex);
+
+			// Returns the position of the value in the palette, adding it if necessary. If the palette is full then the capacity is returned.
+			uint32_t findOrAddToPalette(const VoxelType& tValue);
+			uint32_t getPaletteCapacity(void) const;
+
+			uint32_t calculateSizeInBytes(void) const;
+
+			// The smallest index size for a palette with the given number of values.
+			static uint8_t getBitsPerIndex(uint32_t uPaletteSize);
+
+			uint32_t uNoOfVoxels;
+			uint8_t uBitsPerIndex;
+			uint32_t uPaletteSize;
+			VoxelType* pPalette;
+			uint8_t* pIndices;
+
+		private:
+			// Not implemented, as the data is only ever referred to through a pointer.
+			PackedData(const PackedData&);
+			PackedData& operator=(const PackedData&);
+		};
+
+	public:
+
 		class Chunk
 		{
 			friend class PagedVolume;
@@ -71,8 +146,14 @@ namespace PolyVox
 			Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager = nullptr);
 			~Chunk();
 
+			/// This is only for use by the Pager. Chunks which contain a single value share their data, so it must not be written
+			/// to except while the chunk is being paged in. Chunks stored with a palette don't have this data at all, in which case
+			/// null is returned and copyData() can be used instead.
 			VoxelType* getData(void) const;
+			/// The size of the data returned by getData(), which is always that of the uncompressed voxels.
 			uint32_t getDataSizeInBytes(void) const;
+			/// Copies the voxels (in the same order as getData()) into the given buffer, however the chunk is storing them.
+			void copyData(VoxelType* pDest) const;
 
 			VoxelType getVoxel(uint32_t uXPos, uint32_t uYPos, uint32_t uZPos) const;
 			VoxelType getVoxel(const Vector3DUint16& v3dPos) const;
@@ -83,6 +164,10 @@ namespace PolyVox
 			void changeLinearOrderingToMorton(void);
 			void changeMortonOrderingToLinear(void);
 
+			/// Copies voxels which are in linear order into the chunk, which stores them in Morton order. Like getData() this is only for use
+			/// by the Pager, and is much quicker than copying the data in and then calling changeLinearOrderingToMorton().
+			void setDataFromLinearOrder(const VoxelType* pLinearData);
+
 		private:
 			/// Private copy constructor to prevent accisdental copying
 			Chunk(const Chunk& /*rhs*/) {};
@@ -90,17 +175,84 @@ namespace PolyVox
 			/// Private assignment operator to prevent accisdental copying
 			Chunk& operator=(const Chunk& /*rhs*/) {};
 
-			// This is updated by the PagedVolume and used to discard the least recently used chunks.
-			uint32_t m_uChunkLastAccessed;
+			// Allocates the data but leaves it uninitialised, so the PagedVolume can call the Pager itself. This lets it page in several chunks
+			// at once with Pager::pageInBatch(), and page in a chunk which is already in the table without holding the lock for it's stripe.
+			Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager, bool bPageIn);
+
+			// Recreates a chunk from the compressed chunk cache, so the Pager is not asked to page it in. If the runs are all the same
+			// value and pUniformData is provided then this is used instead of allocating the data.
+			Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager, const std::vector<VoxelRun>& runs, const std::shared_ptr<VoxelType>& pUniformData);
+
+			// Returns true (and the value) if every voxel in the chunk is the same.
+			bool findUniformValue(VoxelType& tValue) const;
+			// Frees the chunk's own data, and instead refers to the shared data (which must contain the same values).
+			void useUniformData(const std::shared_ptr<VoxelType>& pUniformData);
+			// Gives a chunk which is using shared data it's own copy, so that it can be written to. This is packed if m_bUsePalette is set.
+			void makeDataUnique(void);
+			// Replaces the chunk's own data with indices into a palette, if there are few enough different values for this to save memory.
+			// Returns whether it did so. Like useUniformData() this is only done before the chunk is added to the volume.
+			bool packData(void);
+			// Makes room in the palette for another value, by moving to larger indices or (if they are already eight bits) back to
+			// unpacked data. Returns false in the latter case.
+			bool growPackedData(void);
+			// Keeps data which has been replaced, as other threads may still be reading it.
+			void retirePackedData(PackedData* pPackedData);
+
+			// Reads a voxel given it's (Morton ordered) index, however the chunk is storing them.
+			VoxelType getVoxelAtIndex(uint32_t uIndex) const;
+
+			// Run-length encodes the voxels (in Morton order, which keeps neighbouring voxels together).
+			void compress(std::vector<VoxelRun>& runs) const;
+
+			// Pages out the data if it has been modified since it was paged in.
+			void pageOutIfModified(void);
+
+			// Chunk data (and the temporary buffers for reordering it) comes from the pool for it's size, so the memory freed by evicting
+			// one chunk is reused for the next one rather than going back to the heap.
+			static MemoryPool& getDataPool(uint16_t uSideLength);
+			static VoxelType* allocateData(uint16_t uSideLength);
+			static void freeData(VoxelType* pData, uint16_t uSideLength);
+
+			// This is updated by the PagedVolume and used to discard the least recently used chunks. It's 64-bit (like
+			// m_uTimestamper) because it's compared across stripes, where a wrapped value would make the newest chunks look the oldest.
+			std::atomic<uint64_t> m_uChunkLastAccessed;
+
+			// Links in the least-recently-used list of the stripe which holds the chunk. Protected by the stripe's lock.
+			Chunk* m_pLruPrev;
+			Chunk* m_pLruNext;
+
+			// Set when the chunk is removed from the PagedVolume. An evicted chunk may still be alive (if a Sampler or a thread's
+			// last-accessed-chunk record refers to it) but it must not be written to, and must not be found by future lookups.
+			std::atomic<bool> m_bEvicted;
 
 			// This is so we can tell whether a uncompressed chunk has to be recompressed and whether
 			// a compressed chunk has to be paged back to disk, or whether they can just be discarded.
 			bool m_bDataModified;
 
-			uint32_t calculateSizeInBytes(void);
+			// Set while the chunk is in the table as a placeholder, waiting for the thread which created it to page in the data. Other
+			// threads must not use it until this is cleared (see waitForPageIn()). If the Pager threw then m_bPageInFailed is also set,
+			// and the chunk has been taken out of the table again.
+			std::atomic<bool> m_bBeingPagedIn;
+			bool m_bPageInFailed;
+
+			// The memory which the chunk's own data is using, which is zero for shared data and less than the static version for packed data.
+			uint32_t calculateSizeInBytes(void) const;
 			static uint32_t calculateSizeInBytes(uint32_t uSideLength);
 
-			VoxelType* m_tData;
+			// Other threads may be reading voxels while the data is replaced by makeDataUnique(), hence atomic. This is null if the
+			// chunk is packed, in which case m_pPackedData is used. Readers must check this first, as the packed data is set before
+			// it is cleared. When the packed data is replaced the old version is kept (in m_vecRetiredPackedData) until the chunk is
+			// destroyed, so a Sampler which is still using it doesn't read freed memory. That happens at most a few times per chunk,
+			// as the indices only ever get larger, and even the worst case is smaller than unpacked data.
+			std::atomic<VoxelType*> m_tData;
+			std::atomic<PackedData*> m_pPackedData;
+			std::vector<PackedData*> m_vecRetiredPackedData;
+			bool m_bUsePalette;
+
+			// Chunks in which every voxel has the same value (most commonly empty space) don't have data of their own. Instead they all
+			// refer to a single read-only copy, owned by the volume, which is filled with that value. This means getVoxel() and the Sampler
+			// don't need to treat such chunks differently. The data is copied the first time a different value is written to the chunk.
+			std::shared_ptr<VoxelType> m_pUniformData;
 			uint16_t m_uSideLength;
 			uint8_t m_uSideLengthPower;
 			Pager* m_pPager;
@@ -124,6 +276,26 @@ namespace PolyVox
 
 			virtual void pageIn(const Region& region, Chunk* pChunk) = 0;
 			virtual void pageOut(const Region& region, Chunk* pChunk) = 0;
+
+			/// Pages in several chunks together, which gives the Pager the chance to read them more efficiently than one at a time. This
+			/// is used by PagedVolume::prefetch(). By default it calls pageIn().
+			virtual void pageInBatch(const std::vector< std::pair<Region, Chunk*> >& chunks)
+			{
+				for (uint32_t ct = 0; ct < chunks.size(); ct++)
+				{
+					pageIn(chunks[ct].first, chunks[ct].second);
+				}
+			}
+
+			/// Pages out several chunks together, which gives the Pager the chance to write them more efficiently than one at a
+			/// time. This is used for chunks which were queued by PagedVolume::setDeferredPageOut(). By default it calls pageOut().
+			virtual void pageOutBatch(const std::vector< std::pair<Region, Chunk*> >& chunks)
+			{
+				for (uint32_t ct = 0; ct < chunks.size(); ct++)
+				{
+					pageOut(chunks[ct].first, chunks[ct].second);
+				}
+			}
 		};
 
 		//There seems to be some descrepency between Visual Studio and GCC about how the following class should be declared.
@@ -189,8 +361,16 @@ namespace PolyVox
 			inline VoxelType peekVoxel1px1py1pz(void) const;
 
 		private:
-			//Other current position information
-			VoxelType* mCurrentVoxel;
+			inline VoxelType getVoxelAtIndex(uint32_t uIndex) const;
+
+			//Other current position information. The current chunk's data is either unpacked (in which case mCurrentData is set) or
+			// packed, and we keep the index of the current voxel rather than a pointer so that the same movements work for both.
+			const VoxelType* mCurrentData;
+			const PackedData* mCurrentPackedData;
+			uint32_t mCurrentVoxelIndex;
+
+			// Holding a reference to the current chunk pins it, so it cannot be evicted while we point into it.
+			std::shared_ptr<Chunk> m_pCurrentChunk;
 
 			uint16_t m_uXPosInChunk;
 			uint16_t m_uYPosInChunk;
@@ -204,9 +384,37 @@ namespace PolyVox
 
 #endif // SWIG
 
+		/// Describes how well the chunk table is working. The probe length is the number of slots which have to be examined to find a
+		/// chunk, so one is ideal. If the average is much above that then chunk positions are not being spread well over the table.
+		struct ChunkTableStatistics
+		{
+			uint32_t uNoOfChunks = 0;
+			uint32_t uNoOfSlots = 0;
+			float fAverageProbeLength = 0.0f;
+			uint32_t uMaxProbeLength = 0;
+			/// Chunks in which every voxel has the same value, and which therefore don't have voxel data of their own.
+			uint32_t uNoOfUniformChunks = 0;
+			/// Chunks which are stored as indices into a palette (see setPaletteCompression()).
+			uint32_t uNoOfPackedChunks = 0;
+		};
+
+		/// Counts how often chunks were found already in memory. Hits and misses are for the chunks requested when reading voxels (not
+		/// counting repeated requests for the same chunk by one thread), while prefetched chunks are those paged in by prefetch().
+		struct PagingStatistics
+		{
+			uint64_t uNoOfHits = 0;
+			uint64_t uNoOfMisses = 0;
+			uint64_t uNoOfPrefetchedChunks = 0;
+
+			/// Chunks which were recreated from the compressed chunk cache rather than paged in. These count as neither hits nor misses.
+			uint64_t uNoOfCompressedCacheHits = 0;
+			/// The amount of memory currently used by the compressed chunk cache.
+			uint64_t uCompressedCacheSizeInBytes = 0;
+		};
+
 	public:
 		/// Constructor for creating a fixed size volume.
-		PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = 32);
+		PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16_t uChunkSideLength = 32);
 		/// Destructor
 		~PagedVolume();
 
@@ -225,8 +433,39 @@ namespace PolyVox
 		/// Removes all voxels from memory
 		void flushAll();
 
+		/// Changes how much memory the volume aims to use, evicting chunks straight away if it is now over the limit.
+		void setTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes);
 		/// Calculates approximatly how many bytes of memory the volume is currently using.
-		uint32_t calculateSizeInBytes(void);
+		uint64_t calculateSizeInBytes(void);
+
+		/// Sets how much memory can be used to keep evicted chunks in compressed form. Zero (the default) disables this.
+		void setCompressedCacheLimit(uint64_t uCompressedCacheLimitInBytes);
+
+		/// Controls whether chunks with only a few different values are stored as indices into a palette, which uses less memory.
+		void setPaletteCompression(bool bEnabled);
+
+		/// Controls whether modified chunks are paged out as soon as they are evicted, or queued for pageOutQueuedChunks().
+		void setDeferredPageOut(bool bDeferPageOut);
+		/// Pages out some of the chunks which have been queued, and returns how many. This is normally called from another thread.
+		uint32_t pageOutQueuedChunks(uint32_t uMaxNoOfChunks);
+		/// The number of modified chunks which have been evicted but not yet paged out.
+		uint32_t getNoOfQueuedChunks(void) const;
+
+		/// Sets a function to be told when the volume's memory use goes up, or when it can't work within it's target memory usage.
+		void setMemoryEventHandler(std::function<void(MemoryEvent)> memoryEventHandler);
+		/// Frees up memory by emptying the compressed chunk cache and then evicting chunks, even if the volume is within it's target.
+		uint64_t releaseMemory(uint64_t uBytesToRelease);
+
+		/// The length of each side of a chunk, in voxels. Chunks are aligned to multiples of this.
+		uint16_t getChunkSideLength(void) const;
+		/// How many chunks (with their own unpacked data) fit within the target memory usage.
+		uint32_t getChunkCountLimit(void) const;
+
+		/// Examines the chunk table to report how long the probe sequences are.
+		ChunkTableStatistics getChunkTableStatistics(void) const;
+
+		/// Reports how many chunks have been found in memory or paged in since the volume was created.
+		PagingStatistics getPagingStatistics(void) const;
 
 	protected:
 		/// Copy constructor
@@ -236,31 +475,229 @@ namespace PolyVox
 		PagedVolume& operator=(const PagedVolume& rhs);
 
 	private:
-		bool canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
-		Chunk* getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
-
-		// Storing these properties individually has proved to be faster than keeping
-		// them in a Vector3DInt32 as it avoids constructions and comparison overheads.
-		// They are also at the start of the class in the hope that they will be pulled
-		// into cache - I've got no idea if this actually makes a difference.
-		mutable int32_t m_v3dLastAccessedChunkX = 0;
-		mutable int32_t m_v3dLastAccessedChunkY = 0;
-		mutable int32_t m_v3dLastAccessedChunkZ = 0;
-		mutable Chunk* m_pLastAccessedChunk = nullptr;
-
-		mutable uint32_t m_uTimestamper = 0;
-
-		uint32_t m_uChunkCountLimit = 0;
-
-		// Chunks are stored in the following array which is used as a hash-table. Conventional wisdom is that such a hash-table
-		// should not be more than half full to avoid conflicts, and a practical chunk size seems to be 64^3. With this configuration
-		// there can be up to 32768*64^3 = 8 gigavoxels (with each voxel perhaps being many bytes). This should effectively make use 
-		// of even high end machines. Of course, the user can choose to limit the memory usage in which case much less of the chunk 
-		// array will actually be used. None-the-less, we have chosen to use a fixed size array (rather than a vector) as it appears to 
-		// be slightly faster (probably due to the extra pointer indirection in a vector?) and the actual size of this array should
-		// just be 1Mb or so.
-		static const uint32_t uChunkArraySize = 65536;
-		mutable std::unique_ptr< Chunk > m_arrayChunks[uChunkArraySize];
+		// See the comments on m_arrayChunkStripes.
+		static const uint32_t uNoOfChunkStripes = 16;
+		static const uint32_t uInitialNoOfSlotsPerStripe = 64;
+
+		// Each thread remembers the chunk it accessed most recently. This is shared between all volumes of the same voxel type, so
+		// we also store which volume the chunk came from. The reference keeps the chunk alive even if another thread evicts it.
+		struct LastAccessedChunk
+		{
+			uint64_t uVolumeId = 0;
+			int32_t iChunkX = 0;
+			int32_t iChunkY = 0;
+			int32_t iChunkZ = 0;
+			std::shared_ptr<Chunk> pChunk;
+		};
+
+		// An entry in the chunk table. The hash is kept so that most mismatches can be rejected (and the table can
+		// be resized) without touching the chunk itself.
+		struct ChunkSlot
+		{
+			uint64_t uHash = 0;
+			std::shared_ptr<Chunk> pChunk;
+		};
+
+		// A part of the chunk table, with it's own lock. This is an open-addressing hash table with linear probing. The number of slots
+		// is always a power of two, and is doubled whenever the stripe becomes half full so that the probe sequences stay short.
+		struct ChunkStripe
+		{
+			std::mutex mutex;
+			std::vector<ChunkSlot> slots;
+			uint32_t uNoOfChunks = 0;
+
+			// The chunks in the stripe, ordered from most to least recently used.
+			Chunk* pMostRecentlyUsed = nullptr;
+			Chunk* pLeastRecentlyUsed = nullptr;
+		};
+
+		static LastAccessedChunk& getLastAccessedChunk(void);
+		bool canReuseLastAccessedChunk(const LastAccessedChunk& lastAccessedChunk, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const;
+
+		/// The returned reference is to the calling thread's last-accessed-chunk record, so it remains valid until the same thread requests a different chunk.
+		const std::shared_ptr<Chunk>& getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+
+		static uint64_t hashChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ);
+		ChunkStripe& getStripe(uint64_t uHash) const;
+		// The caller must hold the lock for the stripe. If a chunk had to be created then bPagedIn says whether it needs the Pager (as
+		// opposed to being taken back from the page out queue or recreated from the compressed chunk cache). In that case the chunk is
+		// only a placeholder, which the caller must pass to pageInPlaceholder() once it has released the lock. If bCanPageIn is false
+		// then null is returned rather than creating a placeholder. The chunk which is returned may still be being paged in by another thread.
+		std::shared_ptr<Chunk> findOrCreateChunk(ChunkStripe& stripe, uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool& bCreated, bool& bPagedIn, bool bCanPageIn = true) const;
+		// Finds or creates the chunk as above, and then pages it in or waits for another thread to do so. The caller must not hold any stripe locks.
+		std::shared_ptr<Chunk> acquireChunk(uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool& bCreated, bool& bPagedIn) const;
+		// Calls the Pager for a placeholder created by findOrCreateChunk(), and then lets any threads which are waiting for it carry on. If the
+		// Pager throws then the placeholder is removed from the table before the exception is passed on. The caller must not hold any stripe locks.
+		void pageInPlaceholder(ChunkStripe& stripe, const std::shared_ptr<Chunk>& pChunk) const;
+		// Waits until the chunk is no longer being paged in by another thread. Returns false if that failed, in which case the chunk
+		// is no longer in the table and should be looked up again. The caller must not hold any stripe locks.
+		bool waitForPageIn(const Chunk* pChunk) const;
+		// The caller must hold the lock for the stripe, and have checked that the chunk is not already present.
+		void insertChunk(ChunkStripe& stripe, uint64_t uHash, const std::shared_ptr<Chunk>& pChunk) const;
+		// Creates the chunks at the given positions and pages them in with a single call to the Pager, then adds them to the volume.
+		// The caller must not hold any stripe locks. Returns how many were added.
+		uint32_t pageInChunks(const std::vector<Vector3DInt32>& v3dChunkPositions);
+		// The caller must hold the lock for the stripe. Returns null if the chunk is not present.
+		ChunkSlot* findSlot(ChunkStripe& stripe, uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const;
+		// The caller must hold the lock for the stripe.
+		void insertSlot(ChunkStripe& stripe, uint64_t uHash, const std::shared_ptr<Chunk>& pChunk) const;
+		// The caller must hold the lock for the stripe.
+		void eraseSlot(ChunkStripe& stripe, ChunkSlot* pSlot) const;
+		// The caller must hold the lock for the stripe.
+		void markChunkAsUsed(ChunkStripe& stripe, Chunk* pChunk) const;
+		// The caller must hold the lock for the stripe.
+		void unlinkChunk(ChunkStripe& stripe, Chunk* pChunk) const;
+		// The caller must hold the lock for the stripe. When evicting a modified chunk may be queued for paging out later, while an
+		// unmodified one is added to the compressed chunk cache. If the aim is to release memory then neither of these happens.
+		void removeChunk(ChunkStripe& stripe, Chunk* pChunk, bool bReleasingMemory) const;
+		// The caller must hold the lock for the stripe. Returns false if the queue is full, in which case the chunk should be paged out now.
+		bool queueChunkForPageOut(const std::shared_ptr<Chunk>& pChunk) const;
+		// The caller must hold the lock for the stripe containing the position. Waits if the chunk is being paged out.
+		std::shared_ptr<Chunk> takeQueuedChunk(const Vector3DInt32& v3dChunkPos) const;
+		// The caller must hold the lock for the stripe containing the position, so that the chunk can't also be created in the meantime.
+		bool takeCompressedChunk(const Vector3DInt32& v3dChunkPos, std::vector<VoxelRun>& runs) const;
+		// The caller must hold the lock for the stripe containing the position.
+		void addCompressedChunk(const Vector3DInt32& v3dChunkPos, std::vector<VoxelRun>&& runs) const;
+		// The caller must hold the compressed chunk cache mutex.
+		void evictCompressedChunksIfRequired(void) const;
+		// Empties the compressed chunk cache.
+		void clearCompressedChunks(void) const;
+		// Returns the shared data for chunks which contain only the given value, or null if there are already too many such values.
+		std::shared_ptr<VoxelType> getUniformData(const VoxelType& tValue) const;
+		// Called for each chunk created by the Pager or from the compressed chunk cache, before it is added to the volume. Switches the
+		// chunk to shared data if it is all one value, or otherwise packs it if palette compression is enabled.
+		void compactChunkData(Chunk* pChunk) const;
+		// Used to decide when chunks must be evicted. This is similar to calculateSizeInBytes(), but doesn't lock anything.
+		uint64_t calculateChunkSizeInBytes(void) const;
+		// The caller must not hold any stripe locks, as this function locks each of them in turn.
+		void evictChunksIfRequired(void) const;
+		// Evicts the least recently used chunks until they use no more than the given amount of memory. The caller must not hold any stripe locks.
+		void evictChunks(uint64_t uTargetChunkSizeInBytes, bool bReleasingMemory) const;
+		// Checks whether the chunk was evicted recently, which is how we notice thrashing. The caller may hold a stripe lock.
+		void noteChunkCreated(uint64_t uHash) const;
+		// The caller must not hold any locks, as the handler may call back into the volume.
+		void notifyMemoryEvent(MemoryEvent eEvent) const;
+
+		// Gives each volume a unique identity, so a thread's last-accessed-chunk record can't be confused between volumes.
+		static std::atomic<uint64_t> s_uNextVolumeId;
+		const uint64_t m_uVolumeId;
+
+		// Advanced on every lookup which misses the last-accessed chunk, so at 32 bits it could wrap within hours on a busy server.
+		mutable std::atomic<uint64_t> m_uTimestamper;
+		mutable std::atomic<uint32_t> m_uChunkCount;
+		mutable std::atomic<uint32_t> m_uNoOfUniformChunks;
+
+		// The total of Chunk::calculateSizeInBytes() for the chunks in the table. This changes when a chunk is written to, which
+		// is always done while holding the lock for it's stripe (as is adding and removing it) so the two can't get out of step.
+		mutable std::atomic<uint64_t> m_uChunkDataSizeInBytes;
+
+		// The memory limit, expressed as a number of chunks which have their own (unpacked) data. Chunks which only refer to shared
+		// uniform data are much smaller, so many of them count as one of these, and packed chunks count as the fraction they use. Can
+		// be changed while other threads are paging chunks in, hence atomic.
+		std::atomic<uint32_t> m_uChunkCountLimit;
+
+		// Only used for statistics, so updated with relaxed ordering.
+		mutable std::atomic<uint64_t> m_uNoOfHits;
+		mutable std::atomic<uint64_t> m_uNoOfMisses;
+		std::atomic<uint64_t> m_uNoOfPrefetchedChunks;
+		mutable std::atomic<uint64_t> m_uNoOfCompressedCacheHits;
+
+		// Only one thread at a time searches for chunks to evict.
+		mutable std::mutex m_evictionMutex;
+
+		// Chunks are paged in without holding the lock for their stripe, as for Cubiquity that means a database query and a decompression
+		// which would otherwise hold up every thread using the stripe. Threads which need a chunk while it is being paged in wait on this.
+		mutable std::mutex m_pageInMutex;
+		mutable std::condition_variable m_pageInFinished;
+
+		// Chunks are stored in a set of hash tables keyed on the chunk position, with each also keeping it's chunks in a least-recently-used
+		// list. Finding, adding and removing a chunk are then constant time, and the least recently used chunk overall is the oldest of the
+		// chunks at the ends of the lists. We used to keep them in a fixed size array, but finding out that a chunk was *not* present meant
+		// searching the whole thing, as did every eviction. The table is split into stripes so that threads working on different chunks
+		// rarely contend for a lock. The stripe is chosen by the top bits of the position's hash and the slot by the bottom bits, and
+		// because the hash mixes all the bits of all three coordinates this works for large volumes and negative coordinates alike.
+		mutable ChunkStripe m_arrayChunkStripes[uNoOfChunkStripes];
+
+		// A chunk which has been evicted, but kept in compressed form in case it is needed again soon.
+		struct CompressedChunk
+		{
+			Vector3DInt32 v3dPosition;
+			std::vector<VoxelRun> runs;
+		};
+
+		struct ChunkPositionHasher
+		{
+			size_t operator()(const Vector3DInt32& v3dPos) const
+			{
+				return static_cast<size_t>(hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()));
+			}
+		};
+
+		// The compressed chunk cache sits between the chunks in memory and the Pager. Going back to an area which was recently
+		// left then only costs a run-length decode, rather than a trip through the Pager (which for Cubiquity means a database
+		// query and a zlib decompression). The chunks are kept in least-recently-used order and the oldest are discarded once
+		// the cache is over it's own memory limit. Only chunks which match what the Pager holds are cached (modified chunks are
+		// paged out first), so discarding them is free. This is protected by it's own mutex, which is always locked after the
+		// lock for a stripe (never before) so that a chunk can't be recreated from the cache and paged in at the same time.
+		mutable std::mutex m_compressedCacheMutex;
+		mutable std::list<CompressedChunk> m_listCompressedChunks;
+		mutable std::unordered_map<Vector3DInt32, typename std::list<CompressedChunk>::iterator, ChunkPositionHasher> m_mapCompressedChunks;
+		mutable uint64_t m_uCompressedCacheSizeInBytes;
+		uint64_t m_uCompressedCacheLimitInBytes;
+
+		// The data shared by chunks in which every voxel has the same value, one for each such value. There are normally very few of
+		// these (e.g. empty space and solid ground) so a linear search is fine, and we stop adding to it if there turn out to be many.
+		// The data is kept until the volume is destroyed, as a Sampler may still point into it after the chunk which it was reading
+		// has been given it's own data. This is locked after the lock for a stripe, as it is used when creating chunks.
+		static const uint32_t uMaxNoOfUniformValues = 16;
+		mutable std::mutex m_uniformDataMutex;
+		mutable std::vector< std::shared_ptr<VoxelType> > m_vecUniformData;
+
+		// Set before the volume is used. See setPaletteCompression().
+		std::atomic<bool> m_bPaletteCompression;
+
+		// A modified chunk which has been evicted, and is waiting to be paged out by pageOutQueuedChunks().
+		struct QueuedChunk
+		{
+			std::shared_ptr<Chunk> pChunk;
+			bool bBeingPagedOut;
+		};
+
+		// Paging out a modified chunk can be slow (for Cubiquity it means compressing it and writing it to the database), and would
+		// otherwise happen in whichever voxel access caused the eviction. With deferred page out enabled such chunks are instead queued
+		// here. If one of them is needed again before it has been paged out then it is simply put back in the chunk table, so nothing is
+		// lost and the Pager is never asked for data it doesn't have yet. If it is being paged out at that moment then we wait for that to
+		// finish, and then page it in as normal. The queue is limited in size, and once full (or while flushAll() is running) the evicting
+		// thread pages out chunks itself. This is locked after the lock for a stripe.
+		static const uint32_t uMaxNoOfQueuedChunks = 64;
+		std::atomic<bool> m_bDeferPageOut;
+		mutable std::mutex m_pageOutQueueMutex;
+		mutable std::condition_variable m_pageOutFinished;
+		mutable std::unordered_map<Vector3DInt32, QueuedChunk, ChunkPositionHasher> m_mapQueuedChunks;
+		mutable uint32_t m_uNoOfChunksBeingPagedOut;
+		uint32_t m_uNoOfFlushesInProgress;
+
+		// Counts the modified chunks which have been paged out. pageInChunks() reads from the Pager without holding the stripe locks,
+		// so if this changes in the meantime some of what it read may be out of date and it doesn't use any of it. Incremented while
+		// holding the lock for the chunk's stripe (or the page out queue mutex, before the chunk is removed from the queue).
+		mutable std::atomic<uint64_t> m_uNoOfChunksPagedOut;
+
+		// How many chunks prefetch() passes to the Pager at once.
+		static const uint32_t uMaxNoOfChunksPerPageInBatch = 32;
+
+		// Set before the volume is used. See setMemoryEventHandler().
+		std::function<void(MemoryEvent)> m_memoryEventHandler;
+		std::atomic<bool> m_bChunkCountLimitTooLow;
+
+		// The hashes of the most recently evicted chunks, used as a ring buffer. If many of the chunks which are created were evicted only
+		// shortly before then the volume is thrashing. We check each window of created chunks in turn, and don't need to be exact about it.
+		static const uint32_t uNoOfRecentEvictions = 256;
+		static const uint32_t uThrashingWindowSize = 64;
+		mutable std::atomic<uint64_t> m_arrayRecentEvictions[uNoOfRecentEvictions];
+		mutable std::atomic<uint32_t> m_uNextRecentEviction;
+		mutable std::atomic<uint32_t> m_uNoOfChunksCreatedInWindow;
+		mutable std::atomic<uint32_t> m_uNoOfRecentlyEvictedChunksCreatedInWindow;
+		mutable std::atomic<bool> m_bThrashing;
 
 		// The size of the chunks
 		uint16_t m_uChunkSideLength;
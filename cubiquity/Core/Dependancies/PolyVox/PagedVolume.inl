@@ -29,6 +29,9 @@
 
 namespace PolyVox
 {
+	template <typename VoxelType>
+	std::atomic<uint64_t> PagedVolume<VoxelType>::s_uNextVolumeId(1);
+
 	////////////////////////////////////////////////////////////////////////////////
 	/// This constructor creates a volume with a fixed size which is specified as a parameter. By default this constructor will not enable paging but you can override this if desired. If you do wish to enable paging then you are required to provide the call back function (see the other PagedVolume constructor).
 	/// \param pPager Called by PolyVox to load and unload data on demand.
@@ -36,8 +39,30 @@ namespace PolyVox
 	/// \param uChunkSideLength The size of the chunks making up the volume. Small chunks will compress/decompress faster, but there will also be more of them meaning voxel access could be slower.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	PagedVolume<VoxelType>::PagedVolume(Pager* pPager, uint32_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength)
+	PagedVolume<VoxelType>::PagedVolume(Pager* pPager, uint64_t uTargetMemoryUsageInBytes, uint16_t uChunkSideLength)
 		:BaseVolume<VoxelType>()
+		, m_uVolumeId(s_uNextVolumeId++)
+		, m_uTimestamper(0)
+		, m_uChunkCount(0)
+		, m_uNoOfUniformChunks(0)
+		, m_uChunkDataSizeInBytes(0)
+		, m_uChunkCountLimit(0)
+		, m_uNoOfHits(0)
+		, m_uNoOfMisses(0)
+		, m_uNoOfPrefetchedChunks(0)
+		, m_uNoOfCompressedCacheHits(0)
+		, m_uCompressedCacheSizeInBytes(0)
+		, m_uCompressedCacheLimitInBytes(0)
+		, m_bPaletteCompression(false)
+		, m_bDeferPageOut(false)
+		, m_uNoOfChunksBeingPagedOut(0)
+		, m_uNoOfFlushesInProgress(0)
+		, m_uNoOfChunksPagedOut(0)
+		, m_bChunkCountLimitTooLow(false)
+		, m_uNextRecentEviction(0)
+		, m_uNoOfChunksCreatedInWindow(0)
+		, m_uNoOfRecentlyEvictedChunksCreatedInWindow(0)
+		, m_bThrashing(false)
 		, m_uChunkSideLength(uChunkSideLength)
 		, m_pPager(pPager)
 	{
@@ -53,21 +78,17 @@ namespace PolyVox
 			// Use to perform modulo by bit operations
 			m_iChunkMask = m_uChunkSideLength - 1;
 
-			// Calculate the number of chunks based on the memory limit and the size of each chunk.
-			uint32_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
-			m_uChunkCountLimit = uTargetMemoryUsageInBytes / uChunkSizeInBytes;
+			for (uint32_t uStripe = 0; uStripe < uNoOfChunkStripes; uStripe++)
+			{
+				m_arrayChunkStripes[uStripe].slots.resize(uInitialNoOfSlotsPerStripe);
+			}
 
-			// Enforce sensible limits on the number of chunks.
-			const uint32_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
-			const uint32_t uMaxPracticalNoOfChunks = uChunkArraySize / 2; // A hash table should only become half-full to avoid too many clashes.
-			POLYVOX_LOG_WARNING_IF(m_uChunkCountLimit < uMinPracticalNoOfChunks, "Requested memory usage limit of ",
-				uTargetMemoryUsageInBytes / (1024 * 1024), "Mb is too low and cannot be adhered to.");
-			m_uChunkCountLimit = (std::max)(m_uChunkCountLimit, uMinPracticalNoOfChunks);
-			m_uChunkCountLimit = (std::min)(m_uChunkCountLimit, uMaxPracticalNoOfChunks);
+			for (uint32_t ct = 0; ct < uNoOfRecentEvictions; ct++)
+			{
+				m_arrayRecentEvictions[ct] = 0;
+			}
 
-			// Inform the user about the chosen memory configuration.
-			POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", (m_uChunkCountLimit * uChunkSizeInBytes) / (1024 * 1024),
-				"Mb (", m_uChunkCountLimit, " chunks of ", uChunkSizeInBytes / 1024, "Kb each).");
+			setTargetMemoryUsage(uTargetMemoryUsageInBytes);
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -90,6 +111,9 @@ namespace PolyVox
 	PagedVolume<VoxelType>::~PagedVolume()
 	{
 		flushAll();
+
+		// The chunk data pool is shared with other volumes, but would otherwise keep all of our memory.
+		Chunk::getDataPool(m_uChunkSideLength).trim();
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -124,7 +148,8 @@ namespace PolyVox
 		const uint16_t yOffset = static_cast<uint16_t>(uYPos & m_iChunkMask);
 		const uint16_t zOffset = static_cast<uint16_t>(uZPos & m_iChunkMask);
 
-		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
+		const LastAccessedChunk& lastAccessedChunk = getLastAccessedChunk();
+		auto pChunk = canReuseLastAccessedChunk(lastAccessedChunk, chunkX, chunkY, chunkZ) ? lastAccessedChunk.pChunk.get() : getChunk(chunkX, chunkY, chunkZ).get();
 
 		return pChunk->getVoxel(xOffset, yOffset, zOffset);
 	}
@@ -157,9 +182,59 @@ namespace PolyVox
 		const uint16_t yOffset = static_cast<uint16_t>(uYPos - (chunkY << m_uChunkSideLengthPower));
 		const uint16_t zOffset = static_cast<uint16_t>(uZPos - (chunkZ << m_uChunkSideLengthPower));
 
-		auto pChunk = canReuseLastAccessedChunk(chunkX, chunkY, chunkZ) ? m_pLastAccessedChunk : getChunk(chunkX, chunkY, chunkZ);
+		const uint64_t uHash = hashChunkPosition(chunkX, chunkY, chunkZ);
+		ChunkStripe& stripe = getStripe(uHash);
+		bool bCreated = false;
+		bool bGrew = false;
+		while (true)
+		{
+			// Finding the chunk may mean paging it in, which is done without holding the lock for the stripe.
+			LastAccessedChunk& lastAccessedChunk = getLastAccessedChunk();
+			if (!canReuseLastAccessedChunk(lastAccessedChunk, chunkX, chunkY, chunkZ))
+			{
+				bool bChunkCreated = false;
+				bool bPagedIn = false;
+				lastAccessedChunk.pChunk = acquireChunk(uHash, chunkX, chunkY, chunkZ, bChunkCreated, bPagedIn);
+				lastAccessedChunk.uVolumeId = m_uVolumeId;
+				lastAccessedChunk.iChunkX = chunkX;
+				lastAccessedChunk.iChunkY = chunkY;
+				lastAccessedChunk.iChunkZ = chunkZ;
+				bCreated = bCreated || bChunkCreated;
+			}
+
+			// The write is made while holding the lock for the stripe, which means the chunk cannot be evicted (and paged out) by
+			// another thread part way through. It also means the evicted flag is reliable. Our reference pins the chunk, but
+			// flushAll() may have removed it since we found it, in which case we go round again.
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			if (lastAccessedChunk.pChunk->m_bEvicted.load(std::memory_order_relaxed))
+			{
+				continue;
+			}
 
-		pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+			// If the chunk was using shared data then this write may give it it's own, and if it was packed then it may need larger
+			// indices or have to be unpacked. Either way it uses more memory.
+			Chunk* pChunk = lastAccessedChunk.pChunk.get();
+			const bool bWasUniform = static_cast<bool>(pChunk->m_pUniformData);
+			const uint32_t uOldSizeInBytes = pChunk->calculateSizeInBytes();
+			pChunk->setVoxel(xOffset, yOffset, zOffset, tValue);
+			const uint32_t uNewSizeInBytes = pChunk->calculateSizeInBytes();
+			if (bWasUniform && !pChunk->m_pUniformData)
+			{
+				m_uNoOfUniformChunks--;
+			}
+			if (uNewSizeInBytes != uOldSizeInBytes)
+			{
+				m_uChunkDataSizeInBytes += uNewSizeInBytes;
+				m_uChunkDataSizeInBytes -= uOldSizeInBytes;
+				bGrew = uNewSizeInBytes > uOldSizeInBytes;
+			}
+			break;
+		}
+
+		if (bCreated || bGrew)
+		{
+			evictChunksIfRequired();
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -195,168 +270,1184 @@ namespace PolyVox
 		// Ensure we don't page in more chunks than the volume can hold.
 		Region region(v3dStart, v3dEnd);
 		uint32_t uNoOfChunks = static_cast<uint32_t>(region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels());
-		POLYVOX_LOG_WARNING_IF(uNoOfChunks > m_uChunkCountLimit, "Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
-		uNoOfChunks = (std::min)(uNoOfChunks, m_uChunkCountLimit);
+		const uint32_t uChunkCountLimit = m_uChunkCountLimit.load();
+		if (uNoOfChunks > uChunkCountLimit)
+		{
+			POLYVOX_LOG_WARNING("Attempting to prefetch more than the maximum number of chunks (this will cause thrashing).");
+			notifyMemoryEvent(MemoryEvents::PrefetchTooLarge);
+			uNoOfChunks = uChunkCountLimit;
+		}
 
-		// Loops over the specified positions and touch the corresponding chunks.
-		for (int32_t x = v3dStart.getX(); x <= v3dEnd.getX(); x++)
+		// Loops over the specified positions and touch the corresponding chunks. We don't go through getChunk() as this is not a
+		// request for the voxel data, so it shouldn't replace the thread's last accessed chunk or count towards the hits and misses.
+		// Chunks which have to come from the Pager are collected up and paged in together, which is much faster for the Cubiquity
+		// database than asking for them one at a time. Those which are already present or can be recreated without the Pager (from
+		// the page out queue or compressed chunk cache) are dealt with straight away, as there is nothing to gain by waiting.
+		std::vector<Vector3DInt32> v3dChunksToPageIn;
+		uint32_t uNoOfChunksTouched = 0;
+		for (int32_t x = v3dStart.getX(); (x <= v3dEnd.getX()) && (uNoOfChunksTouched < uNoOfChunks); x++)
 		{
-			for (int32_t y = v3dStart.getY(); y <= v3dEnd.getY(); y++)
+			for (int32_t y = v3dStart.getY(); (y <= v3dEnd.getY()) && (uNoOfChunksTouched < uNoOfChunks); y++)
 			{
-				for (int32_t z = v3dStart.getZ(); z <= v3dEnd.getZ(); z++)
+				for (int32_t z = v3dStart.getZ(); (z <= v3dEnd.getZ()) && (uNoOfChunksTouched < uNoOfChunks); z++)
 				{
-					getChunk(x, y, z);
+					const uint64_t uHash = hashChunkPosition(x, y, z);
+					ChunkStripe& stripe = getStripe(uHash);
+					bool bCreated = false;
+					bool bPagedIn = false;
+					bool bFound = false;
+					{
+						std::lock_guard<std::mutex> lock(stripe.mutex);
+						bFound = (findOrCreateChunk(stripe, uHash, x, y, z, bCreated, bPagedIn, false) != nullptr);
+					}
+
+					if (bCreated)
+					{
+						m_uNoOfPrefetchedChunks.fetch_add(1, std::memory_order_relaxed);
+						evictChunksIfRequired();
+					}
+
+					if (!bFound)
+					{
+						v3dChunksToPageIn.push_back(Vector3DInt32(x, y, z));
+						if (v3dChunksToPageIn.size() == uMaxNoOfChunksPerPageInBatch)
+						{
+							pageInChunks(v3dChunksToPageIn);
+							v3dChunksToPageIn.clear();
+						}
+					}
+
+					uNoOfChunksTouched++;
 				}
 			}
 		}
+
+		if (!v3dChunksToPageIn.empty())
+		{
+			pageInChunks(v3dChunksToPageIn);
+		}
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
 	/// Removes all voxels from memory, and calls dataOverflowHandler() to ensure the application has a chance to store the data.
+	/// Chunks which are still in use by a Sampler stay alive until it has finished with them, but are no longer part of the volume.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
 	void PagedVolume<VoxelType>::flushAll()
 	{
-		// Clear this pointer as all chunks are about to be removed.
-		m_pLastAccessedChunk = nullptr;
+		// While we are flushing, evicted chunks are paged out straight away rather than queued. Otherwise another thread could take one
+		// back from the queue after we have been through it's stripe, and it would still be modified (and in memory) when we return.
+		{
+			std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+			m_uNoOfFlushesInProgress++;
+		}
+
+		try
+		{
+			// Chunks which were evicted earlier may still be waiting to be paged out, possibly by another thread right now. Any which are
+			// taken back in the meantime are in the chunk table by the time the queue is empty, so they are paged out below instead.
+			while (true)
+			{
+				pageOutQueuedChunks((std::numeric_limits<uint32_t>::max)());
+
+				std::unique_lock<std::mutex> lock(m_pageOutQueueMutex);
+				m_pageOutFinished.wait(lock, [this] { return m_uNoOfChunksBeingPagedOut == 0; });
+				if (m_mapQueuedChunks.empty())
+				{
+					break;
+				}
+			}
+
+			// Erase all the most recently used chunks.
+			for (uint32_t uStripe = 0; uStripe < uNoOfChunkStripes; uStripe++)
+			{
+				ChunkStripe& stripe = m_arrayChunkStripes[uStripe];
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				while (stripe.pLeastRecentlyUsed)
+				{
+					removeChunk(stripe, stripe.pLeastRecentlyUsed, true);
+				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+			m_uNoOfFlushesInProgress--;
+			throw;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+			m_uNoOfFlushesInProgress--;
+		}
+
+		// This is used when the data behind the Pager is about to change (e.g. Cubiquity accepting or discarding it's
+		// temporary changes), so the compressed copies may soon be out of date and we discard them too.
+		clearCompressedChunks();
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::takeCompressedChunk(const Vector3DInt32& v3dChunkPos, std::vector<VoxelRun>& runs) const
+	{
+		std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
 
-		// Erase all the most recently used chunks.
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		auto mapIter = m_mapCompressedChunks.find(v3dChunkPos);
+		if (mapIter == m_mapCompressedChunks.end())
 		{
-			m_arrayChunks[uIndex] = nullptr;
+			return false;
 		}
+
+		// The chunk is about to be back in memory, so there's no point keeping the compressed copy as well.
+		auto listIter = mapIter->second;
+		runs.swap(listIter->runs);
+		m_uCompressedCacheSizeInBytes -= runs.size() * sizeof(VoxelRun);
+		m_listCompressedChunks.erase(listIter);
+		m_mapCompressedChunks.erase(mapIter);
+		return true;
 	}
 
 	template <typename VoxelType>
-	bool PagedVolume<VoxelType>::canReuseLastAccessedChunk(int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	void PagedVolume<VoxelType>::addCompressedChunk(const Vector3DInt32& v3dChunkPos, std::vector<VoxelRun>&& runs) const
 	{
-		return ((iChunkX == m_v3dLastAccessedChunkX) &&
-			(iChunkY == m_v3dLastAccessedChunkY) &&
-			(iChunkZ == m_v3dLastAccessedChunkZ) &&
-			(m_pLastAccessedChunk));
+		// Noisy chunks may not compress at all, and are then better left to the Pager.
+		const uint64_t uSizeInBytes = runs.size() * sizeof(VoxelRun);
+		if (uSizeInBytes >= Chunk::calculateSizeInBytes(m_uChunkSideLength))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+
+		if (uSizeInBytes > m_uCompressedCacheLimitInBytes)
+		{
+			return;
+		}
+
+		// There can't already be an entry for this position because it would have been taken when the chunk was created.
+		POLYVOX_ASSERT(m_mapCompressedChunks.find(v3dChunkPos) == m_mapCompressedChunks.end(), "Chunk is already in the compressed chunk cache.");
+
+		CompressedChunk compressedChunk;
+		compressedChunk.v3dPosition = v3dChunkPos;
+		compressedChunk.runs = std::move(runs);
+		compressedChunk.runs.shrink_to_fit(); // So the memory used matches the size we record.
+		m_listCompressedChunks.push_front(std::move(compressedChunk));
+		m_mapCompressedChunks[v3dChunkPos] = m_listCompressedChunks.begin();
+		m_uCompressedCacheSizeInBytes += uSizeInBytes;
+
+		evictCompressedChunksIfRequired();
 	}
 
 	template <typename VoxelType>
-	typename PagedVolume<VoxelType>::Chunk* PagedVolume<VoxelType>::getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	void PagedVolume<VoxelType>::evictCompressedChunksIfRequired(void) const
 	{
-		Chunk* pChunk = nullptr;
+		while (m_uCompressedCacheSizeInBytes > m_uCompressedCacheLimitInBytes)
+		{
+			// The oldest entry is at the back. These all match the Pager's data, so they can just be dropped.
+			CompressedChunk& oldest = m_listCompressedChunks.back();
+			m_uCompressedCacheSizeInBytes -= oldest.runs.size() * sizeof(VoxelRun);
+			m_mapCompressedChunks.erase(oldest.v3dPosition);
+			m_listCompressedChunks.pop_back();
+		}
+	}
 
-		// We generate a 16-bit hash here and assume this matches the range available in the chunk
-		// array. The assert here is just to make sure we take care if change this in the future.
-		static_assert(uChunkArraySize == 65536, "Chunk array size has changed, check if the hash calculation needs updating.");
-		// Extract the lower five bits from each position component.
-		const uint32_t uChunkXLowerBits = static_cast<uint32_t>(uChunkX & 0x1F);
-		const uint32_t uChunkYLowerBits = static_cast<uint32_t>(uChunkY & 0x1F);
-		const uint32_t uChunkZLowerBits = static_cast<uint32_t>(uChunkZ & 0x1F);
-		// Combine then to form a 15-bit hash of the position. Also shift by one to spread the values out in the whole 16-bit space.
-		const uint32_t iPosisionHash = (((uChunkXLowerBits)) | ((uChunkYLowerBits) << 5) | ((uChunkZLowerBits) << 10) << 1);
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::clearCompressedChunks(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+		m_listCompressedChunks.clear();
+		m_mapCompressedChunks.clear();
+		m_uCompressedCacheSizeInBytes = 0;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::queueChunkForPageOut(const std::shared_ptr<Chunk>& pChunk) const
+	{
+		std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+
+		if ((m_uNoOfFlushesInProgress > 0) || (m_mapQueuedChunks.size() >= uMaxNoOfQueuedChunks))
+		{
+			return false;
+		}
+
+		// There can't already be an entry for this position because it would have been taken when the chunk was created.
+		POLYVOX_ASSERT(m_mapQueuedChunks.find(pChunk->m_v3dChunkSpacePosition) == m_mapQueuedChunks.end(), "Chunk is already queued for paging out.");
+
+		QueuedChunk queuedChunk;
+		queuedChunk.pChunk = pChunk;
+		queuedChunk.bBeingPagedOut = false;
+		m_mapQueuedChunks[pChunk->m_v3dChunkSpacePosition] = queuedChunk;
+		return true;
+	}
+
+	template <typename VoxelType>
+	std::shared_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::takeQueuedChunk(const Vector3DInt32& v3dChunkPos) const
+	{
+		std::unique_lock<std::mutex> lock(m_pageOutQueueMutex);
+
+		// A chunk which is being paged out can't be changed until that has finished, after which it is no longer queued.
+		auto iter = m_mapQueuedChunks.find(v3dChunkPos);
+		while ((iter != m_mapQueuedChunks.end()) && iter->second.bBeingPagedOut)
+		{
+			m_pageOutFinished.wait(lock);
+			iter = m_mapQueuedChunks.find(v3dChunkPos);
+		}
 
-		// Starting at the position indicated by the hash, and then search through the whole array looking for a chunk with the correct
-		// position. In most cases we expect to find it in the first place we look. Note that this algorithm is slow in the case that
-		// the chunk is not found because the whole array has to be searched, but in this case we are going to have to page the data in
-		// from an external source which is likely to be slow anyway.
-		uint32_t iIndex = iPosisionHash;
-		do
+		if (iter == m_mapQueuedChunks.end())
 		{
-			if (m_arrayChunks[iIndex])
+			return nullptr;
+		}
+
+		std::shared_ptr<Chunk> pChunk = std::move(iter->second.pChunk);
+		m_mapQueuedChunks.erase(iter);
+		return pChunk;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The chunks are passed to the Pager together (through Pager::pageOutBatch()) so it can write them efficiently. It is safe to call
+	/// this at the same time as accessing voxels, and if one of the chunks is needed while it is being paged out then the access waits.
+	/// \param uMaxNoOfChunks The maximum number of chunks to page out.
+	/// \return The number of chunks which were paged out.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::pageOutQueuedChunks(uint32_t uMaxNoOfChunks)
+	{
+		// The chunks stay in the queue until they have been paged out, so that other threads know to wait for them. While they
+		// are marked as being paged out nothing else will touch them, so we can use them without holding the lock.
+		std::vector< std::pair<Region, Chunk*> > chunks;
+		{
+			std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+			for (auto iter = m_mapQueuedChunks.begin(); (iter != m_mapQueuedChunks.end()) && (chunks.size() < uMaxNoOfChunks); iter++)
 			{
-				Vector3DInt32& entryPos = m_arrayChunks[iIndex]->m_v3dChunkSpacePosition;
-				if (entryPos.getX() == uChunkX && entryPos.getY() == uChunkY && entryPos.getZ() == uChunkZ)
+				if (!iter->second.bBeingPagedOut)
 				{
-					pChunk = m_arrayChunks[iIndex].get();
-					pChunk->m_uChunkLastAccessed = ++m_uTimestamper;
-					break;
+					iter->second.bBeingPagedOut = true;
+					m_uNoOfChunksBeingPagedOut++;
+
+					Chunk* pChunk = iter->second.pChunk.get();
+					Vector3DInt32 v3dLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(m_uChunkSideLength);
+					Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uChunkSideLength - 1, m_uChunkSideLength - 1, m_uChunkSideLength - 1);
+					chunks.push_back(std::make_pair(Region(v3dLower, v3dUpper), pChunk));
+				}
+			}
+		}
+
+		if (chunks.empty())
+		{
+			return 0;
+		}
+
+		try
+		{
+			m_pPager->pageOutBatch(chunks);
+		}
+		catch (...)
+		{
+			// Leave them queued, so they can be taken back or tried again. Anyone waiting for them must be woken up.
+			{
+				std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+				for (uint32_t ct = 0; ct < chunks.size(); ct++)
+				{
+					m_mapQueuedChunks[chunks[ct].second->m_v3dChunkSpacePosition].bBeingPagedOut = false;
 				}
+				m_uNoOfChunksBeingPagedOut -= static_cast<uint32_t>(chunks.size());
+			}
+			m_pageOutFinished.notify_all();
+			throw;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+			for (uint32_t ct = 0; ct < chunks.size(); ct++)
+			{
+				// Clearing the flag first stops the chunk being paged out again when it is destroyed.
+				chunks[ct].second->m_bDataModified = false;
+				m_mapQueuedChunks.erase(chunks[ct].second->m_v3dChunkSpacePosition);
 			}
+			m_uNoOfChunksBeingPagedOut -= static_cast<uint32_t>(chunks.size());
+			m_uNoOfChunksPagedOut += chunks.size();
+		}
+		m_pageOutFinished.notify_all();
+
+		return static_cast<uint32_t>(chunks.size());
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::getNoOfQueuedChunks(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_pageOutQueueMutex);
+		return static_cast<uint32_t>(m_mapQueuedChunks.size());
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is disabled by default. When enabled, each chunk which is paged in (or recreated from the compressed chunk cache) and has
+	/// no more than 256 different values is stored as 1, 2, 4 or 8 bit indices into a palette of those values. Chunks which start
+	/// out all one value are packed the first time a different value is written to them. Writing a new value to a packed chunk adds
+	/// it to the palette, moving to larger indices as required, and once more than 256 values are needed the chunk is unpacked.
+	/// Packed chunks count towards the target memory usage by the memory they actually use, so many more of them fit. Reading from
+	/// them is a little slower, though this is mostly hidden by the Sampler as it looks up the chunk's data once for many voxels.
+	/// Only chunks created after this is called are affected, so it should normally be set before the volume is used.
+	/// \param bEnabled Whether to pack chunks with few enough different values.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setPaletteCompression(bool bEnabled)
+	{
+		m_bPaletteCompression = bEnabled;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is disabled by default, in which case modified chunks are paged out by whichever thread evicts them. When enabled they are
+	/// instead queued, and the application must call pageOutQueuedChunks() from time to time (typically from a background thread).
+	/// Chunks which are already queued when this is disabled stay queued until they are paged out (or until flushAll() is called).
+	/// \param bDeferPageOut Whether to queue modified chunks rather than paging them out straight away.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setDeferredPageOut(bool bDeferPageOut)
+	{
+		m_bDeferPageOut = bDeferPageOut;
+	}
+
+	template <typename VoxelType>
+	std::shared_ptr<VoxelType> PagedVolume<VoxelType>::getUniformData(const VoxelType& tValue) const
+	{
+		std::lock_guard<std::mutex> lock(m_uniformDataMutex);
+
+		for (uint32_t uIndex = 0; uIndex < m_vecUniformData.size(); uIndex++)
+		{
+			if (*m_vecUniformData[uIndex] == tValue)
+			{
+				return m_vecUniformData[uIndex];
+			}
+		}
+
+		// A volume with many different uniform values (e.g. each chunk a solid block of a different colour) is unusual, so
+		// rather than managing lots of shared data we let the remaining chunks keep their own.
+		if (m_vecUniformData.size() >= uMaxNoOfUniformValues)
+		{
+			return nullptr;
+		}
+
+		const uint32_t uNoOfVoxels = m_uChunkSideLength * m_uChunkSideLength * m_uChunkSideLength;
+		std::shared_ptr<VoxelType> pUniformData(new VoxelType[uNoOfVoxels], std::default_delete<VoxelType[]>());
+		std::fill(pUniformData.get(), pUniformData.get() + uNoOfVoxels, tValue);
+		m_vecUniformData.push_back(pUniformData);
+		return pUniformData;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::compactChunkData(Chunk* pChunk) const
+	{
+		pChunk->m_bUsePalette = m_bPaletteCompression.load();
+		if (pChunk->m_pUniformData)
+		{
+			return;
+		}
+
+		VoxelType tUniformValue;
+		if (pChunk->findUniformValue(tUniformValue))
+		{
+			std::shared_ptr<VoxelType> pUniformData = getUniformData(tUniformValue);
+			if (pUniformData)
+			{
+				pChunk->useUniformData(pUniformData);
+				return;
+			}
+		}
+
+		if (pChunk->m_bUsePalette)
+		{
+			pChunk->packData();
+		}
+	}
+
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::calculateChunkSizeInBytes(void) const
+	{
+		// Note: We disregard the size of the other class members (except for chunks without data of their own) as they are likely
+		// to be very small compared to the size of the allocated voxel data. The shared uniform data is also small, being at most a
+		// few chunks in total, so that isn't counted either.
+		return m_uChunkDataSizeInBytes.load() + sizeof(Chunk) * m_uNoOfUniformChunks.load();
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::LastAccessedChunk& PagedVolume<VoxelType>::getLastAccessedChunk(void)
+	{
+		static thread_local LastAccessedChunk lastAccessedChunk;
+		return lastAccessedChunk;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::canReuseLastAccessedChunk(const LastAccessedChunk& lastAccessedChunk, int32_t iChunkX, int32_t iChunkY, int32_t iChunkZ) const
+	{
+		return ((iChunkX == lastAccessedChunk.iChunkX) &&
+			(iChunkY == lastAccessedChunk.iChunkY) &&
+			(iChunkZ == lastAccessedChunk.iChunkZ) &&
+			(lastAccessedChunk.uVolumeId == m_uVolumeId) &&
+			(!lastAccessedChunk.pChunk->m_bEvicted.load(std::memory_order_relaxed)));
+	}
+
+	template <typename VoxelType>
+	const std::shared_ptr<typename PagedVolume<VoxelType>::Chunk>& PagedVolume<VoxelType>::getChunk(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	{
+		LastAccessedChunk& lastAccessedChunk = getLastAccessedChunk();
+		if (canReuseLastAccessedChunk(lastAccessedChunk, uChunkX, uChunkY, uChunkZ))
+		{
+			return lastAccessedChunk.pChunk;
+		}
+
+		bool bCreated = false;
+		bool bPagedIn = false;
+		std::shared_ptr<Chunk> pChunk = acquireChunk(hashChunkPosition(uChunkX, uChunkY, uChunkZ), uChunkX, uChunkY, uChunkZ, bCreated, bPagedIn);
+
+		if (bPagedIn || !bCreated)
+		{
+			(bPagedIn ? m_uNoOfMisses : m_uNoOfHits).fetch_add(1, std::memory_order_relaxed);
+		}
 
-			iIndex++;
-			iIndex %= uChunkArraySize;
-		} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
+		// Note that we update this before evicting, so that the reference it holds prevents the new chunk being chosen.
+		lastAccessedChunk.pChunk = std::move(pChunk);
+		lastAccessedChunk.uVolumeId = m_uVolumeId;
+		lastAccessedChunk.iChunkX = uChunkX;
+		lastAccessedChunk.iChunkY = uChunkY;
+		lastAccessedChunk.iChunkZ = uChunkZ;
 
-		// If we still haven't found the chunk then it's time to create a new one and page it in from disk.
-		if (!pChunk)
+		if (bCreated)
 		{
-			// The chunk was not found so we will create a new one.
-			Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
-			pChunk = new PagedVolume<VoxelType>::Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager);
-			pChunk->m_uChunkLastAccessed = ++m_uTimestamper; // Important, as we may soon delete the oldest chunk
+			evictChunksIfRequired();
+		}
+
+		return lastAccessedChunk.pChunk;
+	}
+
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::hashChunkPosition(int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ)
+	{
+		// Combine the three coordinates and then apply the SplitMix64 finaliser, so that every bit of the input affects every bit of the
+		// output. Neighbouring chunks (which are often used together) therefore end up in unrelated slots, and usually different stripes.
+		uint64_t uHash = static_cast<uint32_t>(uChunkX);
+		uHash = uHash * 0x9E3779B97F4A7C15ULL + static_cast<uint32_t>(uChunkY);
+		uHash = uHash * 0x9E3779B97F4A7C15ULL + static_cast<uint32_t>(uChunkZ);
 
-			// Store the chunk at the appropriate place in out chunk array. Ideally this place is
-			// given by the hash, otherwise we do a linear search for the next available location
-			// We always expect to find a free place because we aim to keep the array only half full.
-			uint32_t iIndex = iPosisionHash;
-			bool bInsertedSucessfully = false;
-			do
+		uHash ^= uHash >> 30;
+		uHash *= 0xBF58476D1CE4E5B9ULL;
+		uHash ^= uHash >> 27;
+		uHash *= 0x94D049BB133111EBULL;
+		uHash ^= uHash >> 31;
+		return uHash;
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkStripe& PagedVolume<VoxelType>::getStripe(uint64_t uHash) const
+	{
+		// The top bits, as the bottom ones are used to pick the slot within the stripe.
+		static_assert(uNoOfChunkStripes == 16, "Number of stripes has changed, check the stripe selection.");
+		return m_arrayChunkStripes[uHash >> 60];
+	}
+
+	template <typename VoxelType>
+	std::shared_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::findOrCreateChunk(ChunkStripe& stripe, uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool& bCreated, bool& bPagedIn, bool bCanPageIn) const
+	{
+		bCreated = false;
+		bPagedIn = false;
+
+		ChunkSlot* pSlot = findSlot(stripe, uHash, uChunkX, uChunkY, uChunkZ);
+		if (pSlot)
+		{
+			markChunkAsUsed(stripe, pSlot->pChunk.get());
+			return pSlot->pChunk;
+		}
+
+		// The chunk was not found so we will create a new one, from the page out queue or compressed chunk cache if possible and otherwise
+		// by paging it in. This happens while we hold the lock for the stripe, which makes sure that two threads requesting the same chunk
+		// don't both create it. Paging in is slow though, so for that we only add a placeholder here and the Pager is called afterwards.
+		Vector3DInt32 v3dChunkPos(uChunkX, uChunkY, uChunkZ);
+		std::shared_ptr<Chunk> pChunk = takeQueuedChunk(v3dChunkPos);
+		std::vector<VoxelRun> runs;
+		if (pChunk)
+		{
+			// It still has the changes which have not been paged out, so it can just go back in the table.
+			pChunk->m_bEvicted.store(false, std::memory_order_relaxed);
+		}
+		else if (takeCompressedChunk(v3dChunkPos, runs))
+		{
+			// This constructor is private, so make_shared() can't be used.
+			std::shared_ptr<VoxelType> pUniformData = (runs.size() == 1) ? getUniformData(runs[0].tValue) : nullptr;
+			pChunk = std::shared_ptr<Chunk>(new Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager, runs, pUniformData));
+			compactChunkData(pChunk.get());
+			m_uNoOfCompressedCacheHits.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (!bCanPageIn)
+		{
+			return nullptr;
+		}
+		else
+		{
+			// This constructor is private, so make_shared() can't be used. It leaves the data uninitialised for pageInPlaceholder().
+			pChunk = std::shared_ptr<Chunk>(new Chunk(v3dChunkPos, m_uChunkSideLength, m_pPager, false));
+			pChunk->m_bBeingPagedIn.store(true, std::memory_order_relaxed);
+			bPagedIn = true;
+		}
+		insertChunk(stripe, uHash, pChunk);
+		noteChunkCreated(uHash);
+		bCreated = true;
+		return pChunk;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::insertChunk(ChunkStripe& stripe, uint64_t uHash, const std::shared_ptr<Chunk>& pChunk) const
+	{
+		insertSlot(stripe, uHash, pChunk);
+		markChunkAsUsed(stripe, pChunk.get()); // Important, as we may soon delete the oldest chunk
+
+		m_uChunkCount++;
+		if (pChunk->m_pUniformData)
+		{
+			m_uNoOfUniformChunks++;
+		}
+		m_uChunkDataSizeInBytes += pChunk->calculateSizeInBytes();
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::pageInChunks(const std::vector<Vector3DInt32>& v3dChunkPositions)
+	{
+		// The chunks are not in the table while they are being paged in, so another thread which needs one of them in the meantime will
+		// page in it's own copy. That's wasted effort but harmless, and much better than blocking every stripe for the whole batch.
+		// What we must not do is add a copy which is out of date, which could happen if another thread creates the chunk, modifies it
+		// and pages it out before we are done. So we note how many chunks have been paged out before we start, and check it again later.
+		const uint64_t uNoOfChunksPagedOut = m_uNoOfChunksPagedOut.load();
+
+		std::vector< std::shared_ptr<Chunk> > vecChunks;
+		std::vector< std::pair<Region, Chunk*> > vecChunksForPager;
+		for (uint32_t ct = 0; ct < v3dChunkPositions.size(); ct++)
+		{
+			// This constructor is private, so make_shared() can't be used.
+			std::shared_ptr<Chunk> pChunk(new Chunk(v3dChunkPositions[ct], m_uChunkSideLength, m_pPager, false));
+			Vector3DInt32 v3dLower = v3dChunkPositions[ct] * static_cast<int32_t>(m_uChunkSideLength);
+			Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uChunkSideLength - 1, m_uChunkSideLength - 1, m_uChunkSideLength - 1);
+			vecChunksForPager.push_back(std::make_pair(Region(v3dLower, v3dUpper), pChunk.get()));
+			vecChunks.push_back(std::move(pChunk));
+		}
+
+		m_pPager->pageInBatch(vecChunksForPager);
+
+		uint32_t uNoOfChunksAdded = 0;
+		for (uint32_t ct = 0; ct < vecChunks.size(); ct++)
+		{
+			std::shared_ptr<Chunk>& pChunk = vecChunks[ct];
+
+			// As in pageInPlaceholder(), but done before taking the lock.
+			compactChunkData(pChunk.get());
+
+			const Vector3DInt32& v3dPos = v3dChunkPositions[ct];
+			const uint64_t uHash = hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
+			ChunkStripe& stripe = getStripe(uHash);
+			bool bCreated = false;
+			bool bPagedIn = false;
 			{
-				if (m_arrayChunks[iIndex] == nullptr)
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+
+				// Another thread may have created the chunk in the meantime, or it may since have been evicted (in which case the copy in
+				// the page out queue or compressed chunk cache is used instead of ours). Only then can we check the page out count, as
+				// taking a chunk from the queue waits for it to finish being paged out.
+				if (!findOrCreateChunk(stripe, uHash, v3dPos.getX(), v3dPos.getY(), v3dPos.getZ(), bCreated, bPagedIn, false) &&
+					(m_uNoOfChunksPagedOut.load() == uNoOfChunksPagedOut))
 				{
-					m_arrayChunks[iIndex] = std::move(std::unique_ptr< Chunk >(pChunk));
-					bInsertedSucessfully = true;
-					break;
+					insertChunk(stripe, uHash, pChunk);
+					noteChunkCreated(uHash);
+					bCreated = true;
+					uNoOfChunksAdded++;
+				}
+			}
+
+			if (bCreated)
+			{
+				m_uNoOfPrefetchedChunks.fetch_add(1, std::memory_order_relaxed);
+				evictChunksIfRequired();
+			}
+		}
+
+		return uNoOfChunksAdded;
+	}
+
+	template <typename VoxelType>
+	std::shared_ptr<typename PagedVolume<VoxelType>::Chunk> PagedVolume<VoxelType>::acquireChunk(uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ, bool& bCreated, bool& bPagedIn) const
+	{
+		ChunkStripe& stripe = getStripe(uHash);
+		while (true)
+		{
+			std::shared_ptr<Chunk> pChunk;
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				pChunk = findOrCreateChunk(stripe, uHash, uChunkX, uChunkY, uChunkZ, bCreated, bPagedIn);
+			}
+
+			if (bPagedIn)
+			{
+				pageInPlaceholder(stripe, pChunk);
+				return pChunk;
+			}
+
+			// If another thread failed to page it in then we try for ourselves, which at least means the error reaches our caller too.
+			if (waitForPageIn(pChunk.get()))
+			{
+				return pChunk;
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::pageInPlaceholder(ChunkStripe& stripe, const std::shared_ptr<Chunk>& pChunk) const
+	{
+		// No other thread will touch the data until we clear the flag. The reference we hold pins the chunk so it can't be evicted
+		// in the meantime, though flushAll() may still remove it from the table.
+		Vector3DInt32 v3dLower = pChunk->m_v3dChunkSpacePosition * static_cast<int32_t>(m_uChunkSideLength);
+		Vector3DInt32 v3dUpper = v3dLower + Vector3DInt32(m_uChunkSideLength - 1, m_uChunkSideLength - 1, m_uChunkSideLength - 1);
+		try
+		{
+			m_pPager->pageIn(Region(v3dLower, v3dUpper), pChunk.get());
+		}
+		catch (...)
+		{
+			// The data may be half written, so it must not be paged out or cached when the placeholder is removed. It
+			// may also have been removed already (by flushAll()).
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				pChunk->m_bDataModified = false;
+				if (!pChunk->m_bEvicted.load(std::memory_order_relaxed))
+				{
+					removeChunk(stripe, pChunk.get(), true);
 				}
+			}
 
-				iIndex++;
-				iIndex %= uChunkArraySize;
-			} while (iIndex != iPosisionHash); // Keep searching until we get back to our start position.
-
-			// This should never really happen unless we are failing to keep our number of active chunks
-			// significantly under the target amount. Perhaps if chunks are 'pinned' for threading purposes?
-			POLYVOX_THROW_IF(!bInsertedSucessfully, std::logic_error, "No space in chunk array for new chunk.");
-
-			// As we have added a chunk we may have exceeded our target chunk limit. Search through the array to
-			// determine how many chunks we have, as well as finding the oldest timestamp. Note that this is potentially
-			// wasteful and we may instead wish to track how many chunks we have and/or delete a chunk at random (or
-			// just check e.g. 10 and delete the oldest of those) but we'll see if this is a bottleneck first. Paging
-			// the data in is probably more expensive.
-			uint32_t uChunkCount = 0;
-			uint32_t uOldestChunkIndex = 0;
-			uint32_t uOldestChunkTimestamp = std::numeric_limits<uint32_t>::max();
-			for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
-			{
-				if (m_arrayChunks[uIndex])
+			{
+				std::lock_guard<std::mutex> lock(m_pageInMutex);
+				pChunk->m_bPageInFailed = true;
+				pChunk->m_bBeingPagedIn.store(false, std::memory_order_release);
+			}
+			m_pageInFinished.notify_all();
+			throw;
+		}
+
+		{
+			// The Pager always fills in the whole chunk, so we can only tell whether it is all the same value afterwards. Chunks which the
+			// Pager doesn't have any data for (which is most of the sky in a typical volume) are the common case. This changes how much
+			// memory the chunk uses, which was counted when the placeholder was added, unless flushAll() has removed it since.
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			if (!pChunk->m_bEvicted.load(std::memory_order_relaxed))
+			{
+				const uint32_t uOldSizeInBytes = pChunk->calculateSizeInBytes();
+				compactChunkData(pChunk.get());
+				if (pChunk->m_pUniformData)
+				{
+					m_uNoOfUniformChunks++;
+				}
+				m_uChunkDataSizeInBytes += pChunk->calculateSizeInBytes();
+				m_uChunkDataSizeInBytes -= uOldSizeInBytes;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_pageInMutex);
+			pChunk->m_bBeingPagedIn.store(false, std::memory_order_release);
+		}
+		m_pageInFinished.notify_all();
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::waitForPageIn(const Chunk* pChunk) const
+	{
+		// Nearly always the chunk has long since been paged in, so we don't want to lock anything to find that out.
+		if (pChunk->m_bBeingPagedIn.load(std::memory_order_acquire))
+		{
+			std::unique_lock<std::mutex> lock(m_pageInMutex);
+			m_pageInFinished.wait(lock, [pChunk] { return !pChunk->m_bBeingPagedIn.load(std::memory_order_acquire); });
+		}
+
+		return !pChunk->m_bPageInFailed;
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkSlot* PagedVolume<VoxelType>::findSlot(ChunkStripe& stripe, uint64_t uHash, int32_t uChunkX, int32_t uChunkY, int32_t uChunkZ) const
+	{
+		// The table is never more than half full, so we always reach an empty slot.
+		const uint32_t uMask = static_cast<uint32_t>(stripe.slots.size()) - 1;
+		for (uint32_t uIndex = static_cast<uint32_t>(uHash) & uMask; stripe.slots[uIndex].pChunk; uIndex = (uIndex + 1) & uMask)
+		{
+			ChunkSlot& slot = stripe.slots[uIndex];
+			if (slot.uHash == uHash)
+			{
+				const Vector3DInt32& entryPos = slot.pChunk->m_v3dChunkSpacePosition;
+				if (entryPos.getX() == uChunkX && entryPos.getY() == uChunkY && entryPos.getZ() == uChunkZ)
+				{
+					return &slot;
+				}
+			}
+		}
+
+		return nullptr;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::insertSlot(ChunkStripe& stripe, uint64_t uHash, const std::shared_ptr<Chunk>& pChunk) const
+	{
+		if ((stripe.uNoOfChunks + 1) * 2 > stripe.slots.size())
+		{
+			// Double the size and reinsert everything. The chunks themselves don't move, so the LRU list is unaffected.
+			std::vector<ChunkSlot> oldSlots(stripe.slots.size() * 2);
+			oldSlots.swap(stripe.slots);
+			const uint32_t uNewMask = static_cast<uint32_t>(stripe.slots.size()) - 1;
+			for (uint32_t uOld = 0; uOld < oldSlots.size(); uOld++)
+			{
+				if (oldSlots[uOld].pChunk)
 				{
-					uChunkCount++;
-					if (m_arrayChunks[uIndex]->m_uChunkLastAccessed < uOldestChunkTimestamp)
+					uint32_t uIndex = static_cast<uint32_t>(oldSlots[uOld].uHash) & uNewMask;
+					while (stripe.slots[uIndex].pChunk)
 					{
-						uOldestChunkTimestamp = m_arrayChunks[uIndex]->m_uChunkLastAccessed;
-						uOldestChunkIndex = uIndex;
+						uIndex = (uIndex + 1) & uNewMask;
 					}
+					stripe.slots[uIndex] = std::move(oldSlots[uOld]);
 				}
 			}
+		}
+
+		const uint32_t uMask = static_cast<uint32_t>(stripe.slots.size()) - 1;
+		uint32_t uIndex = static_cast<uint32_t>(uHash) & uMask;
+		while (stripe.slots[uIndex].pChunk)
+		{
+			uIndex = (uIndex + 1) & uMask;
+		}
+
+		stripe.slots[uIndex].uHash = uHash;
+		stripe.slots[uIndex].pChunk = pChunk;
+		stripe.uNoOfChunks++;
+	}
 
-			// Check if we have too many chunks, and delete the oldest if so.
-			if (uChunkCount > m_uChunkCountLimit)
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::eraseSlot(ChunkStripe& stripe, ChunkSlot* pSlot) const
+	{
+		// Rather than leaving a 'deleted' marker we move later entries back to fill the gap, as otherwise the markers would build
+		// up and lengthen the probe sequences. An entry can only move back if that doesn't take it before the slot it hashes to.
+		const uint32_t uMask = static_cast<uint32_t>(stripe.slots.size()) - 1;
+		uint32_t uGap = static_cast<uint32_t>(pSlot - &stripe.slots[0]);
+		for (uint32_t uIndex = (uGap + 1) & uMask; stripe.slots[uIndex].pChunk; uIndex = (uIndex + 1) & uMask)
+		{
+			const uint32_t uHome = static_cast<uint32_t>(stripe.slots[uIndex].uHash) & uMask;
+			const uint32_t uDistanceToGap = (uGap - uHome) & uMask;
+			const uint32_t uDistanceToIndex = (uIndex - uHome) & uMask;
+			if (uDistanceToGap < uDistanceToIndex)
 			{
-				m_arrayChunks[uOldestChunkIndex] = nullptr;
+				stripe.slots[uGap] = std::move(stripe.slots[uIndex]);
+				uGap = uIndex;
 			}
 		}
 
-		m_pLastAccessedChunk = pChunk;
-		m_v3dLastAccessedChunkX = uChunkX;
-		m_v3dLastAccessedChunkY = uChunkY;
-		m_v3dLastAccessedChunkZ = uChunkZ;
+		stripe.slots[uGap].pChunk = nullptr;
+		stripe.slots[uGap].uHash = 0;
+		stripe.uNoOfChunks--;
+	}
 
-		return pChunk;
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::markChunkAsUsed(ChunkStripe& stripe, Chunk* pChunk) const
+	{
+		pChunk->m_uChunkLastAccessed.store(++m_uTimestamper, std::memory_order_relaxed);
+
+		if (stripe.pMostRecentlyUsed == pChunk)
+		{
+			return;
+		}
+
+		// Move it to the front of the list.
+		unlinkChunk(stripe, pChunk);
+		pChunk->m_pLruNext = stripe.pMostRecentlyUsed;
+		if (stripe.pMostRecentlyUsed)
+		{
+			stripe.pMostRecentlyUsed->m_pLruPrev = pChunk;
+		}
+		stripe.pMostRecentlyUsed = pChunk;
+		if (!stripe.pLeastRecentlyUsed)
+		{
+			stripe.pLeastRecentlyUsed = pChunk;
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::unlinkChunk(ChunkStripe& stripe, Chunk* pChunk) const
+	{
+		// Also copes with a chunk which is not yet in the list.
+		if (pChunk->m_pLruPrev)
+		{
+			pChunk->m_pLruPrev->m_pLruNext = pChunk->m_pLruNext;
+		}
+		else if (stripe.pMostRecentlyUsed == pChunk)
+		{
+			stripe.pMostRecentlyUsed = pChunk->m_pLruNext;
+		}
+
+		if (pChunk->m_pLruNext)
+		{
+			pChunk->m_pLruNext->m_pLruPrev = pChunk->m_pLruPrev;
+		}
+		else if (stripe.pLeastRecentlyUsed == pChunk)
+		{
+			stripe.pLeastRecentlyUsed = pChunk->m_pLruPrev;
+		}
+
+		pChunk->m_pLruPrev = nullptr;
+		pChunk->m_pLruNext = nullptr;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::removeChunk(ChunkStripe& stripe, Chunk* pChunk, bool bReleasingMemory) const
+	{
+		const Vector3DInt32& v3dPos = pChunk->m_v3dChunkSpacePosition;
+		ChunkSlot* pSlot = findSlot(stripe, hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()), v3dPos.getX(), v3dPos.getY(), v3dPos.getZ());
+
+		pChunk->m_bEvicted.store(true, std::memory_order_relaxed);
+
+		// Otherwise the data is paged out now rather than when the chunk is destroyed. The chunk may outlive the volume (and pager) if
+		// another thread still has a reference to it, and in any case it must be paged out before it can be paged in again.
+		const bool bQueued = !bReleasingMemory && pChunk->m_bDataModified && m_bDeferPageOut.load() && queueChunkForPageOut(pSlot->pChunk);
+		if (!bQueued)
+		{
+			if (pChunk->m_bDataModified)
+			{
+				pChunk->pageOutIfModified();
+				m_uNoOfChunksPagedOut++;
+			}
+
+			// The copy is made after paging out, so it matches what the Pager now holds.
+			if (!bReleasingMemory)
+			{
+				std::vector<VoxelRun> runs;
+				pChunk->compress(runs);
+				addCompressedChunk(pChunk->m_v3dChunkSpacePosition, std::move(runs));
+			}
+		}
+
+		unlinkChunk(stripe, pChunk);
+		if (pChunk->m_pUniformData)
+		{
+			m_uNoOfUniformChunks--;
+		}
+		m_uChunkDataSizeInBytes -= pChunk->calculateSizeInBytes();
+		m_uChunkCount--;
+
+		// This may destroy the chunk, so must come last.
+		eraseSlot(stripe, pSlot);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::evictChunksIfRequired(void) const
+	{
+		// The limit is in chunks with their own unpacked data, but is compared in bytes as shared and packed chunks are much smaller.
+		evictChunks(static_cast<uint64_t>(m_uChunkCountLimit) * Chunk::calculateSizeInBytes(m_uChunkSideLength), false);
+
+		// This is called whenever chunks have been created, so it's the place to let the application know that memory use has gone up.
+		notifyMemoryEvent(MemoryEvents::UsageIncreased);
+		if (m_bThrashing.exchange(false))
+		{
+			POLYVOX_LOG_WARNING("Many of the chunks being paged in were only recently evicted, so the target memory usage is probably too low.");
+			notifyMemoryEvent(MemoryEvents::Thrashing);
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::evictChunks(uint64_t uTargetChunkSizeInBytes, bool bReleasingMemory) const
+	{
+		std::lock_guard<std::mutex> evictionLock(m_evictionMutex);
+
+		while (calculateChunkSizeInBytes() > uTargetChunkSizeInBytes)
+		{
+			// Each stripe keeps it's chunks in order of use, so the oldest chunk overall is the oldest of the ones at the end of each
+			// list. Chunks which are pinned (i.e. there are references to them apart from the one in the chunk table) are skipped, but
+			// there are only ever a few of these. We only lock one stripe at a time, so the chunk we find may be in use by the time we
+			// come to remove it, in which case we just go round again.
+			uint32_t uOldestChunkStripe = 0;
+			uint64_t uOldestChunkTimestamp = std::numeric_limits<uint64_t>::max();
+			Chunk* pOldestChunk = nullptr;
+			Vector3DInt32 v3dOldestChunkPos;
+			for (uint32_t uStripe = 0; uStripe < uNoOfChunkStripes; uStripe++)
+			{
+				ChunkStripe& stripe = m_arrayChunkStripes[uStripe];
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				for (Chunk* pChunk = stripe.pLeastRecentlyUsed; pChunk; pChunk = pChunk->m_pLruPrev)
+				{
+					const Vector3DInt32& v3dPos = pChunk->m_v3dChunkSpacePosition;
+					if (findSlot(stripe, hashChunkPosition(v3dPos.getX(), v3dPos.getY(), v3dPos.getZ()), v3dPos.getX(), v3dPos.getY(), v3dPos.getZ())->pChunk.use_count() == 1)
+					{
+						if (pChunk->m_uChunkLastAccessed.load(std::memory_order_relaxed) < uOldestChunkTimestamp)
+						{
+							uOldestChunkTimestamp = pChunk->m_uChunkLastAccessed.load(std::memory_order_relaxed);
+							uOldestChunkStripe = uStripe;
+							pOldestChunk = pChunk;
+							v3dOldestChunkPos = pChunk->m_v3dChunkSpacePosition;
+						}
+						break;
+					}
+				}
+			}
+
+			// If every chunk is pinned then we have no choice but to exceed the limit for now.
+			if (!pOldestChunk)
+			{
+				POLYVOX_LOG_WARNING("All chunks are in use, so the chunk count limit cannot be adhered to.");
+				break;
+			}
+
+			// The chunk may have been removed since we unlocked the stripe, so we look it up again rather than trusting the pointer.
+			ChunkStripe& stripe = m_arrayChunkStripes[uOldestChunkStripe];
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			ChunkSlot* pSlot = findSlot(stripe, hashChunkPosition(v3dOldestChunkPos.getX(), v3dOldestChunkPos.getY(), v3dOldestChunkPos.getZ()),
+				v3dOldestChunkPos.getX(), v3dOldestChunkPos.getY(), v3dOldestChunkPos.getZ());
+			if (pSlot && (pSlot->pChunk.get() == pOldestChunk) && (pSlot->pChunk.use_count() == 1))
+			{
+				removeChunk(stripe, pOldestChunk, bReleasingMemory);
+
+				const uint32_t uIndex = m_uNextRecentEviction.fetch_add(1, std::memory_order_relaxed) % uNoOfRecentEvictions;
+				m_arrayRecentEvictions[uIndex].store(hashChunkPosition(v3dOldestChunkPos.getX(), v3dOldestChunkPos.getY(), v3dOldestChunkPos.getZ()), std::memory_order_relaxed);
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::noteChunkCreated(uint64_t uHash) const
+	{
+		for (uint32_t ct = 0; ct < uNoOfRecentEvictions; ct++)
+		{
+			if (m_arrayRecentEvictions[ct].load(std::memory_order_relaxed) == uHash)
+			{
+				m_uNoOfRecentlyEvictedChunksCreatedInWindow.fetch_add(1, std::memory_order_relaxed);
+				break;
+			}
+		}
+
+		// At the end of each window we decide whether it was thrashing, and start again. Whichever thread completes the window does this, and
+		// the event is sent from evictChunksIfRequired() as we are probably holding a stripe lock here. Half is a lot more than normal use
+		// gives (even when revisiting an area), but still well short of what happens when the working set doesn't fit.
+		if (m_uNoOfChunksCreatedInWindow.fetch_add(1, std::memory_order_relaxed) + 1 == uThrashingWindowSize)
+		{
+			m_uNoOfChunksCreatedInWindow.store(0, std::memory_order_relaxed);
+			if (m_uNoOfRecentlyEvictedChunksCreatedInWindow.exchange(0, std::memory_order_relaxed) >= uThrashingWindowSize / 2)
+			{
+				m_bThrashing = true;
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::notifyMemoryEvent(MemoryEvent eEvent) const
+	{
+		if (m_memoryEventHandler)
+		{
+			m_memoryEventHandler(eEvent);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The handler is called from whichever thread caused the event, without any of the volume's locks held (so it may call back into the
+	/// volume, e.g. to releaseMemory()). It should be set before the volume is used, as it is not protected against being changed while
+	/// other threads are accessing voxels. If the target memory usage is already too low then the handler is told so straight away.
+	/// \param memoryEventHandler The function to call, or an empty function to stop handling the events.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setMemoryEventHandler(std::function<void(MemoryEvent)> memoryEventHandler)
+	{
+		m_memoryEventHandler = memoryEventHandler;
+
+		if (m_bChunkCountLimitTooLow)
+		{
+			notifyMemoryEvent(MemoryEvents::LimitTooLow);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// This is for when memory is short across the whole application. The compressed chunk cache is emptied first, as it's contents are
+	/// the cheapest to get back, and then the least recently used chunks are evicted (without keeping compressed copies). Modified chunks
+	/// are paged out straight away, and the pool which the chunk data came from is trimmed. Chunks which are in use can't be evicted, so less
+	/// memory may be released than was asked for. The volume will grow again (up to it's target memory usage) as more chunks are needed.
+	/// \param uBytesToRelease How much memory to try to release.
+	/// \return How much memory was actually released.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	uint64_t PagedVolume<VoxelType>::releaseMemory(uint64_t uBytesToRelease)
+	{
+		const uint64_t uInitialSizeInBytes = calculateSizeInBytes();
+
+		uint64_t uBytesReleased = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+			while (!m_listCompressedChunks.empty() && (uBytesReleased < uBytesToRelease))
+			{
+				CompressedChunk& oldest = m_listCompressedChunks.back();
+				uBytesReleased += oldest.runs.size() * sizeof(VoxelRun);
+				m_uCompressedCacheSizeInBytes -= oldest.runs.size() * sizeof(VoxelRun);
+				m_mapCompressedChunks.erase(oldest.v3dPosition);
+				m_listCompressedChunks.pop_back();
+			}
+		}
+
+		// Chunks waiting in the page out queue were evicted a while ago, so they go before the ones still in the volume.
+		if (uBytesReleased < uBytesToRelease)
+		{
+			pageOutQueuedChunks((std::numeric_limits<uint32_t>::max)());
+		}
+
+		const uint64_t uSizeInBytes = calculateSizeInBytes();
+		uBytesReleased = (uInitialSizeInBytes > uSizeInBytes) ? (uInitialSizeInBytes - uSizeInBytes) : 0;
+		if (uBytesReleased < uBytesToRelease)
+		{
+			const uint64_t uChunkSizeInBytes = calculateChunkSizeInBytes();
+			const uint64_t uBytesStillToRelease = uBytesToRelease - uBytesReleased;
+			evictChunks((uChunkSizeInBytes > uBytesStillToRelease) ? (uChunkSizeInBytes - uBytesStillToRelease) : 0, true);
+		}
+
+		// The evicted chunks' data went back to the pool, so give it to the operating system.
+		Chunk::getDataPool(m_uChunkSideLength).trim();
+
+		const uint64_t uFinalSizeInBytes = calculateSizeInBytes();
+		return (uInitialSizeInBytes > uFinalSizeInBytes) ? (uInitialSizeInBytes - uFinalSizeInBytes) : 0;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The limit is converted into a number of chunks, so it can be exceeded slightly by chunks which are pinned. This can be called at any
+	/// time (including while other threads are accessing the volume), and if the volume is now over the limit then the least recently used
+	/// chunks are evicted before returning.
+	/// \param uTargetMemoryUsageInBytes The upper limit to how much memory this PagedVolume should aim to use.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setTargetMemoryUsage(uint64_t uTargetMemoryUsageInBytes)
+	{
+		POLYVOX_THROW_IF(uTargetMemoryUsageInBytes < 1 * 1024 * 1024, std::invalid_argument, "Target memory usage is too small to be practical");
+
+		// Calculate the number of chunks based on the memory limit and the size of each chunk.
+		const uint64_t uChunkSizeInBytes = PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength);
+		const uint64_t uChunkCountLimit = uTargetMemoryUsageInBytes / uChunkSizeInBytes;
+
+		// Enforce a sensible limit on the number of chunks. There is no upper limit as the chunk table grows as required.
+		const uint64_t uMinPracticalNoOfChunks = 32; // Enough to make sure a chunks and it's neighbours can be loaded, with a few to spare.
+		m_bChunkCountLimitTooLow = (uChunkCountLimit < uMinPracticalNoOfChunks);
+		if (m_bChunkCountLimitTooLow)
+		{
+			POLYVOX_LOG_WARNING("Requested memory usage limit of ", uTargetMemoryUsageInBytes / (1024 * 1024), "Mb is too low and cannot be adhered to.");
+			notifyMemoryEvent(MemoryEvents::LimitTooLow);
+		}
+		const uint64_t uMaxNoOfChunks = (std::numeric_limits<uint32_t>::max)();
+		const uint32_t uNewChunkCountLimit = static_cast<uint32_t>((std::min)((std::max)(uChunkCountLimit, uMinPracticalNoOfChunks), uMaxNoOfChunks));
+		m_uChunkCountLimit = uNewChunkCountLimit;
+
+		// Inform the user about the chosen memory configuration.
+		POLYVOX_LOG_DEBUG("Memory usage limit for volume now set to ", (uNewChunkCountLimit * uChunkSizeInBytes) / (1024 * 1024),
+			"Mb (", uNewChunkCountLimit, " chunks of ", uChunkSizeInBytes / 1024, "Kb each).");
+
+		// If the limit was lowered we may now have too many chunks.
+		evictChunksIfRequired();
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
 	/// Calculate the memory usage of the volume.
 	////////////////////////////////////////////////////////////////////////////////
 	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::calculateSizeInBytes(void)
+	uint64_t PagedVolume<VoxelType>::calculateSizeInBytes(void)
 	{
-		uint32_t uChunkCount = 0;
-		for (uint32_t uIndex = 0; uIndex < uChunkArraySize; uIndex++)
+		uint64_t uCompressedCacheSizeInBytes = 0;
 		{
-			if (m_arrayChunks[uIndex])
+			std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+			uCompressedCacheSizeInBytes = m_uCompressedCacheSizeInBytes;
+		}
+
+		// Chunks waiting to be paged out are no longer counted by the chunk table, but still use memory.
+		const uint64_t uQueuedChunksSizeInBytes = static_cast<uint64_t>(getNoOfQueuedChunks()) * Chunk::calculateSizeInBytes(m_uChunkSideLength);
+
+		return calculateChunkSizeInBytes() + uCompressedCacheSizeInBytes + uQueuedChunksSizeInBytes;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// Evicted chunks which are kept in the compressed chunk cache can be brought back into memory without calling the Pager. The memory
+	/// used for this is separate from (and in addition to) the target memory usage. This can be called at any time, and if the cache is now
+	/// over the limit then the least recently evicted chunks are discarded before returning.
+	/// \param uCompressedCacheLimitInBytes The upper limit to how much memory the compressed chunks can use, or zero to disable the cache.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::setCompressedCacheLimit(uint64_t uCompressedCacheLimitInBytes)
+	{
+		std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+		m_uCompressedCacheLimitInBytes = uCompressedCacheLimitInBytes;
+		evictCompressedChunksIfRequired();
+
+		POLYVOX_LOG_DEBUG("Compressed chunk cache limit for volume now set to ", uCompressedCacheLimitInBytes / (1024 * 1024), "Mb.");
+	}
+
+	template <typename VoxelType>
+	uint16_t PagedVolume<VoxelType>::getChunkSideLength(void) const
+	{
+		return m_uChunkSideLength;
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::getChunkCountLimit(void) const
+	{
+		return m_uChunkCountLimit.load();
+	}
+
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::PagingStatistics PagedVolume<VoxelType>::getPagingStatistics(void) const
+	{
+		PagingStatistics statistics;
+		statistics.uNoOfHits = m_uNoOfHits.load(std::memory_order_relaxed);
+		statistics.uNoOfMisses = m_uNoOfMisses.load(std::memory_order_relaxed);
+		statistics.uNoOfPrefetchedChunks = m_uNoOfPrefetchedChunks.load(std::memory_order_relaxed);
+		statistics.uNoOfCompressedCacheHits = m_uNoOfCompressedCacheHits.load(std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_compressedCacheMutex);
+		statistics.uCompressedCacheSizeInBytes = m_uCompressedCacheSizeInBytes;
+		return statistics;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// The probe lengths are those for finding each of the chunks which are currently present. This is computed on demand (by examining
+	/// every slot) so that it adds nothing to the cost of normal lookups, but it does lock each part of the chunk table in turn.
+	////////////////////////////////////////////////////////////////////////////////
+	template <typename VoxelType>
+	typename PagedVolume<VoxelType>::ChunkTableStatistics PagedVolume<VoxelType>::getChunkTableStatistics(void) const
+	{
+		ChunkTableStatistics stats;
+		uint64_t uTotalProbeLength = 0;
+
+		for (uint32_t uStripe = 0; uStripe < uNoOfChunkStripes; uStripe++)
+		{
+			ChunkStripe& stripe = m_arrayChunkStripes[uStripe];
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+
+			const uint32_t uMask = static_cast<uint32_t>(stripe.slots.size()) - 1;
+			for (uint32_t uIndex = 0; uIndex < stripe.slots.size(); uIndex++)
 			{
-				uChunkCount++;
+				if (stripe.slots[uIndex].pChunk)
+				{
+					const uint32_t uHome = static_cast<uint32_t>(stripe.slots[uIndex].uHash) & uMask;
+					const uint32_t uProbeLength = ((uIndex - uHome) & uMask) + 1;
+					uTotalProbeLength += uProbeLength;
+					stats.uMaxProbeLength = (std::max)(stats.uMaxProbeLength, uProbeLength);
+
+					if (stripe.slots[uIndex].pChunk->m_pUniformData)
+					{
+						stats.uNoOfUniformChunks++;
+					}
+					else if (!stripe.slots[uIndex].pChunk->m_tData.load())
+					{
+						stats.uNoOfPackedChunks++;
+					}
+				}
 			}
+
+			stats.uNoOfChunks += stripe.uNoOfChunks;
+			stats.uNoOfSlots += static_cast<uint32_t>(stripe.slots.size());
+		}
+
+		if (stats.uNoOfChunks > 0)
+		{
+			stats.fAverageProbeLength = static_cast<float>(uTotalProbeLength) / static_cast<float>(stats.uNoOfChunks);
 		}
 
-		// Note: We disregard the size of the other class members as they are likely to be very small compared to the size of the
-		// allocated voxel data. This also keeps the reported size as a power of two, which makes other memory calculations easier.
-		return PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(m_uChunkSideLength) * uChunkCount;
+		return stats;
 	}
 }
 
@@ -29,9 +29,22 @@ namespace PolyVox
 {
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager)
+		:Chunk(v3dPosition, uSideLength, pPager, true)
+	{
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager, bool bPageIn)
 		:m_uChunkLastAccessed(0)
+		, m_pLruPrev(nullptr)
+		, m_pLruNext(nullptr)
+		, m_bEvicted(false)
 		, m_bDataModified(true)
+		, m_bBeingPagedIn(false)
+		, m_bPageInFailed(false)
 		, m_tData(0)
+		, m_pPackedData(nullptr)
+		, m_bUsePalette(false)
 		, m_uSideLength(0)
 		, m_uSideLengthPower(0)
 		, m_pPager(pPager)
@@ -44,9 +57,8 @@ namespace PolyVox
 		m_uSideLength = uSideLength;
 		m_uSideLengthPower = logBase2(uSideLength);
 
-		// Allocate the data
-		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
-		m_tData = new VoxelType[uNoOfVoxels];
+		// Allocate the data. If it turns out to all be the same then the PagedVolume will swap it for shared data afterwards.
+		m_tData = allocateData(m_uSideLength);
 
 		// Pass the chunk to the Pager to give it a chance to initialise it with any data
 		// From the coordinates of the chunk we deduce the coordinates of the contained voxels.
@@ -55,7 +67,7 @@ namespace PolyVox
 		Region reg(v3dLower, v3dUpper);
 
 		// A valid pager is normally present - this check is mostly to ease unit testing.
-		if (m_pPager)
+		if (m_pPager && bPageIn)
 		{
 			// Page the data in
 			m_pPager->pageIn(reg, this);
@@ -65,8 +77,70 @@ namespace PolyVox
 		m_bDataModified = false;
 	}
 
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::Chunk::Chunk(Vector3DInt32 v3dPosition, uint16_t uSideLength, Pager* pPager, const std::vector<VoxelRun>& runs, const std::shared_ptr<VoxelType>& pUniformData)
+		:m_uChunkLastAccessed(0)
+		, m_pLruPrev(nullptr)
+		, m_pLruNext(nullptr)
+		, m_bEvicted(false)
+		, m_bDataModified(false) // The runs always match what the Pager holds.
+		, m_bBeingPagedIn(false)
+		, m_bPageInFailed(false)
+		, m_tData(0)
+		, m_pPackedData(nullptr)
+		, m_bUsePalette(false)
+		, m_uSideLength(uSideLength)
+		, m_uSideLengthPower(logBase2(uSideLength))
+		, m_pPager(pPager)
+		, m_v3dChunkSpacePosition(v3dPosition)
+	{
+		if (pUniformData && (runs.size() == 1))
+		{
+			POLYVOX_ASSERT(*pUniformData == runs[0].tValue, "Shared data does not match the chunk.");
+			m_pUniformData = pUniformData;
+			m_tData = pUniformData.get();
+			return;
+		}
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		VoxelType* pData = allocateData(m_uSideLength);
+
+		uint32_t uIndex = 0;
+		for (uint32_t uRun = 0; uRun < runs.size(); uRun++)
+		{
+			std::fill(pData + uIndex, pData + uIndex + runs[uRun].uLength, runs[uRun].tValue);
+			uIndex += runs[uRun].uLength;
+		}
+
+		POLYVOX_ASSERT(uIndex == uNoOfVoxels, "Compressed chunk does not have the expected number of voxels.");
+		m_tData = pData;
+	}
+
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::Chunk::~Chunk()
+	{
+		pageOutIfModified();
+
+		// Shared data belongs to the volume. If there is no unpacked data then the packed data is in use, and otherwise it was retired.
+		if (!m_tData.load())
+		{
+			delete m_pPackedData.load();
+		}
+		else if (!m_pUniformData)
+		{
+			freeData(m_tData.load(), m_uSideLength);
+		}
+		m_tData = 0;
+		m_pPackedData = nullptr;
+
+		for (uint32_t ct = 0; ct < m_vecRetiredPackedData.size(); ct++)
+		{
+			delete m_vecRetiredPackedData[ct];
+		}
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::pageOutIfModified(void)
 	{
 		if (m_bDataModified && m_pPager)
 		{
@@ -78,14 +152,267 @@ namespace PolyVox
 			m_pPager->pageOut(Region(v3dLower, v3dUpper), this);
 		}
 
-		delete[] m_tData;
-		m_tData = 0;
+		m_bDataModified = false;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::compress(std::vector<VoxelRun>& runs) const
+	{
+		runs.clear();
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		VoxelRun run;
+		run.tValue = getVoxelAtIndex(0);
+		run.uLength = 1;
+		for (uint32_t uIndex = 1; uIndex < uNoOfVoxels; uIndex++)
+		{
+			const VoxelType tValue = getVoxelAtIndex(uIndex);
+			if (tValue == run.tValue)
+			{
+				run.uLength++;
+			}
+			else
+			{
+				runs.push_back(run);
+				run.tValue = tValue;
+				run.uLength = 1;
+			}
+		}
+		runs.push_back(run);
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::findUniformValue(VoxelType& tValue) const
+	{
+		// This is only used on newly paged in chunks, which are never packed.
+		const VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		POLYVOX_ASSERT(pData, "Chunk data is packed.");
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		for (uint32_t uIndex = 1; uIndex < uNoOfVoxels; uIndex++)
+		{
+			if (!(pData[uIndex] == pData[0]))
+			{
+				return false;
+			}
+		}
+
+		tValue = pData[0];
+		return true;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::useUniformData(const std::shared_ptr<VoxelType>& pUniformData)
+	{
+		POLYVOX_ASSERT(!m_pUniformData, "Chunk is already using shared data.");
+
+		// This is only done before the chunk is added to the volume, so no other thread can be reading the old data.
+		VoxelType* pOldData = m_tData.load();
+		m_pUniformData = pUniformData;
+		m_tData = pUniformData.get();
+		freeData(pOldData, m_uSideLength);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::makeDataUnique(void)
+	{
+		POLYVOX_ASSERT(m_pUniformData, "Chunk already has it's own data.");
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+
+		// Other threads may still be reading the shared data (through getVoxel() or a Sampler), but it stays alive as the volume holds
+		// a reference to it. They will see the new data once they next look up the chunk.
+		if (m_bUsePalette)
+		{
+			// The smallest indices are enough for the current value and the one about to be written. They all start off as zero.
+			PackedData* pPackedData = new PackedData(uNoOfVoxels, 1);
+			pPackedData->findOrAddToPalette(*m_pUniformData);
+			m_pPackedData.store(pPackedData, std::memory_order_release);
+			m_tData.store(nullptr, std::memory_order_release);
+		}
+		else
+		{
+			VoxelType* pData = allocateData(m_uSideLength);
+			std::copy(m_pUniformData.get(), m_pUniformData.get() + uNoOfVoxels, pData);
+			m_tData.store(pData, std::memory_order_release);
+		}
+		m_pUniformData = nullptr;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::packData(void)
+	{
+		POLYVOX_ASSERT(!m_pUniformData, "Shared data cannot be packed.");
+
+		const VoxelType* pData = m_tData.load();
+		POLYVOX_ASSERT(pData, "Chunk data is already packed.");
+
+		// We start with eight bit indices, and then move to smaller ones if the palette turns out to be small enough. Values are
+		// found in the palette through a hash of their bytes, though as the voxels are in Morton order most are the same as the
+		// one before. Equal values with different bytes (which would have to be padding) just get more than one palette entry.
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		PackedData* pPackedData = new PackedData(uNoOfVoxels, 8);
+
+		const uint32_t uHashTableSize = 512; // Twice the largest palette, so it never gets too full.
+		uint16_t arrayHashTable[uHashTableSize] = { 0 }; // Palette index plus one, so zero means empty.
+		uint32_t uPreviousPaletteIndex = 0;
+		for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+		{
+			if ((uIndex == 0) || !(pData[uIndex] == pPackedData->pPalette[uPreviousPaletteIndex]))
+			{
+				// FNV-1a
+				const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData + uIndex);
+				uint32_t uHash = 2166136261u;
+				for (uint32_t uByte = 0; uByte < sizeof(VoxelType); uByte++)
+				{
+					uHash = (uHash ^ pBytes[uByte]) * 16777619u;
+				}
+
+				uint32_t uSlot = uHash & (uHashTableSize - 1);
+				while (arrayHashTable[uSlot] && !(pPackedData->pPalette[arrayHashTable[uSlot] - 1] == pData[uIndex]))
+				{
+					uSlot = (uSlot + 1) & (uHashTableSize - 1);
+				}
+
+				if (!arrayHashTable[uSlot])
+				{
+					if (pPackedData->uPaletteSize == pPackedData->getPaletteCapacity())
+					{
+						// Too many different values.
+						delete pPackedData;
+						return false;
+					}
+
+					pPackedData->pPalette[pPackedData->uPaletteSize] = pData[uIndex];
+					pPackedData->uPaletteSize++;
+					arrayHashTable[uSlot] = static_cast<uint16_t>(pPackedData->uPaletteSize);
+				}
+
+				uPreviousPaletteIndex = arrayHashTable[uSlot] - 1;
+			}
+
+			pPackedData->pIndices[uIndex] = static_cast<uint8_t>(uPreviousPaletteIndex);
+		}
+
+		const uint8_t uBitsPerIndex = PackedData::getBitsPerIndex(pPackedData->uPaletteSize);
+		if (uBitsPerIndex < pPackedData->uBitsPerIndex)
+		{
+			PackedData* pSmallerPackedData = new PackedData(uNoOfVoxels, uBitsPerIndex);
+			std::copy(pPackedData->pPalette, pPackedData->pPalette + pPackedData->uPaletteSize, pSmallerPackedData->pPalette);
+			pSmallerPackedData->uPaletteSize = pPackedData->uPaletteSize;
+			for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+			{
+				pSmallerPackedData->setPaletteIndex(uIndex, pPackedData->pIndices[uIndex]);
+			}
+			delete pPackedData;
+			pPackedData = pSmallerPackedData;
+		}
+
+		// Small voxel types may not gain anything.
+		if (pPackedData->calculateSizeInBytes() >= getDataSizeInBytes())
+		{
+			delete pPackedData;
+			return false;
+		}
+
+		m_pPackedData = pPackedData;
+		m_tData = nullptr;
+		freeData(const_cast<VoxelType*>(pData), m_uSideLength);
+		return true;
+	}
+
+	template <typename VoxelType>
+	bool PagedVolume<VoxelType>::Chunk::growPackedData(void)
+	{
+		PackedData* pPackedData = m_pPackedData.load();
+		POLYVOX_ASSERT(pPackedData && !m_tData.load(), "Chunk data is not packed.");
+
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		if (pPackedData->uBitsPerIndex < 8)
+		{
+			PackedData* pLargerPackedData = new PackedData(uNoOfVoxels, pPackedData->uBitsPerIndex * 2);
+			std::copy(pPackedData->pPalette, pPackedData->pPalette + pPackedData->uPaletteSize, pLargerPackedData->pPalette);
+			pLargerPackedData->uPaletteSize = pPackedData->uPaletteSize;
+			for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+			{
+				pLargerPackedData->setPaletteIndex(uIndex, pPackedData->getPaletteIndex(uIndex));
+			}
+
+			m_pPackedData.store(pLargerPackedData, std::memory_order_release);
+			retirePackedData(pPackedData);
+			return true;
+		}
+
+		// The palette can't get any bigger, so we go back to unpacked data. This is set before the packed data is retired, so any
+		// reader which has not yet seen it still finds valid packed data (which is left in place, as it may be about to be read).
+		VoxelType* pData = allocateData(m_uSideLength);
+		for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+		{
+			pData[uIndex] = pPackedData->getVoxel(uIndex);
+		}
+
+		m_tData.store(pData, std::memory_order_release);
+		retirePackedData(pPackedData);
+		return false;
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::retirePackedData(PackedData* pPackedData)
+	{
+		m_vecRetiredPackedData.push_back(pPackedData);
+	}
+
+	template <typename VoxelType>
+	MemoryPool& PagedVolume<VoxelType>::Chunk::getDataPool(uint16_t uSideLength)
+	{
+		return MemoryPool::get(calculateSizeInBytes(uSideLength));
+	}
+
+	template <typename VoxelType>
+	VoxelType* PagedVolume<VoxelType>::Chunk::allocateData(uint16_t uSideLength)
+	{
+		return getDataPool(uSideLength).template newArray<VoxelType>(uSideLength * uSideLength * uSideLength);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::freeData(VoxelType* pData, uint16_t uSideLength)
+	{
+		getDataPool(uSideLength).deleteArray(pData, uSideLength * uSideLength * uSideLength);
 	}
 
 	template <typename VoxelType>
 	VoxelType* PagedVolume<VoxelType>::Chunk::getData(void) const
 	{
-		return m_tData;
+		return m_tData.load(std::memory_order_acquire);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::copyData(VoxelType* pDest) const
+	{
+		const uint32_t uNoOfVoxels = m_uSideLength * m_uSideLength * m_uSideLength;
+		const VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (pData)
+		{
+			std::copy(pData, pData + uNoOfVoxels, pDest);
+		}
+		else
+		{
+			const PackedData* pPackedData = m_pPackedData.load(std::memory_order_acquire);
+			for (uint32_t uIndex = 0; uIndex < uNoOfVoxels; uIndex++)
+			{
+				pDest[uIndex] = pPackedData->getVoxel(uIndex);
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::Chunk::getVoxelAtIndex(uint32_t uIndex) const
+	{
+		const VoxelType* pData = m_tData.load(std::memory_order_acquire);
+		if (pData)
+		{
+			return pData[uIndex];
+		}
+		return m_pPackedData.load(std::memory_order_acquire)->getVoxel(uIndex);
 	}
 
 	template <typename VoxelType>
@@ -102,11 +429,10 @@ namespace PolyVox
 		POLYVOX_ASSERT(uXPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uYPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uZPos < m_uSideLength, "Supplied position is outside of the chunk");
-		POLYVOX_ASSERT(m_tData, "No uncompressed data - chunk must be decompressed before accessing voxels.");
 
 		uint32_t index = morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
 
-		return m_tData[index];
+		return getVoxelAtIndex(index);
 	}
 
 	template <typename VoxelType>
@@ -123,11 +449,40 @@ namespace PolyVox
 		POLYVOX_ASSERT(uXPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uYPos < m_uSideLength, "Supplied position is outside of the chunk");
 		POLYVOX_ASSERT(uZPos < m_uSideLength, "Supplied position is outside of the chunk");
-		POLYVOX_ASSERT(m_tData, "No uncompressed data - chunk must be decompressed before accessing voxels.");
 
 		uint32_t index = morton256_x[uXPos] | morton256_y[uYPos] | morton256_z[uZPos];
 
-		m_tData[index] = tValue;
+		// The shared data must not be changed, so writing a different value means the chunk needs it's own copy.
+		if (m_pUniformData)
+		{
+			if (tValue == *m_pUniformData)
+			{
+				return;
+			}
+
+			makeDataUnique();
+		}
+
+		// A new value may need room in the palette, and if there isn't any then the chunk goes back to unpacked data.
+		if (!m_tData.load(std::memory_order_relaxed))
+		{
+			PackedData* pPackedData = m_pPackedData.load(std::memory_order_relaxed);
+			uint32_t uPaletteIndex = pPackedData->findOrAddToPalette(tValue);
+			if ((uPaletteIndex == pPackedData->getPaletteCapacity()) && growPackedData())
+			{
+				pPackedData = m_pPackedData.load(std::memory_order_relaxed);
+				uPaletteIndex = pPackedData->findOrAddToPalette(tValue);
+			}
+
+			if (!m_tData.load(std::memory_order_relaxed))
+			{
+				pPackedData->setPaletteIndex(index, uPaletteIndex);
+				this->m_bDataModified = true;
+				return;
+			}
+		}
+
+		m_tData.load(std::memory_order_relaxed)[index] = tValue;
 
 		this->m_bDataModified = true;
 	}
@@ -139,10 +494,23 @@ namespace PolyVox
 	}
 
 	template <typename VoxelType>
-	uint32_t PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(void)
+	uint32_t PagedVolume<VoxelType>::Chunk::calculateSizeInBytes(void) const
 	{
-		// Call through to the static version
-		return calculateSizeInBytes(m_uSideLength);
+		uint32_t uSizeInBytes = 0;
+		if (!m_tData.load())
+		{
+			uSizeInBytes = m_pPackedData.load()->calculateSizeInBytes();
+		}
+		else if (!m_pUniformData)
+		{
+			uSizeInBytes = calculateSizeInBytes(m_uSideLength);
+		}
+
+		for (uint32_t ct = 0; ct < m_vecRetiredPackedData.size(); ct++)
+		{
+			uSizeInBytes += m_vecRetiredPackedData[ct]->calculateSizeInBytes();
+		}
+		return uSizeInBytes;
 	}
 
 	template <typename VoxelType>
@@ -161,7 +529,15 @@ namespace PolyVox
 	template <typename VoxelType>
 	void PagedVolume<VoxelType>::Chunk::changeLinearOrderingToMorton(void)
 	{
-		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
+		// Shared data is all one value, so the ordering makes no difference (and it must not be written to anyway).
+		if (m_pUniformData)
+		{
+			return;
+		}
+		POLYVOX_ASSERT(m_tData.load(), "Chunk data is packed, which is always in Morton order.");
+
+		VoxelType* pData = m_tData.load();
+		VoxelType* pTempBuffer = allocateData(m_uSideLength);
 
 		// We should prehaps restructure this loop. From: https://fgiesen.wordpress.com/2011/01/17/texture-tiling-and-swizzling/
 		//
@@ -181,14 +557,57 @@ namespace PolyVox
 				{
 					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
 					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uMortonIndex] = m_tData[uLinearIndex];
+					pTempBuffer[uMortonIndex] = pData[uLinearIndex];
 				}
 			}
 		}
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		std::memcpy(pData, pTempBuffer, getDataSizeInBytes());
+
+		freeData(pTempBuffer, m_uSideLength);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::Chunk::setDataFromLinearOrder(const VoxelType* pLinearData)
+	{
+		POLYVOX_ASSERT(!m_pUniformData, "Shared data must not be written to.");
+		POLYVOX_ASSERT(m_tData.load(), "Chunk data is packed, so it can't be written to directly.");
+
+		VoxelType* pData = m_tData.load();
 
-		delete[] pTempBuffer;
+		// A chunk of one voxel is the same in both orders (and doesn't have the 2x2x2 cells used below).
+		if (m_uSideLength == 1)
+		{
+			pData[0] = pLinearData[0];
+			return;
+		}
+
+		// Rather than scattering each voxel (as in changeLinearOrderingToMorton()) we work through the chunk in 2x2x2 cells. Each cell is
+		// eight consecutive voxels in Morton order, and is made of four pairs of consecutive voxels in linear order. So both the reads and
+		// writes are (mostly) sequential, and we only need to look up one Morton index per cell. This is several times faster.
+		const uint32_t uRowLength = m_uSideLength;
+		const uint32_t uSliceLength = m_uSideLength * m_uSideLength;
+		for (uint16_t z = 0; z < m_uSideLength; z += 2)
+		{
+			for (uint16_t y = 0; y < m_uSideLength; y += 2)
+			{
+				const uint32_t uMortonYZ = morton256_y[y] | morton256_z[z];
+				const VoxelType* pRow = pLinearData + z * uSliceLength + y * uRowLength;
+				for (uint16_t x = 0; x < m_uSideLength; x += 2)
+				{
+					VoxelType* pCell = pData + (morton256_x[x] | uMortonYZ);
+					const VoxelType* pSource = pRow + x;
+					pCell[0] = pSource[0];
+					pCell[1] = pSource[1];
+					pCell[2] = pSource[uRowLength];
+					pCell[3] = pSource[uRowLength + 1];
+					pCell[4] = pSource[uSliceLength];
+					pCell[5] = pSource[uSliceLength + 1];
+					pCell[6] = pSource[uSliceLength + uRowLength];
+					pCell[7] = pSource[uSliceLength + uRowLength + 1];
+				}
+			}
+		}
 	}
 
 	// Like the above function, this is provided fot easing backwards compatibility. In Cubiquity we have some
@@ -196,7 +615,15 @@ namespace PolyVox
 	template <typename VoxelType>
 	void PagedVolume<VoxelType>::Chunk::changeMortonOrderingToLinear(void)
 	{
-		VoxelType* pTempBuffer = new VoxelType[m_uSideLength * m_uSideLength * m_uSideLength];
+		// Shared data is all one value, so the ordering makes no difference (and it must not be written to anyway).
+		if (m_pUniformData)
+		{
+			return;
+		}
+		POLYVOX_ASSERT(m_tData.load(), "Chunk data is packed, which is always in Morton order.");
+
+		VoxelType* pData = m_tData.load();
+		VoxelType* pTempBuffer = allocateData(m_uSideLength);
 		for (uint16_t z = 0; z < m_uSideLength; z++)
 		{
 			for (uint16_t y = 0; y < m_uSideLength; y++)
@@ -205,13 +632,110 @@ namespace PolyVox
 				{
 					uint32_t uLinearIndex = x + y * m_uSideLength + z * m_uSideLength * m_uSideLength;
 					uint32_t uMortonIndex = morton256_x[x] | morton256_y[y] | morton256_z[z];
-					pTempBuffer[uLinearIndex] = m_tData[uMortonIndex];
+					pTempBuffer[uLinearIndex] = pData[uMortonIndex];
 				}
 			}
 		}
 
-		std::memcpy(m_tData, pTempBuffer, getDataSizeInBytes());
+		std::memcpy(pData, pTempBuffer, getDataSizeInBytes());
 
-		delete[] pTempBuffer;
+		freeData(pTempBuffer, m_uSideLength);
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::PackedData::PackedData(uint32_t uNoOfVoxels, uint8_t uBitsPerIndex)
+		:uNoOfVoxels(uNoOfVoxels)
+		, uBitsPerIndex(uBitsPerIndex)
+		, uPaletteSize(0)
+		, pPalette(nullptr)
+		, pIndices(nullptr)
+	{
+		POLYVOX_ASSERT((uBitsPerIndex == 1) || (uBitsPerIndex == 2) || (uBitsPerIndex == 4) || (uBitsPerIndex == 8), "Unsupported index size.");
+
+		// The indices come from the pools like unpacked data, as they are just as often allocated and freed. Most chunks have
+		// few enough voxels for whole bytes, but we still make sure of it. The indices start off all referring to the first value.
+		const uint32_t uIndicesSizeInBytes = (uNoOfVoxels * uBitsPerIndex + 7) / 8;
+		pIndices = MemoryPool::get(uIndicesSizeInBytes).template newArray<uint8_t>(uIndicesSizeInBytes);
+		std::fill(pIndices, pIndices + uIndicesSizeInBytes, 0);
+
+		pPalette = new VoxelType[getPaletteCapacity()];
+	}
+
+	template <typename VoxelType>
+	PagedVolume<VoxelType>::PackedData::~PackedData()
+	{
+		const uint32_t uIndicesSizeInBytes = (uNoOfVoxels * uBitsPerIndex + 7) / 8;
+		MemoryPool::get(uIndicesSizeInBytes).deleteArray(pIndices, uIndicesSizeInBytes);
+		delete[] pPalette;
+	}
+
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::PackedData::getVoxel(uint32_t uIndex) const
+	{
+		return pPalette[getPaletteIndex(uIndex)];
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::PackedData::getPaletteIndex(uint32_t uIndex) const
+	{
+		// The indices are packed into bytes starting with the lowest bits.
+		const uint32_t uBit = uIndex * uBitsPerIndex;
+		return (pIndices[uBit >> 3] >> (uBit & 7)) & ((1 << uBitsPerIndex) - 1);
+	}
+
+	template <typename VoxelType>
+	void PagedVolume<VoxelType>::PackedData::setPaletteIndex(uint32_t uIndex, uint32_t uPaletteIndex)
+	{
+		POLYVOX_ASSERT(uPaletteIndex < uPaletteSize, "Palette index is out of range.");
+
+		const uint32_t uBit = uIndex * uBitsPerIndex;
+		const uint32_t uMask = ((1 << uBitsPerIndex) - 1) << (uBit & 7);
+		uint8_t& uByte = pIndices[uBit >> 3];
+		uByte = static_cast<uint8_t>((uByte & ~uMask) | ((uPaletteIndex << (uBit & 7)) & uMask));
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::PackedData::findOrAddToPalette(const VoxelType& tValue)
+	{
+		// The palette is small, and this is only used when writing voxels.
+		for (uint32_t uPaletteIndex = 0; uPaletteIndex < uPaletteSize; uPaletteIndex++)
+		{
+			if (pPalette[uPaletteIndex] == tValue)
+			{
+				return uPaletteIndex;
+			}
+		}
+
+		if (uPaletteSize == getPaletteCapacity())
+		{
+			return uPaletteSize;
+		}
+
+		// Other threads don't read the new entry until an index refers to it, which is only set afterwards.
+		pPalette[uPaletteSize] = tValue;
+		return uPaletteSize++;
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::PackedData::getPaletteCapacity(void) const
+	{
+		return 1 << uBitsPerIndex;
+	}
+
+	template <typename VoxelType>
+	uint32_t PagedVolume<VoxelType>::PackedData::calculateSizeInBytes(void) const
+	{
+		return (uNoOfVoxels * uBitsPerIndex + 7) / 8 + getPaletteCapacity() * sizeof(VoxelType) + sizeof(PackedData);
+	}
+
+	template <typename VoxelType>
+	uint8_t PagedVolume<VoxelType>::PackedData::getBitsPerIndex(uint32_t uPaletteSize)
+	{
+		uint8_t uBitsPerIndex = 1;
+		while ((1u << uBitsPerIndex) < uPaletteSize)
+		{
+			uBitsPerIndex *= 2;
+		}
+		return uBitsPerIndex;
 	}
 }
@@ -48,7 +48,11 @@ namespace PolyVox
 
 	template <typename VoxelType>
 	PagedVolume<VoxelType>::Sampler::Sampler(PagedVolume<VoxelType>* volume)
-		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(volume), m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
+		:BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >(volume)
+		, mCurrentData(nullptr)
+		, mCurrentPackedData(nullptr)
+		, mCurrentVoxelIndex(0)
+		, m_uChunkSideLengthMinusOne(volume->m_uChunkSideLength - 1)
 	{
 	}
 
@@ -60,7 +64,17 @@ namespace PolyVox
 	template <typename VoxelType>
 	VoxelType PagedVolume<VoxelType>::Sampler::getVoxel(void) const
 	{
-		return *mCurrentVoxel;
+		return getVoxelAtIndex(mCurrentVoxelIndex);
+	}
+
+	template <typename VoxelType>
+	VoxelType PagedVolume<VoxelType>::Sampler::getVoxelAtIndex(uint32_t uIndex) const
+	{
+		if (mCurrentData)
+		{
+			return mCurrentData[uIndex];
+		}
+		return mCurrentPackedData->getVoxel(uIndex);
 	}
 
 	template <typename VoxelType>
@@ -75,7 +89,7 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::setPosition(xPos, yPos, zPos);
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		const int32_t uXChunk = this->mXPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
 		const int32_t uYChunk = this->mYPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
 		const int32_t uZChunk = this->mZPosInVolume >> this->mVolume->m_uChunkSideLengthPower;
@@ -86,10 +100,23 @@ namespace PolyVox
 
 		uint32_t uVoxelIndexInChunk = morton256_x[m_uXPosInChunk] | morton256_y[m_uYPosInChunk] | morton256_z[m_uZPosInChunk];
 
-		auto pCurrentChunk = this->mVolume->canReuseLastAccessedChunk(uXChunk, uYChunk, uZChunk) ?
-			this->mVolume->m_pLastAccessedChunk : this->mVolume->getChunk(uXChunk, uYChunk, uZChunk);
+		// Peeking outside the current chunk changes the volume's record of the last accessed chunk, so we check our own first.
+		const bool bCanReuseCurrentChunk = m_pCurrentChunk &&
+			(m_pCurrentChunk->m_v3dChunkSpacePosition.getX() == uXChunk) &&
+			(m_pCurrentChunk->m_v3dChunkSpacePosition.getY() == uYChunk) &&
+			(m_pCurrentChunk->m_v3dChunkSpacePosition.getZ() == uZChunk) &&
+			(!m_pCurrentChunk->m_bEvicted.load(std::memory_order_relaxed));
+
+		if (!bCanReuseCurrentChunk)
+		{
+			// Copying the pointer pins the chunk for as long as we are using it.
+			m_pCurrentChunk = this->mVolume->getChunk(uXChunk, uYChunk, uZChunk);
+		}
 
-		mCurrentVoxel = pCurrentChunk->m_tData + uVoxelIndexInChunk;
+		// The unpacked data is checked first, as a chunk which is being unpacked by another thread still has valid packed data.
+		mCurrentData = m_pCurrentChunk->m_tData.load(std::memory_order_acquire);
+		mCurrentPackedData = mCurrentData ? nullptr : m_pCurrentChunk->m_pPackedData.load(std::memory_order_acquire);
+		mCurrentVoxelIndex = uVoxelIndexInChunk;
 	}
 
 	template <typename VoxelType>
@@ -106,11 +133,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveX();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_POS_X(this->m_uXPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += POS_X_DELTA;
+			mCurrentVoxelIndex += POS_X_DELTA;
 			this->m_uXPosInChunk++;
 		}
 		else
@@ -126,11 +153,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveY();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += POS_Y_DELTA;
+			mCurrentVoxelIndex += POS_Y_DELTA;
 			this->m_uYPosInChunk++;
 		}
 		else
@@ -146,11 +173,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::movePositiveZ();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += POS_Z_DELTA;
+			mCurrentVoxelIndex += POS_Z_DELTA;
 			this->m_uZPosInChunk++;
 		}
 		else
@@ -166,11 +193,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeX();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += NEG_X_DELTA;
+			mCurrentVoxelIndex += NEG_X_DELTA;
 			this->m_uXPosInChunk--;
 		}
 		else
@@ -186,11 +213,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeY();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += NEG_Y_DELTA;
+			mCurrentVoxelIndex += NEG_Y_DELTA;
 			this->m_uYPosInChunk--;
 		}
 		else
@@ -206,11 +233,11 @@ namespace PolyVox
 		// Base version updates position and validity flags.
 		BaseVolume<VoxelType>::template Sampler< PagedVolume<VoxelType> >::moveNegativeZ();
 
-		// Then we update the voxel pointer
+		// Then we update the voxel index
 		if (CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
 			//No need to compute new chunk.
-			mCurrentVoxel += NEG_Z_DELTA;
+			mCurrentVoxelIndex += NEG_Z_DELTA;
 			this->m_uZPosInChunk--;
 		}
 		else
@@ -225,7 +252,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
 	}
@@ -235,7 +262,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + NEG_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume);
 	}
@@ -245,7 +272,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
 	}
@@ -255,7 +282,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume - 1);
 	}
@@ -265,7 +292,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume);
 	}
@@ -275,7 +302,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume, this->mZPosInVolume + 1);
 	}
@@ -285,7 +312,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
 	}
@@ -295,7 +322,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + POS_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume);
 	}
@@ -305,7 +332,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume - 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
 	}
@@ -317,7 +344,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
 	}
@@ -327,7 +354,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume);
 	}
@@ -337,7 +364,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
 	}
@@ -347,7 +374,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume - 1);
 	}
@@ -355,7 +382,7 @@ namespace PolyVox
 	template <typename VoxelType>
 	VoxelType PagedVolume<VoxelType>::Sampler::peekVoxel0px0py0pz(void) const
 	{
-		return *mCurrentVoxel;
+		return getVoxelAtIndex(mCurrentVoxelIndex);
 	}
 
 	template <typename VoxelType>
@@ -363,7 +390,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume, this->mZPosInVolume + 1);
 	}
@@ -373,7 +400,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
 	}
@@ -383,7 +410,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume);
 	}
@@ -393,7 +420,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
 	}
@@ -405,7 +432,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + NEG_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume - 1);
 	}
@@ -415,7 +442,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + NEG_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume);
 	}
@@ -425,7 +452,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + NEG_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume - 1, this->mZPosInVolume + 1);
 	}
@@ -435,7 +462,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume - 1);
 	}
@@ -445,7 +472,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume);
 	}
@@ -455,7 +482,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume, this->mZPosInVolume + 1);
 	}
@@ -465,7 +492,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_NEG_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + POS_Y_DELTA + NEG_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume - 1);
 	}
@@ -475,7 +502,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + POS_Y_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume);
 	}
@@ -485,7 +512,7 @@ namespace PolyVox
 	{
 		if (CAN_GO_POS_X(this->m_uXPosInChunk) && CAN_GO_POS_Y(this->m_uYPosInChunk) && CAN_GO_POS_Z(this->m_uZPosInChunk))
 		{
-			return *(mCurrentVoxel + POS_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
+			return getVoxelAtIndex(mCurrentVoxelIndex + POS_X_DELTA + POS_Y_DELTA + POS_Z_DELTA);
 		}
 		return this->mVolume->getVoxel(this->mXPosInVolume + 1, this->mYPosInVolume + 1, this->mZPosInVolume + 1);
 	}
@@ -29,6 +29,8 @@
 #include "Region.h"
 #include "Vector.h"
 
+#include "Impl/MemoryPool.h"
+
 #include <cstdlib> //For abort()
 #include <limits>
 #include <memory>
@@ -175,6 +177,9 @@ namespace PolyVox
 
 		//The voxel data
 		VoxelType* m_pData;
+
+		// Where the voxel data came from, or null if it is too large to be pooled and was allocated with new[].
+		MemoryPool* m_pDataPool;
 	};
 }
 
@@ -33,6 +33,8 @@ namespace PolyVox
 		:BaseVolume<VoxelType>()
 		, m_regValidRegion(regValid)
 		, m_tBorderValue()
+		, m_pData(0)
+		, m_pDataPool(0)
 	{
 			this->setBorderValue(VoxelType());
 
@@ -59,7 +61,14 @@ namespace PolyVox
 	template <typename VoxelType>
 	RawVolume<VoxelType>::~RawVolume()
 	{
-		delete[] m_pData;
+		if (m_pDataPool)
+		{
+			m_pDataPool->deleteArray(m_pData, this->getWidth() * this->getHeight() * this->getDepth());
+		}
+		else
+		{
+			delete[] m_pData;
+		}
 		m_pData = 0;
 	}
 
@@ -236,11 +245,21 @@ namespace PolyVox
 			POLYVOX_THROW(std::invalid_argument, "Volume depth must be greater than zero.");
 		}
 
-		//Create the data
-		m_pData = new VoxelType[this->getWidth() * this->getHeight()* this->getDepth()];
+		//Create the data. Raw volumes are often short lived (e.g. the copies of voxel data made for surface extraction) and the same
+		//sizes come up again and again, so smaller ones are allocated from a pool.
+		const uint32_t uNoOfVoxels = this->getWidth() * this->getHeight()* this->getDepth();
+		m_pDataPool = MemoryPool::getForArray(uNoOfVoxels * sizeof(VoxelType));
+		if (m_pDataPool)
+		{
+			m_pData = m_pDataPool->template newArray<VoxelType>(uNoOfVoxels);
+		}
+		else
+		{
+			m_pData = new VoxelType[uNoOfVoxels];
+		}
 
 		// Clear to zeros
-		std::fill(m_pData, m_pData + this->getWidth() * this->getHeight()* this->getDepth(), VoxelType());
+		std::fill(m_pData, m_pData + uNoOfVoxels, VoxelType());
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
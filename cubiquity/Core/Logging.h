@@ -30,6 +30,7 @@
 #include <ctime>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
 
 // Used for getting the path to the user's home folder.
 #ifdef __APPLE__
@@ -111,6 +112,9 @@ namespace Cubiquity
 	private:
 		void logToFile(const std::string& type, const std::string& message)
 		{
+			// Messages can now come from the background threads as well as the main thread.
+			std::lock_guard<std::mutex> lock(mLogMutex);
+
 			time_t t = time(0); // get time now
 			struct tm * now = localtime( & t );
 
@@ -124,6 +128,7 @@ namespace Cubiquity
 
 		std::ofstream mLogFile;
 		std::string mLogFilePath;
+		std::mutex mLogMutex;
 	};
 }
 
@@ -54,7 +54,7 @@ namespace Cubiquity
 		{
 			Task* task = mPendingTasks.front();
 			mPendingTasks.pop_front();
-			task->process();
+			processTask(task);
 		}
 	}
 
@@ -64,7 +64,24 @@ namespace Cubiquity
 		{
 			Task* task = mPendingTasks.front();
 			mPendingTasks.pop_front();
-			task->process();
+			processTask(task);
 		}
 	}
+
+	void MainThreadTaskProcessor::processTask(Task* task)
+	{
+		// On the main thread there is no benefit in interleaving the stages of different tasks. Exceptions are passed on to
+		// the caller (unlike on the background threads), but the task has already left the queue so we must hand it over first.
+		try
+		{
+			while(task->process()) {}
+		}
+		catch(...)
+		{
+			task->onFailed();
+			throw;
+		}
+
+		task->onFinished();
+	}
 }
\ No newline at end of file
@@ -28,6 +28,7 @@
 #include "TaskProcessor.h"
 
 #include <list>
+#include <vector>
 
 namespace Cubiquity
 {
@@ -43,9 +44,35 @@ namespace Cubiquity
 		virtual void processOneTask(void)/* = 0*/;
 		virtual void processAllTasks(void)/* = 0*/;
 
+		// Removes the tasks for which 'func' returns true without processing them, and hands them back
+		// through 'cancelledTasks' (they are not deleted). Used when the owner of the tasks goes away.
+		template<typename Func>
+		void cancelTasks(Func func, std::vector<Task*>& cancelledTasks);
+
 		std::list<Task*> mPendingTasks;
+
+	private:
+		void processTask(Task* task);
 	};
 
+	template<typename Func>
+	void MainThreadTaskProcessor::cancelTasks(Func func, std::vector<Task*>& cancelledTasks)
+	{
+		std::list<Task*>::iterator taskIter = mPendingTasks.begin();
+		while(taskIter != mPendingTasks.end())
+		{
+			if(func(*taskIter))
+			{
+				cancelledTasks.push_back(*taskIter);
+				taskIter = mPendingTasks.erase(taskIter);
+			}
+			else
+			{
+				taskIter++;
+			}
+		}
+	}
+
 	extern MainThreadTaskProcessor gMainThreadTaskProcessor;
 }
 
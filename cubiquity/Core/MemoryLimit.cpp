@@ -0,0 +1,179 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#include "MemoryLimit.h"
+
+#include "PolyVox/Impl/ErrorHandling.h"
+#include "PolyVox/Impl/MemoryPool.h"
+
+#include <algorithm>
+
+namespace Cubiquity
+{
+	MemoryLimit gMemoryLimit; //Our global instance
+
+	MemoryLimit::MemoryLimit()
+		:mNextConsumerId(1)
+		,mLimitInBytes(0)
+	{
+	}
+
+	uint32_t MemoryLimit::addVolume(UsageFunction usageFunction, ReleaseFunction releaseFunction)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		Consumer consumer;
+		consumer.id = mNextConsumerId++;
+		consumer.usageFunction = usageFunction;
+		consumer.releaseFunction = releaseFunction;
+		mConsumers.push_back(consumer);
+		return consumer.id;
+	}
+
+	void MemoryLimit::removeVolume(uint32_t volumeId)
+	{
+		// Once we have the lock no enforcement can be in progress, and none will use this volume again.
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		for (uint32_t ct = 0; ct < mConsumers.size(); ct++)
+		{
+			if (mConsumers[ct].id == volumeId)
+			{
+				mConsumers.erase(mConsumers.begin() + ct);
+				return;
+			}
+		}
+
+		POLYVOX_LOG_WARNING("Attempted to remove a volume which is not known to the memory limit");
+	}
+
+	void MemoryLimit::setLimit(uint64_t limitInBytes)
+	{
+		mLimitInBytes = limitInBytes;
+		enforceLimit();
+	}
+
+	uint64_t MemoryLimit::getUsage(void)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return calculateUsage();
+	}
+
+	void MemoryLimit::setPressureCallback(PressureCallback pressureCallback)
+	{
+		std::lock_guard<std::mutex> lock(mPressureCallbackMutex);
+		mPressureCallback = pressureCallback;
+	}
+
+	void MemoryLimit::enforceLimit(void)
+	{
+		// This is called every time a volume pages in chunks, so we want to return quickly if there is no limit.
+		const uint64_t limitInBytes = mLimitInBytes.load();
+		if (limitInBytes == 0)
+		{
+			return;
+		}
+
+		uint64_t usageInBytes = 0;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			usageInBytes = calculateUsage();
+			if (usageInBytes <= limitInBytes)
+			{
+				return;
+			}
+
+			// We go a little under the limit, as otherwise every chunk which is paged in would push us over it again.
+			const uint64_t slackInBytes = limitInBytes / 16;
+			const uint64_t releasedInBytes = releaseMemoryFromConsumers(usageInBytes - limitInBytes + slackInBytes);
+			usageInBytes = (usageInBytes > releasedInBytes) ? (usageInBytes - releasedInBytes) : 0;
+		}
+
+		// Being over the limit is normal (it's how we know to release memory), but not being able to get back under it is a problem. This
+		// happens if so many chunks are in use (e.g. by surface extraction) that they can't be evicted.
+		if (usageInBytes > limitInBytes)
+		{
+			POLYVOX_LOG_WARNING("Memory usage of ", usageInBytes / (1024 * 1024), "Mb could not be brought under the limit of ", limitInBytes / (1024 * 1024), "Mb");
+			reportPressure(MemoryPressures::LimitExceeded);
+		}
+	}
+
+	uint64_t MemoryLimit::releaseMemory(uint64_t bytesToRelease)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return releaseMemoryFromConsumers(bytesToRelease);
+	}
+
+	void MemoryLimit::reportPressure(MemoryPressure pressure)
+	{
+		PressureCallback pressureCallback;
+		{
+			std::lock_guard<std::mutex> lock(mPressureCallbackMutex);
+			pressureCallback = mPressureCallback;
+		}
+
+		if (pressureCallback)
+		{
+			pressureCallback(pressure, getUsage(), mLimitInBytes.load());
+		}
+	}
+
+	uint64_t MemoryLimit::calculateUsage(void)
+	{
+		// The copies of voxel data made for surface extraction don't belong to any volume, but they are still memory we are using.
+		uint64_t usageInBytes = ::PolyVox::MemoryPool::getNoOfBytesReservedForArrays();
+		for (uint32_t ct = 0; ct < mConsumers.size(); ct++)
+		{
+			usageInBytes += mConsumers[ct].usageFunction();
+		}
+		return usageInBytes;
+	}
+
+	uint64_t MemoryLimit::releaseMemoryFromConsumers(uint64_t bytesToRelease)
+	{
+		// Memory which the pools are holding on to but not using is the cheapest to give back, so that goes first. Only the array pools
+		// count towards what was asked for though, as the free chunk data blocks were never part of the usage. Other threads may be
+		// allocating at the same time, so the array pools could even have grown.
+		const uint64_t arrayBytesBeforeTrim = ::PolyVox::MemoryPool::getNoOfBytesReservedForArrays();
+		::PolyVox::MemoryPool::trimAll();
+		const uint64_t arrayBytesAfterTrim = ::PolyVox::MemoryPool::getNoOfBytesReservedForArrays();
+		uint64_t releasedInBytes = (arrayBytesBeforeTrim > arrayBytesAfterTrim) ? (arrayBytesBeforeTrim - arrayBytesAfterTrim) : 0;
+
+		// The biggest volumes give memory back first. Most of the time the first one can release all we need.
+		std::vector< std::pair<uint64_t, uint32_t> > consumersBySize;
+		for (uint32_t ct = 0; ct < mConsumers.size(); ct++)
+		{
+			consumersBySize.push_back(std::make_pair(mConsumers[ct].usageFunction(), ct));
+		}
+		std::sort(consumersBySize.begin(), consumersBySize.end(), std::greater< std::pair<uint64_t, uint32_t> >());
+
+		for (uint32_t ct = 0; (ct < consumersBySize.size()) && (releasedInBytes < bytesToRelease); ct++)
+		{
+			releasedInBytes += mConsumers[consumersBySize[ct].second].releaseFunction(bytesToRelease - releasedInBytes);
+		}
+		return releasedInBytes;
+	}
+}
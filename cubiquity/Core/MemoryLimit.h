@@ -0,0 +1,120 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CUBIQUITY_MEMORYLIMIT_H_
+#define CUBIQUITY_MEMORYLIMIT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Cubiquity
+{
+	class MemoryLimit;
+
+	// Shared by all the volumes in the process.
+	extern MemoryLimit gMemoryLimit;
+
+	namespace MemoryPressures
+	{
+		// The values match the CU_MEMORY_* constants in the C interface.
+		enum MemoryPressure
+		{
+			LimitExceeded = 1, // The volumes could not release enough memory to get back under the process-wide limit.
+			BudgetTooLow = 2, // A volume's memory budget is too low to work with, so it is using more than that.
+			PrefetchTooLarge = 3, // A volume was asked to prefetch more voxel data than fits within it's budget.
+			Thrashing = 4 // A volume keeps paging in chunks which it only recently evicted, so it's budget is too low for how it is being used.
+		};
+	}
+	typedef MemoryPressures::MemoryPressure MemoryPressure;
+
+	// Each volume has it's own memory budget, but when many volumes share a machine (such as on a server) it is the total which matters.
+	// This keeps track of all the volumes and, if a limit is set, makes them give memory back whenever the total goes over it. The volumes
+	// report any increase in their usage after paging in chunks, so the total can only overshoot by the chunks being paged in at that moment.
+	// The application can also be told when memory is short (through a callback) and ask for memory to be released.
+	class MemoryLimit
+	{
+	public:
+		typedef std::function<uint64_t(void)> UsageFunction;
+		typedef std::function<uint64_t(uint64_t)> ReleaseFunction;
+
+		// Called with the reason, the total memory usage and the limit (zero if there isn't one). Note that this
+		// is called from whichever thread noticed the problem, which is often one of the background threads.
+		typedef std::function<void(MemoryPressure, uint64_t, uint64_t)> PressureCallback;
+
+		MemoryLimit();
+
+		// The functions report the volume's memory usage and release some of it (returning how much was actually released). They are called
+		// from any thread, but not after the volume has been removed. Returns an identifier to pass to removeVolume().
+		uint32_t addVolume(UsageFunction usageFunction, ReleaseFunction releaseFunction);
+		void removeVolume(uint32_t volumeId);
+
+		// Zero (the default) means there is no limit. Lowering the limit releases memory straight away if required.
+		void setLimit(uint64_t limitInBytes);
+		uint64_t getLimit(void) const { return mLimitInBytes.load(); }
+
+		// The total of the volumes, plus the pooled memory used for copies of their voxel data (see MemoryPool::getNoOfBytesReservedForArrays()).
+		uint64_t getUsage(void);
+
+		void setPressureCallback(PressureCallback pressureCallback);
+
+		// Called by a volume when it's memory usage has gone up.
+		void enforceLimit(void);
+
+		// Trims the memory pools and then asks the volumes to release memory, starting with the ones which use the most. Returns how much was released.
+		uint64_t releaseMemory(uint64_t bytesToRelease);
+
+		// Passes the problem on to the application (if it has set a callback).
+		void reportPressure(MemoryPressure pressure);
+
+	private:
+		struct Consumer
+		{
+			uint32_t id;
+			UsageFunction usageFunction;
+			ReleaseFunction releaseFunction;
+		};
+
+		// The caller must hold the mutex.
+		uint64_t calculateUsage(void);
+		uint64_t releaseMemoryFromConsumers(uint64_t bytesToRelease);
+
+		// Held while enforcing the limit, so that only one thread at a time asks the volumes for memory.
+		std::mutex mMutex;
+		std::vector<Consumer> mConsumers;
+		uint32_t mNextConsumerId;
+
+		std::atomic<uint64_t> mLimitInBytes;
+
+		// Separate, so that the callback can be copied out without waiting for an enforcement. It is then called without holding either
+		// mutex, so that it can call back into Cubiquity (e.g. to release memory).
+		std::mutex mPressureCallbackMutex;
+		PressureCallback mPressureCallback;
+	};
+}
+
+#endif //CUBIQUITY_MEMORYLIMIT_H_
@@ -33,6 +33,8 @@
 #include "Vector.h"
 #include "VoxelTraits.h"
 
+#include "PolyVox/Impl/Timer.h"
+
 #include <vector>
 
 namespace Cubiquity
@@ -68,7 +70,8 @@ namespace Cubiquity
 		// This one feels hacky?
 		OctreeNode<VoxelType>* getNodeFromIndex(uint16_t index) { return mNodes[index]; }
 
-		bool update(const Vector3F& viewPosition, float lodThreshold);
+		// See Volume::update() for the meaning of the budget.
+		bool update(const Vector3F& viewPosition, float lodThreshold, uint32_t budgetInMicroseconds = 0);
 
 		void markDataAsModified(int32_t x, int32_t y, int32_t z, Timestamp newTimeStamp);
 		void markDataAsModified(const Region& region, Timestamp newTimeStamp);
@@ -76,6 +79,9 @@ namespace Cubiquity
 		void buildOctreeNodeTree(uint16_t parent);
 		void determineActiveNodes(OctreeNode<VoxelType>* octreeNode, const Vector3F& viewPosition, float lodThreshold);
 
+		// Priority of a background surface extraction task for the given node, based on it's projected size as seen from the view position.
+		uint32_t computeTaskPriority(OctreeNode<VoxelType>* octreeNode, const Vector3F& viewPosition);
+
 		concurrent_queue<typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType*, TaskSortCriterion> mFinishedSurfaceExtractionTasks;
 
 		void setLodRange(int32_t minimumLOD, int32_t maximumLOD);
@@ -86,6 +92,16 @@ namespace Cubiquity
 		int32_t mMaximumLOD;
 		int32_t mMinimumLOD;
 
+		// Counts of surface extraction tasks which never had to run. A task is cancelled if it is superseded (or no longer needed) before
+		// it starts, and coalesced if a pending task already exists for the node when it is modified again. Only touched by the main thread.
+		uint32_t mNoOfCancelledTasks;
+		uint32_t mNoOfCoalescedTasks;
+
+		// How far ahead (in seconds) we predict the camera's movement when deciding which voxel data to prefetch. Larger values
+		// give the prefetcher more warning, but more of what it pages in may not be needed (or may be evicted before it is used).
+		// Zero turns prefetching off.
+		float mPrefetchLookAheadInSeconds;
+
 	private:
 		uint16_t createNode(Region region, uint16_t parent);
 
@@ -99,6 +115,17 @@ namespace Cubiquity
 
 		void scheduleUpdateIfNeeded(OctreeNode<VoxelType>* node, const Vector3F& viewPosition);
 
+		void updateScheduledTasks(const Vector3F& viewPosition);
+
+		// Whether a node would be active if the camera was at the given position (see determineActiveNodes()).
+		bool isActiveFromPosition(OctreeNode<VoxelType>* octreeNode, const Vector3F& viewPosition, float lodThreshold);
+
+		void prefetchChunks(const Vector3F& viewPosition, float lodThreshold);
+		void findNodesToPrefetch(OctreeNode<VoxelType>* octreeNode, const Vector3F& predictedViewPosition, float lodThreshold, std::vector< OctreeNode<VoxelType>* >& nodesToPrefetch);
+
+		// Clears the prefetch flags of the node and all it's descendants, so that they can be prefetched again later.
+		void clearPrefetchRequests(OctreeNode<VoxelType>* octreeNode);
+
 		void determineWhetherToRenderNode(uint16_t index);
 
 		std::vector< OctreeNode<VoxelType>*> mNodes;
@@ -113,6 +140,11 @@ namespace Cubiquity
 		Region mRegionToCover;
 
 		OctreeConstructionMode mOctreeConstructionMode;
+
+		// Used to estimate the camera's velocity for prefetching.
+		Vector3F mLastViewPosition;
+		::PolyVox::Timer mTimeSinceLastUpdate;
+		bool mHasLastViewPosition;
 	};
 }
 
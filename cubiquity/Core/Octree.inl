@@ -22,11 +22,13 @@
 * SOFTWARE.
 *******************************************************************************/
 
+#include "ChunkPrefetchTask.h"
 #include "OctreeNode.h"
 #include "Volume.h"
 #include "MainThreadTaskProcessor.h"
 
 #include <algorithm>
+#include <limits>
 
 namespace Cubiquity
 {
@@ -76,15 +78,37 @@ namespace Cubiquity
 			(
 				(octreeNode->isMeshUpToDate() == false) && 
 				(octreeNode->isSceduledForUpdate() == false) && 
-				(
-					(octreeNode->mLastSurfaceExtractionTask == 0) || 
-					(octreeNode->mLastSurfaceExtractionTask->mProcessingStartedTimestamp < Clock::getTimestamp())
-				) && 
 				(octreeNode->isActive() &&
 				(octreeNode->mHeight <= octreeNode->mOctree->mMinimumLOD) && // Remember that min and max 
 				(octreeNode->mHeight >= octreeNode->mOctree->mMaximumLOD))   // are counter-intuitive here!
 			)
 			{
+				// If the node was rendered last frame then this update is probably the result of an editing operation (see below).
+				bool extractOnMainThread = octreeNode->renderThisNode();
+
+				// Only the main thread creates and cancels tasks, but a worker thread can start a pending one at any time.
+				typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* pendingTask = octreeNode->mLastSurfaceExtractionTask;
+				if (pendingTask && (pendingTask->mProcessingStartedTimestamp == (std::numeric_limits<Timestamp>::max)()))
+				{
+					// A pending task has not read any voxels yet, so rather than queuing another one we let it cover this modification
+					// too. If it does manage to start before the modification then Octree::update() will notice and schedule a new one.
+					// The exception is when we want the result immediatly but the pending task is on the background processor.
+					bool pendingOnMainThread = (pendingTask->mPriority == (std::numeric_limits<uint32_t>::max)());
+					if (pendingOnMainThread || !extractOnMainThread)
+					{
+						octreeNode->mLastSceduledForUpdate = Clock::getTimestamp();
+						octreeNode->mOctree->mNoOfCoalescedTasks++;
+						return true;
+					}
+
+					// The cancelled task will still come back through the finished queue, where it will be deleted. If we fail to
+					// cancel it then it has just started and so may miss the modification, in which case we need a new task anyway.
+					if (pendingTask->cancel())
+					{
+						octreeNode->mOctree->mNoOfCancelledTasks++;
+					}
+				}
+
 				octreeNode->mLastSceduledForUpdate = Clock::getTimestamp();
 
 				octreeNode->mLastSurfaceExtractionTask = new typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType(octreeNode, octreeNode->mOctree->getVolume()->_getPolyVoxVolume());
@@ -92,30 +116,20 @@ namespace Cubiquity
 				// If the node was rendered last frame then this update is probably the result of an editing operation, rather than
 				// the node only just becoming visible. For editing operations it is important to process them immediatly so that we
 				// don't see temporary cracks in the mesh as different parts up updated at different times.
-				//if(node->mExtractOnMainThread) //This flag should still be set from last frame.
+				if (extractOnMainThread) // Still set from last frame. If we rendered it then we will probably want it again.
 				{
 					// We're going to process immediatly, but the completed task will still get queued in the finished
 					// queue, and we want to make sure it's the first out. So we still set a priority and make it high.
 					octreeNode->mLastSurfaceExtractionTask->mPriority = (std::numeric_limits<uint32_t>::max)();
-
-					if (octreeNode->renderThisNode()) // Still set from last frame. If we rendered it then we will probably want it again.
-					{
-						gMainThreadTaskProcessor.addTask(octreeNode->mLastSurfaceExtractionTask);
-					}
-					else
-					{
-						octreeNode->mOctree->getVolume()->mBackgroundTaskProcessor->addTask(octreeNode->mLastSurfaceExtractionTask);
-					}
+					gMainThreadTaskProcessor.addTask(octreeNode->mLastSurfaceExtractionTask);
 				}
-				/*else
+				else
 				{
-				// Note: tasks get sorted by their distance from the camera at the time they are added. If we
-				// want to account for the camera moving then we would have to sort the task queue each frame.
-				Vector3F regionCentre = static_cast<Vector3F>(node->mRegion.getCentre());
-				float distance = (viewPosition - regionCentre).length(); //We don't use distance squared to keep the values smaller
-				node->mLastSurfaceExtractionTask->mPriority = (std::numeric_limits<uint32_t>::max)() - static_cast<uint32_t>(distance);
-				gBackgroundTaskProcessor.addTask(node->mLastSurfaceExtractionTask);
-				}*/
+					// Note: tasks get sorted by their projected size at the time they are added, but
+					// as the camera moves Octree::updateScheduledTasks() recomputes this each frame.
+					octreeNode->mLastSurfaceExtractionTask->mPriority = octreeNode->mOctree->computeTaskPriority(octreeNode, mViewPosition);
+					octreeNode->mOctree->getVolume()->mBackgroundTaskGroup->addTask(octreeNode->mLastSurfaceExtractionTask);
+				}
 			}
 
 			return true;
@@ -135,6 +149,10 @@ namespace Cubiquity
 		, mOctreeConstructionMode(octreeConstructionMode)
 		, mMaximumLOD(0)
 		, mMinimumLOD(2) // Must be *more* than maximum
+		, mNoOfCancelledTasks(0)
+		, mNoOfCoalescedTasks(0)
+		, mPrefetchLookAheadInSeconds(0.5f)
+		, mHasLastViewPosition(false)
 	{
 		mRegionToCover = mVolume->getEnclosingRegion();
 		if(mOctreeConstructionMode == OctreeConstructionModes::BoundVoxels)
@@ -197,6 +215,13 @@ namespace Cubiquity
 	template <typename VoxelType>
 	Octree<VoxelType>::~Octree()
 	{
+		// Delete any tasks which were completed but never collected by update().
+		typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* task;
+		while(mFinishedSurfaceExtractionTasks.try_pop(task))
+		{
+			delete task;
+		}
+
 		for(uint32_t ct = 0; ct < mNodes.size(); ct++)
 		{
 			delete mNodes[ct];
@@ -222,38 +247,102 @@ namespace Cubiquity
 	}
 
 	template <typename VoxelType>
-	bool Octree<VoxelType>::update(const Vector3F& viewPosition, float lodThreshold)
+	bool Octree<VoxelType>::update(const Vector3F& viewPosition, float lodThreshold, uint32_t budgetInMicroseconds)
 	{
+		// The budget covers the whole update, though in practice the main costs are the extraction tasks and applying their results.
+		PolyVox::Timer timer;
+		const bool hasBudget = (budgetInMicroseconds > 0);
+		const float budget = static_cast<float>(budgetInMicroseconds);
+
 		// This isn't a vistior because visitors only visit active nodes, and here we are setting them.
 		determineActiveNodes(getRootNode(), viewPosition, lodThreshold);
 
+		// Must come after determining the active nodes, as tasks for inactive nodes get cancelled.
+		updateScheduledTasks(viewPosition);
+
+		// Also depends on the active nodes, as we only prefetch for nodes which are not active yet.
+		prefetchChunks(viewPosition, lodThreshold);
+
 		acceptVisitor(ScheduleUpdateIfNeededVisitor<VoxelType>(viewPosition));
 
 
 		// Make sure any surface extraction tasks which were scheduled on the main thread get processed before we determine what to render.
-		if (gMainThreadTaskProcessor.hasTasks())
+		// Tasks scheduled on the background processor are handled by its worker threads, so we never block on them here. With a budget
+		// we always process at least one task, as otherwise a budget which is too small for a single task would mean we never converge.
+		if (hasBudget)
 		{
-			gMainThreadTaskProcessor.processAllTasks(); //Doesn't really belong here
+			do
+			{
+				gMainThreadTaskProcessor.processOneTask();
+			} while (gMainThreadTaskProcessor.hasTasks() && (timer.elapsedTimeInMicroSeconds() < budget));
 		}
-		else
+		else if (gMainThreadTaskProcessor.hasTasks())
 		{
-			getVolume()->mBackgroundTaskProcessor->processOneTask(); //Doesn't really belong here
+			gMainThreadTaskProcessor.processAllTasks(); //Doesn't really belong here
 		}
 
-		// This will include tasks from both the background and main threads.
-		while(!mFinishedSurfaceExtractionTasks.empty())
+		// We check this before collecting the finished tasks. A background task which completes after we have emptied the
+		// finished queue is then still counted as pending, so we can't report being up to date while it's results are missed.
+		bool hasPendingTasks = gMainThreadTaskProcessor.hasTasks() || getVolume()->mBackgroundTaskGroup->hasTasks();
+
+		// This will include tasks from both the background and main threads. Without a budget we take them all at once to only lock
+		// the queue once, otherwise we take small batches so that we can stop once the budget is spent (but always apply one batch).
+		const uint32_t maxTasksPerBatch = hasBudget ? 8 : (std::numeric_limits<uint32_t>::max)();
+		std::vector< typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* > finishedTasks;
+		while (mFinishedSurfaceExtractionTasks.try_pop_batch(finishedTasks, maxTasksPerBatch) > 0)
 		{
-			typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* task;
-			mFinishedSurfaceExtractionTasks.wait_and_pop(task);
+			for(uint32_t ct = 0; ct < finishedTasks.size(); ct++)
+			{
+				typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* task = finishedTasks[ct];
+				OctreeNode<VoxelType>* node = task->mOctreeNode;
+
+				bool isLatestTask = (node->mLastSurfaceExtractionTask == task);
+				if(isLatestTask)
+				{
+					node->mLastSurfaceExtractionTask = 0;
+				}
+
+				// A task which failed has no result either, but unlike a cancelled one nothing has replaced it. The node is then no longer
+				// waiting for an update, so it will be scheduled again (as long as it still needs one and a newer task isn't on the way).
+				if(task->hasFailed())
+				{
+					if(isLatestTask)
+					{
+						node->mLastSceduledForUpdate = 0;
+						hasPendingTasks = true;
+					}
+				}
+				// Tasks can finish out of order, in which case a result may be older than the mesh we already have. Cancelled
+				// tasks have no result, and have already been replaced by a newer task (or the node no longer needs one).
+				else if((!task->isCancelled()) && (task->mProcessingStartedTimestamp > node->mMeshProcessingStarted))
+				{
+					node->updateFromCompletedTask(task);
+					node->mMeshProcessingStarted = task->mProcessingStartedTimestamp;
+
+					// If the data was modified after the task started then the mesh we just applied may not reflect it,
+					// even though it is newer. Unless a more recent task is already on the way we force a new extraction.
+					if(isLatestTask && (task->mProcessingStartedTimestamp < node->mDataLastModified))
+					{
+						node->mDataLastModified = Clock::getTimestamp();
+						hasPendingTasks = true;
+					}
+				}
+
+				delete task;
+			}
 
-			task->mOctreeNode->updateFromCompletedTask(task);
+			finishedTasks.clear();
 
-			if(task->mOctreeNode->mLastSurfaceExtractionTask == task)
+			if (hasBudget && (timer.elapsedTimeInMicroSeconds() >= budget))
 			{
-				task->mOctreeNode->mLastSurfaceExtractionTask = 0;
+				break;
 			}
+		}
 
-			delete task;
+		// Anything left in the finished queue will be applied next time, so we are not yet up to date.
+		if (!mFinishedSurfaceExtractionTasks.empty())
+		{
+			hasPendingTasks = true;
 		}
 
 		//acceptVisitor(DetermineWhetherToRenderVisitor<VoxelType>());
@@ -262,8 +351,8 @@ namespace Cubiquity
 
 		acceptVisitor(PropagateTimestampsVisitor<VoxelType>());
 
-		// If there are no pending tasks then return truem to indicate we are up to date.
-		return (gMainThreadTaskProcessor.hasTasks() == false) && (getVolume()->mBackgroundTaskProcessor->hasTasks() == false);
+		// If there are no pending tasks then return true to indicate we are up to date.
+		return !hasPendingTasks;
 	}
 
 	template <typename VoxelType>
@@ -394,30 +483,214 @@ namespace Cubiquity
 	{
 		// FIXME - Should have an early out to set active to false if parent is false.
 
+		bool active = isActiveFromPosition(octreeNode, viewPosition, lodThreshold);
+		octreeNode->setActive(active);
+
+		// Any prefetching for the node has done it's job (or was too late).
+		if (active)
+		{
+			octreeNode->mPrefetchRequested = false;
+		}
+
+		octreeNode->mIsLeaf = true;
+
+		for (int iz = 0; iz < 2; iz++)
+		{
+			for (int iy = 0; iy < 2; iy++)
+			{
+				for (int ix = 0; ix < 2; ix++)
+				{
+					uint16_t childIndex = octreeNode->children[ix][iy][iz];
+					if (childIndex != InvalidNodeIndex)
+					{
+						OctreeNode<VoxelType>* childNode = mNodes[childIndex];
+						determineActiveNodes(childNode, viewPosition, lodThreshold);
+					}
+
+					// If we have (or have just created) an active and valid child then we are not a leaf.
+					if (octreeNode->getChildNode(ix, iy, iz))
+					{
+						octreeNode->mIsLeaf = false;
+					}
+				}
+			}
+		}
+	}
+
+	template <typename VoxelType>
+	bool Octree<VoxelType>::isActiveFromPosition(OctreeNode<VoxelType>* octreeNode, const Vector3F& viewPosition, float lodThreshold)
+	{
 		OctreeNode<VoxelType>* parentNode = octreeNode->getParentNode();
-		if (parentNode)
+		if (!parentNode)
+		{
+			return true;
+		}
+
+		Vector3F regionCentre = static_cast<Vector3F>(parentNode->mRegion.getCentre());
+
+		float distance = (viewPosition - regionCentre).length();
+
+		Vector3I diagonal = parentNode->mRegion.getUpperCorner() - parentNode->mRegion.getLowerCorner();
+		float diagonalLength = diagonal.length(); // A measure of our regions size
+
+		float projectedSize = diagonalLength / distance;
+
+		// As we move far away only the highest nodes will be larger than the threshold. But these may be too
+		// high to ever generate meshes, so we set here a maximum height for which nodes can be set to inacive.
+		return (projectedSize > lodThreshold) || (octreeNode->mHeight >= mMinimumLOD);
+	}
+
+	template <typename VoxelType>
+	uint32_t Octree<VoxelType>::computeTaskPriority(OctreeNode<VoxelType>* octreeNode, const Vector3F& viewPosition)
+	{
+		// This is the same measure as is used for choosing the LOD in determineActiveNodes(), so large
+		// nodes which are close to the camera come first. We guard against the camera being inside the node.
+		Vector3F regionCentre = static_cast<Vector3F>(octreeNode->mRegion.getCentre());
+		float distance = (std::max)((viewPosition - regionCentre).length(), 1.0f);
+
+		Vector3I diagonal = octreeNode->mRegion.getUpperCorner() - octreeNode->mRegion.getLowerCorner();
+		float projectedSize = diagonal.length() / distance;
+
+		// Scale up to make use of the integer range. The limit is safely less than the maximum uint32_t,
+		// which is reserved for the tasks being processed immediatly on the main thread.
+		const float maxPriority = 4.0e9f;
+		return static_cast<uint32_t>((std::min)(projectedSize * 100000.0f, maxPriority));
+	}
+
+	template <typename VoxelType>
+	void Octree<VoxelType>::updateScheduledTasks(const Vector3F& viewPosition)
+	{
+		// All tasks in the volume's background processor are surface extraction tasks for this octree.
+		typedef typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType SurfaceExtractionTaskType;
+
+		std::vector<Task*> cancelledTasks;
+		getVolume()->mBackgroundTaskGroup->updateTasks([this, &viewPosition](Task* task)
+		{
+			SurfaceExtractionTaskType* extractionTask = static_cast<SurfaceExtractionTaskType*>(task);
+			OctreeNode<VoxelType>* node = extractionTask->mOctreeNode;
+
+			// The mesh for a node which is no longer active would not be used, so the task is cancelled. Tasks which were
+			// already cancelled can also be removed now, rather than waiting for a worker thread to pass them back.
+			if (extractionTask->isCancelled() || (node->isActive() == false) || (node->mHeight > mMinimumLOD) || (node->mHeight < mMaximumLOD))
+			{
+				return false;
+			}
+
+			// Tasks which are part way through keep the priority they were requeued with, so that they get finished first.
+			if (extractionTask->mProcessingStartedTimestamp == (std::numeric_limits<Timestamp>::max)())
+			{
+				task->mPriority = computeTaskPriority(node, viewPosition);
+			}
+			return true;
+		}, cancelledTasks);
+
+		for (uint32_t ct = 0; ct < cancelledTasks.size(); ct++)
 		{
-			Vector3F regionCentre = static_cast<Vector3F>(parentNode->mRegion.getCentre());
+			SurfaceExtractionTaskType* task = static_cast<SurfaceExtractionTaskType*>(cancelledTasks[ct]);
+			OctreeNode<VoxelType>* node = task->mOctreeNode;
 
-			float distance = (viewPosition - regionCentre).length();
+			// These have already been superseded and counted.
+			if (task->isCancelled())
+			{
+				delete task;
+				continue;
+			}
 
-			Vector3I diagonal = parentNode->mRegion.getUpperCorner() - parentNode->mRegion.getLowerCorner();
-			float diagonalLength = diagonal.length(); // A measure of our regions size
+			if (node->mLastSurfaceExtractionTask == task)
+			{
+				node->mLastSurfaceExtractionTask = 0;
+			}
 
-			float projectedSize = diagonalLength / distance;
+			// The node is no longer waiting for an update, so make sure it gets scheduled again if it becomes active.
+			node->mLastSceduledForUpdate = 0;
 
-			// As we move far away only the highest nodes will be larger than the threshold. But these may be too
-			// high to ever generate meshes, so we set here a maximum height for which nodes can be set to inacive.
-			bool active = (projectedSize > lodThreshold) || (octreeNode->mHeight >= mMinimumLOD);
+			mNoOfCancelledTasks++;
 
-			octreeNode->setActive(active);
+			delete task;
 		}
-		else
+	}
+
+	template <typename VoxelType>
+	void Octree<VoxelType>::prefetchChunks(const Vector3F& viewPosition, float lodThreshold)
+	{
+		// Estimate the camera's velocity from how far it has moved since last time. After a long gap (e.g. if the
+		// application was paused) the movement doesn't tell us much, so we treat the camera as being stationary.
+		const float elapsedTime = mTimeSinceLastUpdate.elapsedTimeInSeconds();
+		mTimeSinceLastUpdate.start();
+
+		Vector3F velocity(0.0f, 0.0f, 0.0f);
+		if (mHasLastViewPosition && (elapsedTime > 0.0f) && (elapsedTime < 1.0f))
 		{
-			octreeNode->setActive(true);
+			velocity = (viewPosition - mLastViewPosition) / elapsedTime;
 		}
+		mLastViewPosition = viewPosition;
+		mHasLastViewPosition = true;
 
-		octreeNode->mIsLeaf = true;
+		// If the camera is stationary (or prefetching is off) this is just the current position. No nodes are
+		// then found to prefetch, as the ones which would be active from here are already active.
+		const Vector3F predictedViewPosition = viewPosition + velocity * mPrefetchLookAheadInSeconds;
+
+		// Requests which haven't been processed yet are dropped if the camera is no longer heading towards the node,
+		// and otherwise reprioritised so that the nodes we expect to need soonest are fetched first.
+		std::vector<Task*> cancelledTasks;
+		getVolume()->mPrefetchTaskGroup->updateTasks([this, &predictedViewPosition, lodThreshold](Task* task)
+		{
+			OctreeNode<VoxelType>* node = static_cast<ChunkPrefetchTask<VoxelType>*>(task)->mOctreeNode;
+			if (!isActiveFromPosition(node, predictedViewPosition, lodThreshold))
+			{
+				return false;
+			}
+
+			task->mPriority = computeTaskPriority(node, predictedViewPosition);
+			return true;
+		}, cancelledTasks);
+
+		for (uint32_t ct = 0; ct < cancelledTasks.size(); ct++)
+		{
+			static_cast<ChunkPrefetchTask<VoxelType>*>(cancelledTasks[ct])->mOctreeNode->mPrefetchRequested = false;
+			delete cancelledTasks[ct];
+		}
+
+		std::vector< OctreeNode<VoxelType>* > nodesToPrefetch;
+		findNodesToPrefetch(getRootNode(), predictedViewPosition, lodThreshold, nodesToPrefetch);
+
+		for (uint32_t ct = 0; ct < nodesToPrefetch.size(); ct++)
+		{
+			OctreeNode<VoxelType>* node = nodesToPrefetch[ct];
+			node->mPrefetchRequested = true;
+
+			// Surface extraction also reads a small border around the node. Any further border which is needed
+			// at lower LODs is usually in the same chunks anyway, so we don't try to match it exactly here.
+			Region region = node->mRegion;
+			region.grow(2);
+
+			ChunkPrefetchTask<VoxelType>* task = new ChunkPrefetchTask<VoxelType>(node, getVolume()->_getPolyVoxVolume(), region);
+			task->mPriority = computeTaskPriority(node, predictedViewPosition);
+			getVolume()->mPrefetchTaskGroup->addTask(task);
+		}
+	}
+
+	template <typename VoxelType>
+	void Octree<VoxelType>::findNodesToPrefetch(OctreeNode<VoxelType>* octreeNode, const Vector3F& predictedViewPosition, float lodThreshold, std::vector< OctreeNode<VoxelType>* >& nodesToPrefetch)
+	{
+		// The children of a node which won't be active are smaller, so they (almost always) won't be active either. Any of them we prefetched
+		// earlier are no longer wanted, and the chunks may well be evicted before the camera comes back. Clearing their flags means they will
+		// be prefetched again if it does, as nothing else clears them once the prefetch has finished.
+		if (!isActiveFromPosition(octreeNode, predictedViewPosition, lodThreshold))
+		{
+			clearPrefetchRequests(octreeNode);
+			return;
+		}
+
+		// These are the same conditions under which ScheduleUpdateIfNeededVisitor would extract a mesh for the node, if it was active.
+		if ((octreeNode->isActive() == false) &&
+			(octreeNode->mPrefetchRequested == false) &&
+			(octreeNode->isMeshUpToDate() == false) &&
+			(octreeNode->mHeight <= mMinimumLOD) &&
+			(octreeNode->mHeight >= mMaximumLOD))
+		{
+			nodesToPrefetch.push_back(octreeNode);
+		}
 
 		for (int iz = 0; iz < 2; iz++)
 		{
@@ -428,14 +701,28 @@ namespace Cubiquity
 					uint16_t childIndex = octreeNode->children[ix][iy][iz];
 					if (childIndex != InvalidNodeIndex)
 					{
-						OctreeNode<VoxelType>* childNode = mNodes[childIndex];
-						determineActiveNodes(childNode, viewPosition, lodThreshold);
+						findNodesToPrefetch(mNodes[childIndex], predictedViewPosition, lodThreshold, nodesToPrefetch);
 					}
+				}
+			}
+		}
+	}
 
-					// If we have (or have just created) an active and valid child then we are not a leaf.
-					if (octreeNode->getChildNode(ix, iy, iz))
+	template <typename VoxelType>
+	void Octree<VoxelType>::clearPrefetchRequests(OctreeNode<VoxelType>* octreeNode)
+	{
+		octreeNode->mPrefetchRequested = false;
+
+		for (int iz = 0; iz < 2; iz++)
+		{
+			for (int iy = 0; iy < 2; iy++)
+			{
+				for (int ix = 0; ix < 2; ix++)
+				{
+					uint16_t childIndex = octreeNode->children[ix][iy][iz];
+					if (childIndex != InvalidNodeIndex)
 					{
-						octreeNode->mIsLeaf = false;
+						clearPrefetchRequests(mNodes[childIndex]);
 					}
 				}
 			}
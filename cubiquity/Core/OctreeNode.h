@@ -68,6 +68,10 @@ namespace Cubiquity
 		Timestamp mMeshLastChanged;
 		Timestamp mNodeOrChildrenLastChanged;
 
+		// When the task which produced our current mesh started processing. With several worker threads the tasks
+		// can complete in a different order to that in which they started, and this lets us ignore older results.
+		Timestamp mMeshProcessingStarted;
+
 		Octree<VoxelType>* mOctree;
 
 		// Use flags here?
@@ -79,6 +83,11 @@ namespace Cubiquity
 
 		typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType* mLastSurfaceExtractionTask;
 
+		// Set when we ask for the node's voxel data to be prefetched, and cleared once the node becomes active or the camera is no longer
+		// heading towards it (or the request is cancelled). This stops us asking again every frame while the camera approaches. Only
+		// touched by the main thread.
+		bool mPrefetchRequested;
+
 		uint16_t mSelf;
 		uint16_t children[2][2][2];
 
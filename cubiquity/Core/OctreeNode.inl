@@ -50,9 +50,11 @@ namespace Cubiquity
 		,mStructureLastChanged(1)
 		,mPropertiesLastChanged(1)
 		,mNodeOrChildrenLastChanged(1)
+		,mMeshProcessingStarted(0)
 		,mPolyVoxMesh(0)
 		,mHeight(0)
 		,mLastSurfaceExtractionTask(0)
+		,mPrefetchRequested(false)
 	{
 		for(int z = 0; z < 2; z++)
 		{
@@ -53,6 +53,8 @@ namespace Cubiquity
 		,mPolyVoxMesh(0)
 		,mProcessingStartedTimestamp((std::numeric_limits<Timestamp>::max)())
 		,mOwnMesh(false)
+		,mStage(SurfaceExtractionStages::Gather)
+		,mGatheredVolume(0)
 	{
 	}
 
@@ -64,36 +66,94 @@ namespace Cubiquity
 			mPolyVoxMesh = 0;
 			mOwnMesh = false;
 		}
+
+		// Only set if the task was discarded part way through.
+		delete mGatheredVolume;
+		mGatheredVolume = 0;
 	}
 
-	void SmoothSurfaceExtractionTask::process(void)
+	bool SmoothSurfaceExtractionTask::cancel(void)
 	{
-		mProcessingStartedTimestamp = Clock::getTimestamp();
-		//Extract the surface
-		mPolyVoxMesh = new TerrainMesh;
-		mOwnMesh = true;
+		Timestamp notStarted = (std::numeric_limits<Timestamp>::max)();
+		return mProcessingStartedTimestamp.compare_exchange_strong(notStarted, CancelledTimestamp);
+	}
+
+	bool SmoothSurfaceExtractionTask::process(void)
+	{
+		switch(mStage)
+		{
+		case SurfaceExtractionStages::Gather:
+		{
+			// The timestamp must be taken *before* we read any voxels. Edits take their timestamp after writing the voxels,
+			// so any edit which we fail to see is guaranteed to have a later timestamp (and so will trigger a new extraction).
+			// Setting it also marks the task as started, which must be done atomically as the main thread may be cancelling it.
+			Timestamp notStarted = (std::numeric_limits<Timestamp>::max)();
+			if(!mProcessingStartedTimestamp.compare_exchange_strong(notStarted, Clock::getTimestamp()))
+			{
+				mStage = SurfaceExtractionStages::Finished;
+				return false;
+			}
+
+			gather();
+			mStage = SurfaceExtractionStages::Extract;
+			return true;
+		}
+		case SurfaceExtractionStages::Extract:
+		{
+			extract();
+			if(mOctreeNode->mHeight > 0)
+			{
+				mStage = SurfaceExtractionStages::PostProcess;
+				return true;
+			}
+
+			mStage = SurfaceExtractionStages::Finished;
+			return false;
+		}
+		case SurfaceExtractionStages::PostProcess:
+		{
+			postProcess();
+			mStage = SurfaceExtractionStages::Finished;
+			return false;
+		}
+		default:
+		{
+			POLYVOX_THROW(std::logic_error, "Surface extraction task processed after it had finished");
+		}
+		}
 
-		generateSmoothMesh(mOctreeNode->mRegion, mOctreeNode->mHeight, mPolyVoxMesh);
+		return false; // Not reached, but POLYVOX_THROW isn't marked as not returning.
+	}
 
+	void SmoothSurfaceExtractionTask::onFinished(void)
+	{
 		mOctreeNode->mOctree->mFinishedSurfaceExtractionTasks.push(this);
 	}
 
-	void SmoothSurfaceExtractionTask::generateSmoothMesh(const Region& region, uint32_t lodLevel, TerrainMesh* resultMesh)
+	void SmoothSurfaceExtractionTask::onFailed(void)
 	{
-		MaterialSetMarchingCubesController controller;
+		mStage = SurfaceExtractionStages::Failed;
+		onFinished();
+	}
 
-		if(lodLevel == 0)
+	void SmoothSurfaceExtractionTask::gather(void)
+	{
+		if(mOctreeNode->mHeight == 0)
 		{
-			extractMarchingCubesMeshCustom(mPolyVoxVolume, region, resultMesh, controller);
+			// The marching cubes extractor computes gradients, so it looks a little beyond the region.
+			Region gatherRegion = mOctreeNode->mRegion;
+			gatherRegion.grow(2);
+
+			mGatheredVolume = new ::PolyVox::RawVolume<MaterialSet>(gatherRegion);
+			gatherVoxels(mPolyVoxVolume, mGatheredVolume);
 		}
 		else
 		{
-			uint32_t downSampleFactor = 0x0001 << lodLevel;
-
-			int crackHidingFactor = 5; //This should probably be configurable?
-			controller.setThreshold(controller.getThreshold() + (downSampleFactor * crackHidingFactor));
+			// Terrain is downsampled by simply taking every n'th voxel, so there is no need for a separate downsampling stage.
+			// Gathering the full resolution data first would mean copying (and holding on to) many voxels we never look at.
+			uint32_t downSampleFactor = 0x0001 << mOctreeNode->mHeight;
 
-			Region highRegion = region;
+			Region highRegion = mOctreeNode->mRegion;
 			highRegion.grow(downSampleFactor, downSampleFactor, downSampleFactor);
 
 			Region lowRegion = highRegion;
@@ -105,18 +165,53 @@ namespace Cubiquity
 			upperCorner = upperCorner + lowerCorner;
 			lowRegion.setUpperCorner(upperCorner);
 
-			::PolyVox::RawVolume<MaterialSet> resampledVolume(lowRegion);
+			// Once the step is bigger than a chunk we skip over some of them, so prefetching the whole region would page in chunks we don't need.
+			if(downSampleFactor <= mPolyVoxVolume->getChunkSideLength())
+			{
+				prefetchVoxels(mPolyVoxVolume, highRegion);
+			}
+
+			mGatheredVolume = new ::PolyVox::RawVolume<MaterialSet>(lowRegion);
+			resampleVolume(downSampleFactor, mPolyVoxVolume, highRegion, mGatheredVolume, lowRegion);
+		}
+	}
 
-			resampleVolume(downSampleFactor, mPolyVoxVolume, highRegion, &resampledVolume, lowRegion);
+	void SmoothSurfaceExtractionTask::extract(void)
+	{
+		//Extract the surface
+		mPolyVoxMesh = new TerrainMesh;
+		mOwnMesh = true;
 
-			lowRegion.shrink(1, 1, 1);
+		MaterialSetMarchingCubesController controller;
+
+		if(mOctreeNode->mHeight == 0)
+		{
+			extractMarchingCubesMeshCustom(mGatheredVolume, mOctreeNode->mRegion, mPolyVoxMesh, controller);
+		}
+		else
+		{
+			uint32_t downSampleFactor = 0x0001 << mOctreeNode->mHeight;
+
+			int crackHidingFactor = 5; //This should probably be configurable?
+			controller.setThreshold(controller.getThreshold() + (downSampleFactor * crackHidingFactor));
 
-			extractMarchingCubesMeshCustom(&resampledVolume, lowRegion, resultMesh, controller);
+			Region lowRegion = mGatheredVolume->getEnclosingRegion();
+			lowRegion.shrink(1, 1, 1);
 
-			scaleVertices(resultMesh, downSampleFactor);
+			extractMarchingCubesMeshCustom(mGatheredVolume, lowRegion, mPolyVoxMesh, controller);
 
-			recalculateMaterials(resultMesh, static_cast<Vector3F>(mOctreeNode->mRegion.getLowerCorner()), mPolyVoxVolume);
+			scaleVertices(mPolyVoxMesh, downSampleFactor);
 		}
+
+		delete mGatheredVolume;
+		mGatheredVolume = 0;
+	}
+
+	void SmoothSurfaceExtractionTask::postProcess(void)
+	{
+		// This goes back to the PagedVolume, but only for the voxels around each vertex. These are in the chunks
+		// which were read by the gather stage moments ago, so they are normally still in memory.
+		recalculateMaterials(mPolyVoxMesh, static_cast<Vector3F>(mOctreeNode->mRegion.getLowerCorner()), mPolyVoxVolume);
 	}
 
 	void recalculateMaterials(TerrainMesh* mesh, const Vector3F& meshOffset, ::PolyVox::PagedVolume<MaterialSet>* volume)
@@ -27,8 +27,13 @@
 
 #include "CubiquityForwardDeclarations.h"
 #include "OctreeNode.h"
+#include "SurfaceExtractionStage.h"
 #include "Task.h"
 
+#include "PolyVox/RawVolume.h"
+
+#include <atomic>
+
 namespace Cubiquity
 {
 	class SmoothSurfaceExtractionTask : public Task
@@ -37,19 +42,43 @@ namespace Cubiquity
 		SmoothSurfaceExtractionTask(OctreeNode< MaterialSet >* octreeNode, ::PolyVox::PagedVolume<MaterialSet>* polyVoxVolume);
 		~SmoothSurfaceExtractionTask();
 
-		void process(void);
+		bool process(void);
+
+		// Rather than being deleted, the finished task goes onto the octree's finished queue for the main thread to collect.
+		void onFinished(void);
+
+		// The task still goes onto the finished queue, but marked as failed so that the node gets scheduled again.
+		void onFailed(void);
+		bool hasFailed(void) { return mStage == SurfaceExtractionStages::Failed; }
 
-		void generateSmoothMesh(const Region& region, uint32_t lodLevel, TerrainMesh* resultMesh);
+		// Cancels the task if processing has not yet started, and returns whether it succeeded. A cancelled task is still handed
+		// back through the finished queue (so it can be deleted) but without having extracted a mesh. Main thread only.
+		bool cancel(void);
+		bool isCancelled(void) { return mProcessingStartedTimestamp == CancelledTimestamp; }
+
+		// Clock never hands out zero, so we use it to mark tasks which have been cancelled.
+		static const Timestamp CancelledTimestamp = 0;
 
 	public:
 		OctreeNode< MaterialSet >* mOctreeNode;
 		::PolyVox::PagedVolume<MaterialSet>* mPolyVoxVolume;
 		TerrainMesh* mPolyVoxMesh;
-		Timestamp mProcessingStartedTimestamp;
+		// Read by the main thread (when deciding whether to reschedule) while a worker thread may be setting it.
+		std::atomic<Timestamp> mProcessingStartedTimestamp;
 
 		// Whether the task owns the mesh, or whether it has been passed to
 		// the OctreeNode. Should probably switch this to use a smart pointer.
 		bool mOwnMesh;
+
+	private:
+		void gather(void);
+		void extract(void);
+		void postProcess(void);
+
+		SurfaceExtractionStage mStage;
+
+		// Intermediate data which is passed between the stages.
+		::PolyVox::RawVolume<MaterialSet>* mGatheredVolume;
 	};
 
 	void recalculateMaterials(TerrainMesh* mesh, const Vector3F& meshOffset, ::PolyVox::PagedVolume<MaterialSet>* volume);
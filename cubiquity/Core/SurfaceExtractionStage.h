@@ -0,0 +1,123 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef CUBIQUITY_SURFACEEXTRACTIONSTAGE_H_
+#define CUBIQUITY_SURFACEEXTRACTIONSTAGE_H_
+
+#include "Region.h"
+
+#include "PolyVox/PagedVolume.h"
+#include "PolyVox/RawVolume.h"
+
+#include <algorithm>
+
+namespace Cubiquity
+{
+	// Surface extraction tasks are processed in several stages, and the task goes back into the queue between each one. The
+	// gather stage is the one which reads the PagedVolume (and so may have to wait for data to be paged in from the database),
+	// while the downsampling and extraction work on the gathered copy. This way a worker held up by paging does not stop the
+	// others meshing nodes which are ready. Not every task needs every stage, e.g. the bottom of the octree needs no downsampling.
+	namespace SurfaceExtractionStages
+	{
+		enum SurfaceExtractionStage
+		{
+			Gather = 0, // Copy the voxels we need out of the PagedVolume.
+			Downsample = 1, // Build the lower resolution volume for nodes above the bottom of the octree.
+			Extract = 2, // Run the surface extractor.
+			PostProcess = 3, // Any fixing up of the mesh, such as recomputing materials.
+			Finished = 4,
+			Failed = 5 // A stage threw, so there is no mesh.
+		};
+	}
+	typedef SurfaceExtractionStages::SurfaceExtractionStage SurfaceExtractionStage;
+
+	// Pages in the chunks covering the region before we start reading them, which lets the PagedVolume fetch the missing ones from the
+	// database together rather than one at a time as the sampler reaches them. If the region would take up much of the memory budget
+	// then we don't bother, as the first chunks would be evicted again before we got to them.
+	template <typename VoxelType>
+	void prefetchVoxels(::PolyVox::PagedVolume<VoxelType>* srcVolume, const Region& region)
+	{
+		const int32_t chunkSideLength = srcVolume->getChunkSideLength();
+		const int32_t chunkMask = ~(chunkSideLength - 1);
+		const int64_t noOfChunksX = ((region.getUpperX() & chunkMask) - (region.getLowerX() & chunkMask)) / chunkSideLength + 1;
+		const int64_t noOfChunksY = ((region.getUpperY() & chunkMask) - (region.getLowerY() & chunkMask)) / chunkSideLength + 1;
+		const int64_t noOfChunksZ = ((region.getUpperZ() & chunkMask) - (region.getLowerZ() & chunkMask)) / chunkSideLength + 1;
+		if(noOfChunksX * noOfChunksY * noOfChunksZ * 2 <= srcVolume->getChunkCountLimit())
+		{
+			srcVolume->prefetch(region);
+		}
+	}
+
+	// Copies every voxel in the destination's enclosing region out of the source. We work through the region one chunk at a time,
+	// so that each row starts in the same chunk as the previous one and the sampler doesn't need to look the chunk up again.
+	template <typename VoxelType>
+	void gatherVoxels(::PolyVox::PagedVolume<VoxelType>* srcVolume, ::PolyVox::RawVolume<VoxelType>* dstVolume)
+	{
+		const Region& region = dstVolume->getEnclosingRegion();
+		const int32_t chunkSideLength = srcVolume->getChunkSideLength();
+		const int32_t chunkMask = ~(chunkSideLength - 1);
+
+		prefetchVoxels(srcVolume, region);
+
+		typename ::PolyVox::PagedVolume<VoxelType>::Sampler srcSampler(srcVolume);
+		typename ::PolyVox::RawVolume<VoxelType>::Sampler dstSampler(dstVolume);
+
+		for(int32_t chunkZ = region.getLowerZ() & chunkMask; chunkZ <= region.getUpperZ(); chunkZ += chunkSideLength)
+		{
+			for(int32_t chunkY = region.getLowerY() & chunkMask; chunkY <= region.getUpperY(); chunkY += chunkSideLength)
+			{
+				for(int32_t chunkX = region.getLowerX() & chunkMask; chunkX <= region.getUpperX(); chunkX += chunkSideLength)
+				{
+					// The part of the region which lies in this chunk.
+					const int32_t lowerX = (std::max)(chunkX, region.getLowerX());
+					const int32_t lowerY = (std::max)(chunkY, region.getLowerY());
+					const int32_t lowerZ = (std::max)(chunkZ, region.getLowerZ());
+					const int32_t upperX = (std::min)(chunkX + chunkSideLength - 1, region.getUpperX());
+					const int32_t upperY = (std::min)(chunkY + chunkSideLength - 1, region.getUpperY());
+					const int32_t upperZ = (std::min)(chunkZ + chunkSideLength - 1, region.getUpperZ());
+
+					for(int32_t z = lowerZ; z <= upperZ; z++)
+					{
+						for(int32_t y = lowerY; y <= upperY; y++)
+						{
+							srcSampler.setPosition(lowerX, y, z);
+							dstSampler.setPosition(lowerX, y, z);
+							for(int32_t x = lowerX; x < upperX; x++)
+							{
+								dstSampler.setVoxel(srcSampler.getVoxel());
+								srcSampler.movePositiveX();
+								dstSampler.movePositiveX();
+							}
+
+							// The last one is separate so that we don't move the source sampler into the next chunk.
+							dstSampler.setVoxel(srcSampler.getVoxel());
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif //CUBIQUITY_SURFACEEXTRACTIONSTAGE_H_
@@ -36,4 +36,18 @@ namespace Cubiquity
 		:mPriority(0)
 	{
 	}
+
+	Task::~Task()
+	{
+	}
+
+	void Task::onFinished(void)
+	{
+		delete this;
+	}
+
+	void Task::onFailed(void)
+	{
+		onFinished();
+	}
 }
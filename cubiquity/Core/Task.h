@@ -35,8 +35,20 @@ namespace Cubiquity
 	{
 	public:
 		Task();
+		virtual ~Task();
 
-		virtual void process(void) = 0;
+		// Tasks may be split into several stages, in which case each call processes the next stage. Returns true if there are
+		// more stages to come, in which case the task processor calls it again later (possibly from a different thread).
+		virtual bool process(void) = 0;
+
+		// Called by the task processor once process() has returned false. Until then the task belongs to the processor, and by
+		// default it deletes itself here. Tasks which hand themselves back to whoever scheduled them (as surface extraction tasks
+		// do, via the octree's finished queue) override this. It's called on whichever thread processed the last stage.
+		virtual void onFinished(void);
+
+		// Called instead of onFinished() if process() throws, after which there are no more stages. By default the task is
+		// treated as finished. Tasks which hand themselves back should mark themselves as failed, so their owner can tell.
+		virtual void onFailed(void);
 
 		uint32_t mPriority;
 	};
@@ -36,16 +36,16 @@ namespace Cubiquity
 	public:
 		typedef MaterialSet VoxelType;
 
-		TerrainVolume(const Region& region, const std::string& pathToNewVoxelDatabase, unsigned int baseNodeSize)
-			:Volume<MaterialSet>(region, pathToNewVoxelDatabase, baseNodeSize)
+		TerrainVolume(const Region& region, const std::string& pathToNewVoxelDatabase, unsigned int baseNodeSize, const VolumeOptions& options = VolumeOptions())
+			:Volume<MaterialSet>(region, pathToNewVoxelDatabase, baseNodeSize, options)
 		{
 			m_pVoxelDatabase->setProperty("VoxelType", "MaterialSet");
 
 			mOctree = new Octree<VoxelType>(this, OctreeConstructionModes::BoundCells, baseNodeSize);
 		}
 
-		TerrainVolume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, unsigned int baseNodeSize)
-			:Volume<MaterialSet>(pathToExistingVoxelDatabase, writePermission, baseNodeSize)
+		TerrainVolume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, unsigned int baseNodeSize, const VolumeOptions& options = VolumeOptions())
+			:Volume<MaterialSet>(pathToExistingVoxelDatabase, writePermission, baseNodeSize, options)
 		{
 			std::string voxelType = m_pVoxelDatabase->getPropertyAsString("VoxelType", "");
 			POLYVOX_THROW_IF(voxelType != "MaterialSet", std::runtime_error, "VoxelDatabase does not have the expected VoxelType of 'MaterialSet'");
@@ -55,7 +55,7 @@ namespace Cubiquity
 
 		virtual ~TerrainVolume()
 		{
-			delete mOctree;
+			// The octree is deleted by the base class, once the background tasks which refer to it have been stopped.
 		}
 	};
 }
@@ -26,6 +26,8 @@
 #define VOLUME_H_
 
 #include "BackgroundTaskProcessor.h"
+#include "ChunkCodec.h"
+#include "DatabaseProfile.h"
 #include "CubiquityForwardDeclarations.h"
 #include "Octree.h"
 #include "Vector.h"
@@ -45,14 +47,63 @@
 
 namespace Cubiquity
 {
+	// Settings which control how a volume holds it's voxel data in memory. A value of zero means 'use the default'.
+	struct VolumeOptions
+	{
+		static const uint64_t DefaultMemoryBudgetInBytes = 256 * 1024 * 1024;
+		static const uint32_t DefaultChunkSideLength = 32;
+		static const uint64_t DefaultCompressedCacheBudgetInBytes = 64 * 1024 * 1024;
+
+		VolumeOptions()
+			:memoryBudgetInBytes(0)
+			,chunkSideLength(0)
+			,compressedCacheBudgetInBytes(0)
+			,chunkCompression(ChunkCompressions::Zlib)
+			,useChunkFilters(false)
+			,databaseProfile(DatabaseProfiles::Compatible)
+			,vacuumMode(VacuumModes::WhenFragmented)
+		{
+		}
+
+		// How much memory the volume should aim to use for the voxel data it has paged in (DefaultMemoryBudgetInBytes if zero).
+		// This can also be changed later with Volume::setMemoryBudget().
+		uint64_t memoryBudgetInBytes;
+
+		// The size of the chunks which are paged in and out (DefaultChunkSideLength if zero). The chunks are stored in the voxel database
+		// under this size, so it can only be chosen when creating a new volume. When opening an existing volume it
+		// should be left as zero (or match the size which is stored).
+		uint32_t chunkSideLength;
+
+		// How much memory is used to keep recently evicted chunks in compressed form (DefaultCompressedCacheBudgetInBytes if zero), so
+		// that going back to them doesn't need the database. This is on top of the memory budget, and can be changed (or set to zero
+		// to disable the cache) with Volume::setCompressedCacheBudget().
+		uint64_t compressedCacheBudgetInBytes;
+
+		// How the chunks are compressed in the voxel database (zlib by default). Like the chunk size this is stored in the database, so it
+		// can only be chosen when creating a new volume. When opening an existing volume the stored one is always used.
+		ChunkCompression chunkCompression;
+
+		// Whether each chunk is rearranged before compression to make it compress better (see ChunkFilter.h). This makes the voxel database
+		// smaller but it can't then be read by older versions of Cubiquity, so it's off by default. It's stored in the database like the codec.
+		bool useChunkFilters;
+
+		// How SQLite is set up for the voxel database (see DatabaseProfile.h). Unlike the settings above this isn't stored
+		// in the database, so it can be different each time the volume is opened.
+		DatabaseProfile databaseProfile;
+
+		// When the voxel database is vacuumed as the volume is destroyed. Vacuuming a large one can take several seconds, so by default it
+		// is only done when there is a lot of space to give back. It can also be done at a better time with Volume::vacuumDatabase().
+		VacuumMode vacuumMode;
+	};
+
 	template <typename _VoxelType>
 	class Volume
 	{
 	public:
 		typedef _VoxelType VoxelType;
 
-		Volume(const Region& region, const std::string& pathToNewVoxelDatabase, uint32_t baseNodeSize);
-		Volume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, uint32_t baseNodeSize);
+		Volume(const Region& region, const std::string& pathToNewVoxelDatabase, uint32_t baseNodeSize, const VolumeOptions& options = VolumeOptions());
+		Volume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, uint32_t baseNodeSize, const VolumeOptions& options = VolumeOptions());
 		~Volume();
 
 		// These functions just forward to the underlying PolyVox volume.
@@ -61,6 +112,15 @@ namespace Cubiquity
 		uint32_t getDepth(void) const { return mPolyVoxVolume->getDepth(); }
 		const Region& getEnclosingRegion(void) const { return mEnclosingRegion; }
 
+		// Controls how much memory is used to hold voxel data. Lowering the budget evicts chunks straight away. Note that
+		// there can also be a limit on the total for all volumes (see MemoryLimit), which takes priority over the budget.
+		void setMemoryBudget(uint64_t memoryBudgetInBytes) { mPolyVoxVolume->setTargetMemoryUsage(memoryBudgetInBytes); }
+		uint64_t getMemoryUsage(void) const { return mPolyVoxVolume->calculateSizeInBytes(); }
+		void setCompressedCacheBudget(uint64_t compressedCacheBudgetInBytes) { mPolyVoxVolume->setCompressedCacheLimit(compressedCacheBudgetInBytes); }
+
+		// How often the voxel data was already in memory when it was needed, which shows how well the prefetching is working.
+		typename ::PolyVox::PagedVolume<VoxelType>::PagingStatistics getPagingStatistics(void) const { return mPolyVoxVolume->getPagingStatistics(); }
+
 		// Note this adds a border rather than calling straight through.
 		VoxelType getVoxel(int32_t x, int32_t y, int32_t z) const;
 
@@ -89,14 +149,23 @@ namespace Cubiquity
 			m_pVoxelDatabase->discardOverrideChunks();
 		}
 
-		// Should be called before rendering a frame to update the meshes and octree structure.
-		virtual bool update(const Vector3F& viewPosition, float lodThreshold);
+		// Gives back the unused space in the voxel database straight away, rather than waiting until it is closed. This blocks
+		// paging until it's done, so should be called when that doesn't matter (e.g. while a level is loading).
+		void vacuumDatabase(void) { m_pVoxelDatabase->vacuum(); }
+
+		// Should be called before rendering a frame to update the meshes and octree structure. If a budget is given (in
+		// microseconds) then the update tries to stay within it, leaving any remaining work for later calls. Zero means unlimited.
+		virtual bool update(const Vector3F& viewPosition, float lodThreshold, uint32_t budgetInMicroseconds = 0);
 
-		// It's a bit ugly that the background task processor is part of the volume class.
-		// We do this because we want to clear it when the volume is destroyed, to avoid
-		// the situation wher it continues to process tasks from the destroyed volume.
-		// A better solution is needed here (smart pointers?).
-		BackgroundTaskProcessor* mBackgroundTaskProcessor;
+		// Our share of the process-wide background task processor. When the volume is destroyed this
+		// cancels any of our tasks which have not started, and waits for the ones which have.
+		BackgroundTaskGroup* mBackgroundTaskGroup;
+
+		// Our share of the prefetch processor, which pages in voxel data ahead of the camera (see Octree::prefetchChunks()).
+		BackgroundTaskGroup* mPrefetchTaskGroup;
+
+		// Also on the prefetch processor, this writes modified chunks to the database after they are evicted (see update()).
+		BackgroundTaskGroup* mPageOutTaskGroup;
 
 	protected:
 		Octree<VoxelType>* mOctree;
@@ -105,9 +174,15 @@ namespace Cubiquity
 	private:
 		Volume& operator=(const Volume&);
 
+		// Called at the end of the constructors, to put the volume under the process-wide memory limit (see MemoryLimit).
+		void registerWithMemoryLimit(void);
+
 		::PolyVox::Region mEnclosingRegion;
 		::PolyVox::PagedVolume<VoxelType>* mPolyVoxVolume;
 
+		// Our identifier with gMemoryLimit.
+		uint32_t mMemoryLimitId;
+
 		//sqlite3* mDatabase;
 
 		
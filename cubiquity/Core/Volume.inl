@@ -31,9 +31,11 @@
 
 #include "Clock.h"
 #include "BackgroundTaskProcessor.h"
+#include "ChunkPageOutTask.h"
 #include "Logging.h"
 #include "MainThreadTaskProcessor.h"
 #include "MaterialSet.h"
+#include "MemoryLimit.h"
 #include "Raycasting.h"
 #include "SQLiteUtils.h"
 #include "VoxelDatabase.h"
@@ -44,22 +46,31 @@
 namespace Cubiquity
 {
 	template <typename VoxelType>
-	Volume<VoxelType>::Volume(const Region& region, const std::string& pathToNewVoxelDatabase, uint32_t baseNodeSize)
+	Volume<VoxelType>::Volume(const Region& region, const std::string& pathToNewVoxelDatabase, uint32_t baseNodeSize, const VolumeOptions& options)
 		:mPolyVoxVolume(0)
 		,m_pVoxelDatabase(0)
 		,mOctree(0)
-		,mBackgroundTaskProcessor(0)
+		,mBackgroundTaskGroup(0)
+		,mPrefetchTaskGroup(0)
+		,mPageOutTaskGroup(0)
+		,mMemoryLimitId(0)
 	{
 		POLYVOX_THROW_IF(region.getWidthInVoxels() == 0, std::invalid_argument, "Volume width must be greater than zero");
 		POLYVOX_THROW_IF(region.getHeightInVoxels() == 0, std::invalid_argument, "Volume height must be greater than zero");
 		POLYVOX_THROW_IF(region.getDepthInVoxels() == 0, std::invalid_argument, "Volume depth must be greater than zero");
 
+		// Checked before the database is created, so we don't leave one behind. Throws if the compression is unknown.
+		const ChunkCodec* chunkCodec = ChunkCodec::get(options.chunkCompression);
+		POLYVOX_THROW_IF(options.databaseProfile > DatabaseProfiles::Fast, std::invalid_argument, "Unknown database profile (", options.databaseProfile, ")");
+		POLYVOX_THROW_IF(options.vacuumMode > VacuumModes::Never, std::invalid_argument, "Unknown vacuum mode (", options.vacuumMode, ")");
+
 		//m_pVoxelDatabase = new VoxelDatabase<VoxelType>;
 		//m_pVoxelDatabase->create(pathToNewVoxelDatabase);
 
 		mEnclosingRegion = region;
 
-		m_pVoxelDatabase = VoxelDatabase<VoxelType>::createEmpty(pathToNewVoxelDatabase);
+		m_pVoxelDatabase = VoxelDatabase<VoxelType>::createEmpty(pathToNewVoxelDatabase, options.databaseProfile);
+		m_pVoxelDatabase->setVacuumMode(options.vacuumMode);
 
 		// Store the volume region to the database.
 		m_pVoxelDatabase->setProperty("lowerX", region.getLowerX());
@@ -68,24 +79,66 @@ namespace Cubiquity
 		m_pVoxelDatabase->setProperty("upperX", region.getUpperX());
 		m_pVoxelDatabase->setProperty("upperY", region.getUpperY());
 		m_pVoxelDatabase->setProperty("upperZ", region.getUpperZ());
-		
-		mPolyVoxVolume = new ::PolyVox::PagedVolume<VoxelType>(m_pVoxelDatabase, 256 * 1024 * 1024, 32);
 
-		mBackgroundTaskProcessor = new BackgroundTaskProcessor();
+		uint64_t memoryBudgetInBytes = options.memoryBudgetInBytes;
+		if (memoryBudgetInBytes == 0)
+		{
+			memoryBudgetInBytes = VolumeOptions::DefaultMemoryBudgetInBytes;
+		}
+
+		// The chunks are stored under their position, so the database is only readable using the same chunk size.
+		uint32_t chunkSideLength = options.chunkSideLength;
+		if (chunkSideLength == 0)
+		{
+			chunkSideLength = VolumeOptions::DefaultChunkSideLength;
+		}
+		m_pVoxelDatabase->setProperty("chunkSideLength", static_cast<int>(chunkSideLength));
+
+		// Similarly the database can only be read with the codec which wrote it.
+		m_pVoxelDatabase->setProperty("chunkCodec", std::string(chunkCodec->getName()));
+		m_pVoxelDatabase->setChunkCodec(chunkCodec);
+
+		m_pVoxelDatabase->setProperty("chunkFilters", options.useChunkFilters ? 1 : 0);
+		m_pVoxelDatabase->setUseChunkFilters(options.useChunkFilters);
+
+		mPolyVoxVolume = new ::PolyVox::PagedVolume<VoxelType>(m_pVoxelDatabase, memoryBudgetInBytes, chunkSideLength);
+
+		uint64_t compressedCacheBudgetInBytes = options.compressedCacheBudgetInBytes;
+		if (compressedCacheBudgetInBytes == 0)
+		{
+			compressedCacheBudgetInBytes = VolumeOptions::DefaultCompressedCacheBudgetInBytes;
+		}
+		mPolyVoxVolume->setCompressedCacheLimit(compressedCacheBudgetInBytes);
+
+		// The queued chunks are written by a ChunkPageOutTask (see update()).
+		mPolyVoxVolume->setDeferredPageOut(true);
+
+		mBackgroundTaskGroup = new BackgroundTaskGroup();
+		mPrefetchTaskGroup = new BackgroundTaskGroup(&gPrefetchTaskProcessor);
+		mPageOutTaskGroup = new BackgroundTaskGroup(&gPrefetchTaskProcessor);
+
+		registerWithMemoryLimit();
 	}
 
 	template <typename VoxelType>
-	Volume<VoxelType>::Volume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, uint32_t baseNodeSize)
+	Volume<VoxelType>::Volume(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission, uint32_t baseNodeSize, const VolumeOptions& options)
 		:mPolyVoxVolume(0)
 		,m_pVoxelDatabase(0)
 		,mOctree(0)
 		//,mDatabase(0)
-		,mBackgroundTaskProcessor(0)
+		,mBackgroundTaskGroup(0)
+		,mPrefetchTaskGroup(0)
+		,mPageOutTaskGroup(0)
+		,mMemoryLimitId(0)
 	{
 		//m_pVoxelDatabase = new VoxelDatabase<VoxelType>;
 		//m_pVoxelDatabase->open(pathToExistingVoxelDatabase);
 
-		m_pVoxelDatabase = VoxelDatabase<VoxelType>::createFromVDB(pathToExistingVoxelDatabase, writePermission);
+		POLYVOX_THROW_IF(options.databaseProfile > DatabaseProfiles::Fast, std::invalid_argument, "Unknown database profile (", options.databaseProfile, ")");
+		POLYVOX_THROW_IF(options.vacuumMode > VacuumModes::Never, std::invalid_argument, "Unknown vacuum mode (", options.vacuumMode, ")");
+
+		m_pVoxelDatabase = VoxelDatabase<VoxelType>::createFromVDB(pathToExistingVoxelDatabase, writePermission, options.databaseProfile);
+		m_pVoxelDatabase->setVacuumMode(options.vacuumMode);
 
 		// Get the volume region from the database. The default values
 		// are fairly arbitrary as there is no sensible choice here.
@@ -97,10 +150,59 @@ namespace Cubiquity
 		int32_t upperZ = m_pVoxelDatabase->getPropertyAsInt("upperZ", 512);
 
 		mEnclosingRegion = Region(lowerX, lowerY, lowerZ, upperX, upperY, upperZ);
-		
-		mPolyVoxVolume = new ::PolyVox::PagedVolume<VoxelType>(m_pVoxelDatabase, 256 * 1024 * 1024, 32);
 
-		mBackgroundTaskProcessor = new BackgroundTaskProcessor();
+		uint64_t memoryBudgetInBytes = options.memoryBudgetInBytes;
+		if (memoryBudgetInBytes == 0)
+		{
+			memoryBudgetInBytes = VolumeOptions::DefaultMemoryBudgetInBytes;
+		}
+
+		// Databases from before the chunk size was stored always used the default.
+		uint32_t chunkSideLength = m_pVoxelDatabase->getPropertyAsInt("chunkSideLength", VolumeOptions::DefaultChunkSideLength);
+		if (options.chunkSideLength != 0 && options.chunkSideLength != chunkSideLength)
+		{
+			// The destructor won't run, so don't leave the database open.
+			delete m_pVoxelDatabase;
+			m_pVoxelDatabase = 0;
+			POLYVOX_THROW(std::invalid_argument, "Requested chunk side length of ", options.chunkSideLength,
+				" does not match the ", chunkSideLength, " stored in the voxel database");
+		}
+
+		// Databases from before the codec was stored always used zlib.
+		std::string chunkCodecName = m_pVoxelDatabase->getPropertyAsString("chunkCodec", ChunkCodec::get(ChunkCompressions::Zlib)->getName());
+		const ChunkCodec* chunkCodec = ChunkCodec::find(chunkCodecName);
+		if (chunkCodec == 0)
+		{
+			delete m_pVoxelDatabase;
+			m_pVoxelDatabase = 0;
+			POLYVOX_THROW(std::runtime_error, "The voxel database was compressed with '", chunkCodecName, "', which this version of Cubiquity does not support");
+		}
+		if (options.chunkCompression != ChunkCompressions::Zlib && options.chunkCompression != chunkCodec->getCompression())
+		{
+			POLYVOX_LOG_WARNING("Ignoring the requested chunk compression as the voxel database already uses '", chunkCodecName, "'");
+		}
+		m_pVoxelDatabase->setChunkCodec(chunkCodec);
+
+		// Databases from before the filters were added don't use them. The stored setting is what matters rather than the requested one, as it's needed to read the chunks.
+		m_pVoxelDatabase->setUseChunkFilters(m_pVoxelDatabase->getPropertyAsInt("chunkFilters", 0) != 0);
+
+		mPolyVoxVolume = new ::PolyVox::PagedVolume<VoxelType>(m_pVoxelDatabase, memoryBudgetInBytes, chunkSideLength);
+
+		uint64_t compressedCacheBudgetInBytes = options.compressedCacheBudgetInBytes;
+		if (compressedCacheBudgetInBytes == 0)
+		{
+			compressedCacheBudgetInBytes = VolumeOptions::DefaultCompressedCacheBudgetInBytes;
+		}
+		mPolyVoxVolume->setCompressedCacheLimit(compressedCacheBudgetInBytes);
+
+		// The queued chunks are written by a ChunkPageOutTask (see update()).
+		mPolyVoxVolume->setDeferredPageOut(true);
+
+		mBackgroundTaskGroup = new BackgroundTaskGroup();
+		mPrefetchTaskGroup = new BackgroundTaskGroup(&gPrefetchTaskProcessor);
+		mPageOutTaskGroup = new BackgroundTaskGroup(&gPrefetchTaskProcessor);
+
+		registerWithMemoryLimit();
 	}
 
 	template <typename VoxelType>
@@ -108,20 +210,75 @@ namespace Cubiquity
 	{
 		POLYVOX_LOG_TRACE("Entering ~Volume()");
 
-		delete mBackgroundTaskProcessor;
-		mBackgroundTaskProcessor = 0;
+		// After this the memory limit won't ask us to release memory, so it's safe to start tearing things down.
+		gMemoryLimit.removeVolume(mMemoryLimitId);
+		mMemoryLimitId = 0;
+
+		// Removing our task groups waits for any of our tasks which are currently running. Only
+		// after that is it safe to delete the octree, as the tasks hold pointers to the octree nodes.
+		delete mBackgroundTaskGroup;
+		mBackgroundTaskGroup = 0;
+		delete mPrefetchTaskGroup;
+		mPrefetchTaskGroup = 0;
+		delete mPageOutTaskGroup;
+		mPageOutTaskGroup = 0;
+
+		// The main thread processor is shared by all volumes and may still hold some of our tasks (if an update ran out of
+		// budget). It holds tasks for both voxel types, hence the dynamic_cast to find the surface extraction tasks which are ours.
+		typedef typename VoxelTraits<VoxelType>::SurfaceExtractionTaskType SurfaceExtractionTaskType;
+		std::vector<Task*> cancelledTasks;
+		gMainThreadTaskProcessor.cancelTasks([this](Task* task)
+		{
+			SurfaceExtractionTaskType* extractionTask = dynamic_cast<SurfaceExtractionTaskType*>(task);
+			return (extractionTask != 0) && (extractionTask->mOctreeNode->mOctree == mOctree);
+		}, cancelledTasks);
+		for (uint32_t ct = 0; ct < cancelledTasks.size(); ct++)
+		{
+			delete cancelledTasks[ct];
+		}
 
-		// NOTE: We should really delete the volume here, but the background task processor might still be using it.
-		// We need a way to shut that down, or maybe smart pointers can help here. Just flush until we have a better fix.
-		mPolyVoxVolume->flushAll();
+		// Now nothing else can be using the octree or the PolyVox volume. The PolyVox volume
+		// pages out any modified chunks when it is destroyed, so it must go before the database.
+		delete mOctree;
+		mOctree = 0;
 
-		//delete mPolyVoxVolume;
+		delete mPolyVoxVolume;
+		mPolyVoxVolume = 0;
 
 		delete m_pVoxelDatabase;
 
 		POLYVOX_LOG_TRACE("Exiting ~Volume()");
 	}
 
+	template <typename VoxelType>
+	void Volume<VoxelType>::registerWithMemoryLimit(void)
+	{
+		// Increases in usage are checked against the process-wide limit, and any other problems are passed on to the application.
+		mPolyVoxVolume->setMemoryEventHandler([](::PolyVox::MemoryEvent memoryEvent)
+		{
+			switch (memoryEvent)
+			{
+			case ::PolyVox::MemoryEvents::UsageIncreased:
+				gMemoryLimit.enforceLimit();
+				break;
+			case ::PolyVox::MemoryEvents::LimitTooLow:
+				gMemoryLimit.reportPressure(MemoryPressures::BudgetTooLow);
+				break;
+			case ::PolyVox::MemoryEvents::PrefetchTooLarge:
+				gMemoryLimit.reportPressure(MemoryPressures::PrefetchTooLarge);
+				break;
+			case ::PolyVox::MemoryEvents::Thrashing:
+				gMemoryLimit.reportPressure(MemoryPressures::Thrashing);
+				break;
+			}
+		});
+
+		::PolyVox::PagedVolume<VoxelType>* polyVoxVolume = mPolyVoxVolume;
+		mMemoryLimitId = gMemoryLimit.addVolume(
+			[polyVoxVolume]() { return polyVoxVolume->calculateSizeInBytes(); },
+			[polyVoxVolume](uint64_t bytesToRelease) { return polyVoxVolume->releaseMemory(bytesToRelease); });
+	}
+
 	template <typename VoxelType>
 	VoxelType Volume<VoxelType>::getVoxel(int32_t x, int32_t y, int32_t z) const
 	{
@@ -149,8 +306,18 @@ namespace Cubiquity
 	}
 
 	template <typename VoxelType>
-	bool Volume<VoxelType>::update(const Vector3F& viewPosition, float lodThreshold)
+	bool Volume<VoxelType>::update(const Vector3F& viewPosition, float lodThreshold, uint32_t budgetInMicroseconds)
 	{
-		return mOctree->update(viewPosition, lodThreshold);
+		bool isUpToDate = mOctree->update(viewPosition, lodThreshold, budgetInMicroseconds);
+
+		// Modified chunks which have been evicted are queued rather than written straight away (which could stall whichever voxel
+		// access evicted them), so make sure something is writing them. One task is enough as it keeps going until the queue is empty,
+		// and it's deleted by the processor when it finishes. hasTasks() stays true until then, so we never have two at once.
+		if ((mPolyVoxVolume->getNoOfQueuedChunks() > 0) && !mPageOutTaskGroup->hasTasks())
+		{
+			mPageOutTaskGroup->addTask(new ChunkPageOutTask<VoxelType>(mPolyVoxVolume));
+		}
+
+		return isUpToDate;
 	}
 }
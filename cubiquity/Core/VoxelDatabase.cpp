@@ -22,8 +22,6 @@
 * SOFTWARE.
 *******************************************************************************/
 
-#include "miniz/miniz.c"
-
 #include "VoxelDatabase.h"
 
 #include "PolyVox/Region.h"
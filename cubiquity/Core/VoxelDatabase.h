@@ -30,12 +30,14 @@
 
 #include "SQLite/sqlite3.h"
 
-#define MINIZ_HEADER_FILE_ONLY
-#include "miniz/miniz.c"
-
+#include "ChunkCodec.h"
+#include "ChunkFilter.h"
+#include "DatabaseProfile.h"
 #include "Exceptions.h"
 #include "WritePermissions.h"
 
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace Cubiquity
@@ -50,11 +52,32 @@ namespace Cubiquity
 		/// Destructor
 		virtual ~VoxelDatabase();
 
-		static VoxelDatabase* createEmpty(const std::string& pathToNewVoxelDatabase);
-		static VoxelDatabase* createFromVDB(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission);
+		// The profile controls how SQLite is set up for the connection (see DatabaseProfile.h). It isn't stored in the database.
+		static VoxelDatabase* createEmpty(const std::string& pathToNewVoxelDatabase, DatabaseProfile profile = DatabaseProfiles::Compatible);
+		static VoxelDatabase* createFromVDB(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission,
+			DatabaseProfile profile = DatabaseProfiles::Compatible);
 
 		virtual void pageIn(const PolyVox::Region& region, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk);
 		virtual void pageOut(const PolyVox::Region& region, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk);
+		virtual void pageInBatch(const std::vector< std::pair<PolyVox::Region, typename PolyVox::PagedVolume<VoxelType>::Chunk*> >& chunks);
+		virtual void pageOutBatch(const std::vector< std::pair<PolyVox::Region, typename PolyVox::PagedVolume<VoxelType>::Chunk*> >& chunks);
+
+		// Chooses how the chunks are compressed. The volume sets this from the 'chunkCodec' property before any chunks are paged,
+		// as changing it afterwards would leave chunks in the database which can't be read. Defaults to zlib.
+		void setChunkCodec(const ChunkCodec* chunkCodec) { mChunkCodec = chunkCodec; }
+		const ChunkCodec* getChunkCodec(void) const { return mChunkCodec; }
+
+		// When enabled each chunk is rearranged by whichever ChunkFilter compresses it best, and starts with a byte saying which
+		// one it was. Like the codec this must be set (from the 'chunkFilters' property) before any chunks are paged.
+		void setUseChunkFilters(bool useChunkFilters) { mUseChunkFilters = useChunkFilters; }
+		bool getUseChunkFilters(void) const { return mUseChunkFilters; }
+
+		// Decides whether the destructor vacuums the database. Defaults to only doing so when it is fragmented.
+		void setVacuumMode(VacuumMode vacuumMode) { mVacuumMode = vacuumMode; }
+		VacuumMode getVacuumMode(void) const { return mVacuumMode; }
+
+		// Rewrites the database to give back unused space, whatever the vacuum mode. Does nothing for a read-only database.
+		void vacuum(void);
 
 		void acceptOverrideChunks(void);
 		void discardOverrideChunks(void);
@@ -72,12 +95,42 @@ namespace Cubiquity
 		/// Constructor
 		VoxelDatabase();
 
-		void initialize(void);
+		void initialize(DatabaseProfile profile);
+
+		// The caller must hold the mutex (or be the destructor).
+		void vacuumWithoutLock(void);
 
 		bool getProperty(const std::string& name, std::string& value);
 
+		// Decompresses into the chunk (using the buffers) and reorders the data. The chunk is left as it is if there is no data.
+		void decompressChunk(const uint8_t* compressedData, uint32_t compressedLength, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk,
+			std::vector<VoxelType>& linearBuffer, std::vector<uint8_t>& filteredBuffer);
+		// Steps the select statement for the chunk, returning false if it's not there and throwing a DatabaseError if the query fails. The
+		// data is valid until the statement is next reset. The caller must hold the mutex.
+		bool selectChunk(sqlite3_stmt* statement, int64_t key, const void*& compressedData, int& compressedLength);
+		// Appends the chunk's compressed data from the OverrideChunks or Blocks table to the buffer, returning false if it's not there. The
+		// blob handle should start out null, and is then kept open so that it can be reused for the next chunk. It must be closed before the
+		// mutex is released, as an open handle keeps a read transaction going (which stops the database being written by anyone else).
+		// Other failures throw a DatabaseError, after closing the handle. The caller must hold the mutex.
+		bool readChunk(sqlite3_blob*& blob, int64_t key, bool overrideChunk, std::vector<uint8_t>& buffer);
+		static void closeBlob(sqlite3_blob*& blob);
+
+		// Reorders and compresses the chunk's data using the given buffers, and returns the compressed length.
+		uint32_t compressChunk(const PolyVox::Region& region, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk,
+			std::vector<VoxelType>& linearBuffer, std::vector<uint8_t>& filteredBuffer, std::vector<uint8_t>& compressedBuffer);
+		// The caller must hold the mutex.
+		void insertOverrideChunk(const PolyVox::Region& region, const uint8_t* compressedData, uint32_t compressedLength);
+
 		sqlite3* mDatabase;
 
+		const ChunkCodec* mChunkCodec;
+		bool mUseChunkFilters;
+
+		VacuumMode mVacuumMode;
+
+		// Set when a chunk is paged out, and cleared when the OverrideChunks table is emptied. Until then there's no need to look in it.
+		bool mHasOverrideChunks;
+
 		sqlite3_stmt* mSelectChunkStatement;
 		sqlite3_stmt* mSelectOverrideChunkStatement;
 		
@@ -90,6 +143,18 @@ namespace Cubiquity
 		// Used as a temporary store into which we compress
 		// chunk data, before passing it to the database.
 		std::vector<uint8_t> mCompressedBuffer;
+
+		// Used as a temporary store for chunk data in linear order, either
+		// before compression or after decompression (it's Morton order in the chunk).
+		std::vector<VoxelType> mLinearBuffer;
+
+		// Used as a temporary store for the filtered chunk data,
+		// either before compression or after decompression.
+		std::vector<uint8_t> mFilteredBuffer;
+
+		// The PagedVolume calls the pager from whichever thread needs a chunk, but our
+		// prepared statements and temporary buffers can only be used by one at a time.
+		std::mutex mMutex;
 	};
 
 	// Utility function to perform bit rotation.
@@ -27,6 +27,7 @@
 
 #include "SQLiteUtils.h"
 
+#include <algorithm>
 #include <climits>
 
 namespace Cubiquity
@@ -43,6 +44,10 @@ namespace Cubiquity
 	template <typename VoxelType>
 	VoxelDatabase<VoxelType>::VoxelDatabase()
 		:PolyVox::PagedVolume<VoxelType>::Pager()
+		,mChunkCodec(ChunkCodec::get(ChunkCompressions::Zlib))
+		,mUseChunkFilters(false)
+		,mVacuumMode(VacuumModes::WhenFragmented)
+		,mHasOverrideChunks(false)
 	{
 	}
 
@@ -57,29 +62,36 @@ namespace Cubiquity
 		EXECUTE_SQLITE_FUNC( sqlite3_finalize(mSelectPropertyStatement) );
 		EXECUTE_SQLITE_FUNC( sqlite3_finalize(mInsertOrReplacePropertyStatement) );
 
-		if (sqlite3_db_readonly(mDatabase, "main") == 0)
+		try
 		{
-			POLYVOX_LOG_TRACE("Vacuuming database...");
-			try
+			if (shouldVacuumDatabase(mDatabase, mVacuumMode))
 			{
-				PolyVox::Timer timer;
-				EXECUTE_SQLITE_FUNC(sqlite3_exec(mDatabase, "VACUUM;", 0, 0, 0));
-				POLYVOX_LOG_TRACE("Vacuumed database in ", timer.elapsedTimeInMilliSeconds(), "ms");
-			}
-			catch (DatabaseError& e)
-			{
-				// It seems that vacuuming of the database can fail even when opened in readwrite mode, if other processes are still
-				// accessing the database. This can happen if multiple volumes are sharing the database. This shouldn't really matter
-				// as the database will probably get vacuumed at some point in the future, and it's not essential anyway.
-				POLYVOX_LOG_WARNING("Failed to vacuum database. Error message was as follows:\n\t", e.what());
+				vacuumWithoutLock();
 			}
 		}
+		catch (DatabaseError& e)
+		{
+			// It seems that vacuuming of the database can fail even when opened in readwrite mode, if other processes are still
+			// accessing the database. This can happen if multiple volumes are sharing the database. This shouldn't really matter
+			// as the database will probably get vacuumed at some point in the future, and it's not essential anyway.
+			POLYVOX_LOG_WARNING("Failed to vacuum database. Error message was as follows:\n\t", e.what());
+		}
+
+		try
+		{
+			restoreRollbackJournal(mDatabase);
+		}
+		catch (DatabaseError& e)
+		{
+			// Again this is expected if another volume still has the database open, and it will then be restored when that one closes.
+			POLYVOX_LOG_WARNING("Failed to restore the database journal. Error message was as follows:\n\t", e.what());
+		}
 
 		EXECUTE_SQLITE_FUNC(sqlite3_close(mDatabase));
 	}
 
 	template <typename VoxelType>
-	VoxelDatabase<VoxelType>* VoxelDatabase<VoxelType>::createEmpty(const std::string& pathToNewVoxelDatabase)
+	VoxelDatabase<VoxelType>* VoxelDatabase<VoxelType>::createEmpty(const std::string& pathToNewVoxelDatabase, DatabaseProfile profile)
 	{
 		// Make sure that the provided path doesn't already exist.
 		// If the file is NULL then we don't need to (and can't) close it.
@@ -100,12 +112,13 @@ namespace Cubiquity
 		// Create the 'Blocks' table. Not sure we need 'ASC' here, but it's in the example (http://goo.gl/NLHjQv) as is the default anyway.
 		EXECUTE_SQLITE_FUNC(sqlite3_exec(voxelDatabase->mDatabase, "CREATE TABLE Blocks(Region INTEGER PRIMARY KEY ASC, Data BLOB);", 0, 0, 0));
 
-		voxelDatabase->initialize();
+		voxelDatabase->initialize(profile);
 		return voxelDatabase;
 	}
 
 	template <typename VoxelType>
-	VoxelDatabase<VoxelType>* VoxelDatabase<VoxelType>::createFromVDB(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission)
+	VoxelDatabase<VoxelType>* VoxelDatabase<VoxelType>::createFromVDB(const std::string& pathToExistingVoxelDatabase, WritePermission writePermission,
+		DatabaseProfile profile)
 	{
 		// When creating a new empty voxel database the user can pass an empty string to signify that 
 		// the database will be temporary, but when creating from a VDB a valid path must be provided.
@@ -125,15 +138,14 @@ namespace Cubiquity
 			POLYVOX_THROW(std::runtime_error, "Voxel database could not be opened with requested 'write' permissions (only read-only was possible)");
 		}
 
-		voxelDatabase->initialize();
+		voxelDatabase->initialize(profile);
 		return voxelDatabase;
 	}
 
 	template <typename VoxelType>
-	void VoxelDatabase<VoxelType>::initialize(void)
+	void VoxelDatabase<VoxelType>::initialize(DatabaseProfile profile)
 	{
-		// Disable syncing
-		EXECUTE_SQLITE_FUNC(sqlite3_exec(mDatabase, "PRAGMA synchronous = OFF", 0, 0, 0));
+		applyDatabaseProfile(mDatabase, profile);
 
 		// Now create the 'OverrideChunks' table. Not sure we need 'ASC' here, but it's in the example (http://goo.gl/NLHjQv) and is the default anyway.
 		// Note that the table cannot already exist because it's created as 'TEMP', and is therefore stored in a seperate temporary database.
@@ -159,6 +171,8 @@ namespace Cubiquity
 	{
 		POLYVOX_ASSERT(pChunk, "Attempting to page in NULL chunk");
 
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		PolyVox::Timer timer;
 
 		int64_t key = regionToKey(region);
@@ -166,43 +180,192 @@ namespace Cubiquity
 		const void* compressedData = nullptr;
 		int compressedLength = 0;
 
-		// First we try and read the data from the OverrideChunks table
-		// Based on: http://stackoverflow.com/a/5308188
-		sqlite3_reset(mSelectOverrideChunkStatement);
-		sqlite3_bind_int64(mSelectOverrideChunkStatement, 1, key);
-		if(sqlite3_step(mSelectOverrideChunkStatement) == SQLITE_ROW)
-        {
-			// I think the last index is zero because our select statement only returned one column.
-			compressedLength = sqlite3_column_bytes(mSelectOverrideChunkStatement, 0);
-			compressedData = sqlite3_column_blob(mSelectOverrideChunkStatement, 0);
-        }
-		else
+		// For a single chunk a prepared statement beats the blob handles used by pageInBatch(), because opening a handle costs more than
+		// it saves. The data is decompressed straight out of SQLite's page cache, so it's never copied. We also skip the OverrideChunks
+		// table if nothing has been written to it, and otherwise try it first. Based on: http://stackoverflow.com/a/5308188
+		sqlite3_stmt* statement = mSelectOverrideChunkStatement;
+		if (!mHasOverrideChunks || !selectChunk(statement, key, compressedData, compressedLength))
 		{
 			// In this case the chunk data wasn't found in the override table, so we go to the real Chunks table.
-			sqlite3_reset(mSelectChunkStatement);
-			sqlite3_bind_int64(mSelectChunkStatement, 1, key);
-			if(sqlite3_step(mSelectChunkStatement) == SQLITE_ROW)
+			statement = mSelectChunkStatement;
+			selectChunk(statement, key, compressedData, compressedLength);
+		}
+
+		// The data belongs to the statement, which holds a read transaction open until it is reset. So we reset it as soon as we're
+		// done with the data, rather than leaving it until the next page-in (which would stop anyone else writing in the meantime).
+		try
+		{
+			decompressChunk(static_cast<const uint8_t*>(compressedData), static_cast<uint32_t>(compressedLength), pChunk, mLinearBuffer, mFilteredBuffer);
+		}
+		catch (...)
+		{
+			sqlite3_reset(statement);
+			throw;
+		}
+		sqlite3_reset(statement);
+
+		POLYVOX_LOG_TRACE("Paged chunk in in ", timer.elapsedTimeInMilliSeconds(), "ms");
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::pageInBatch(const std::vector< std::pair<PolyVox::Region, typename PolyVox::PagedVolume<VoxelType>::Chunk*> >& chunks)
+	{
+		PolyVox::Timer timer;
+
+		// The compressed data is read into a single buffer while we hold the lock, but decompressing it is the slow part and can happen
+		// afterwards. Other threads can then page in (or out) chunks while we are busy. Each chunk's data runs up to the next one's offset.
+		std::vector<uint8_t> compressedChunks;
+		std::vector<uint32_t> offsets(chunks.size() + 1);
+		std::vector<bool> found(chunks.size());
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			// The blob handles are moved from row to row, which is much quicker than a query for each chunk.
+			sqlite3_blob* overrideBlob = nullptr;
+			sqlite3_blob* blob = nullptr;
+			try
+			{
+				for (uint32_t ct = 0; ct < chunks.size(); ct++)
+				{
+					POLYVOX_ASSERT(chunks[ct].second, "Attempting to page in NULL chunk");
+					const int64_t key = regionToKey(chunks[ct].first);
+					offsets[ct] = static_cast<uint32_t>(compressedChunks.size());
+					found[ct] = readChunk(overrideBlob, key, true, compressedChunks) || readChunk(blob, key, false, compressedChunks);
+				}
+			}
+			catch (...)
 			{
-				// I think the last index is zero because our select statement only returned one column.
-				compressedLength = sqlite3_column_bytes(mSelectChunkStatement, 0);
-				compressedData = sqlite3_column_blob(mSelectChunkStatement, 0);
+				// Whichever handle failed has already been closed, but the other may still be holding a read transaction open.
+				closeBlob(overrideBlob);
+				closeBlob(blob);
+				throw;
 			}
+			offsets[chunks.size()] = static_cast<uint32_t>(compressedChunks.size());
+			closeBlob(overrideBlob);
+			closeBlob(blob);
+		}
+
+		std::vector<VoxelType> linearBuffer;
+		std::vector<uint8_t> filteredBuffer;
+		for (uint32_t ct = 0; ct < chunks.size(); ct++)
+		{
+			const uint8_t* compressedData = found[ct] ? &(compressedChunks[offsets[ct]]) : nullptr;
+			decompressChunk(compressedData, offsets[ct + 1] - offsets[ct], chunks[ct].second, linearBuffer, filteredBuffer);
+		}
+
+		POLYVOX_LOG_TRACE("Paged in batch of ", chunks.size(), " chunks in ", timer.elapsedTimeInMilliSeconds(), "ms");
+	}
+
+	template <typename VoxelType>
+	bool VoxelDatabase<VoxelType>::selectChunk(sqlite3_stmt* statement, int64_t key, const void*& compressedData, int& compressedLength)
+	{
+		sqlite3_reset(statement);
+		sqlite3_bind_int64(statement, 1, key);
+
+		// SQLITE_DONE means there's no such chunk, but anything else (such as the database still being locked once the busy timeout
+		// has run out) must not be mistaken for that. The chunk would be left empty, and could later be written over the real data.
+		int result = sqlite3_step(statement);
+		if (result == SQLITE_ROW)
+		{
+			// I think the last index is zero because our select statement only returned one column.
+			compressedLength = sqlite3_column_bytes(statement, 0);
+			compressedData = sqlite3_column_blob(statement, 0);
+			return compressedData != nullptr;
 		}
+		else if (result != SQLITE_DONE)
+		{
+			sqlite3_reset(statement);
+			POLYVOX_THROW(DatabaseError, "Encountered '", sqlite3_errstr(result), "' (error code ", result, ") when selecting chunk ", key);
+		}
+		return false;
+	}
 
+	template <typename VoxelType>
+	bool VoxelDatabase<VoxelType>::readChunk(sqlite3_blob*& blob, int64_t key, bool overrideChunk, std::vector<uint8_t>& buffer)
+	{
+		// Nothing has been written to the override table, so don't waste time looking in it.
+		if (overrideChunk && !mHasOverrideChunks)
+		{
+			return false;
+		}
+
+		// Moving an open handle to another row is much cheaper than opening a new one. A row which doesn't exist gives SQLITE_ERROR
+		// (which is how we find out), and leaves the handle unusable. Anything else (e.g. the database being busy or an I/O error) must
+		// not be mistaken for a missing chunk, as the chunk would then be left empty and could later be written over the real data.
+		int result = blob ? sqlite3_blob_reopen(blob, key) :
+			sqlite3_blob_open(mDatabase, overrideChunk ? "temp" : "main", overrideChunk ? "OverrideChunks" : "Blocks", "Data", key, 0, &blob);
+		if (result == SQLITE_ERROR)
+		{
+			closeBlob(blob);
+			return false;
+		}
+		else if (result != SQLITE_OK)
+		{
+			closeBlob(blob);
+			POLYVOX_THROW(DatabaseError, "Encountered '", sqlite3_errstr(result), "' (error code ", result, ") when opening chunk ", key, " for reading");
+		}
+
+		// The data is read straight into our buffer, whereas sqlite3_column_blob() makes it's own copy of any blob which doesn't fit in a page.
+		// Empty data is treated as missing, as sqlite3_column_blob() used to give null for it.
+		const int length = sqlite3_blob_bytes(blob);
+		if (length == 0)
+		{
+			return false;
+		}
+
+		const uint32_t offset = static_cast<uint32_t>(buffer.size());
+		buffer.resize(offset + length);
+		result = sqlite3_blob_read(blob, &(buffer[offset]), length, 0);
+		if (result != SQLITE_OK)
+		{
+			buffer.resize(offset);
+			closeBlob(blob);
+			POLYVOX_THROW(DatabaseError, "Encountered '", sqlite3_errstr(result), "' (error code ", result, ") when reading chunk ", key);
+		}
+		return true;
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::closeBlob(sqlite3_blob*& blob)
+	{
+		// This can only fail if something went wrong while using the handle, which we will already have dealt with.
+		sqlite3_blob_close(blob);
+		blob = nullptr;
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::decompressChunk(const uint8_t* compressedData, uint32_t compressedLength, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk,
+		std::vector<VoxelType>& linearBuffer, std::vector<uint8_t>& filteredBuffer)
+	{
 		// The data might not have been found in the database, in which case
 		// we leave the chunk in it's default state (initialized to zero).
 		if (compressedData)
 		{
-			mz_ulong uncomp_len = pChunk->getDataSizeInBytes();
-			int status = uncompress((unsigned char*)pChunk->getData(), &uncomp_len, (const unsigned char*)compressedData, compressedLength);
-			POLYVOX_THROW_IF(status != Z_OK, CompressionError, "Decompression failed with error message \'", mz_error(status), "\'");
+			// Data on disk is stored in linear order because so far we have not been able to show that Morton order has better compression.
+			// But data in memory has Morton order because it is (probably) faster to access, so we decompress into the buffer and reorder from there.
+			const uint32_t chunkDataLength = pChunk->getDataSizeInBytes();
+			linearBuffer.resize(chunkDataLength / sizeof(VoxelType));
+			uint8_t* linearData = reinterpret_cast<uint8_t*>(&(linearBuffer[0]));
 
-			// Data on disk is stored in linear order because so far we have not been able to show that Morton order
-			// has better compression. But data in memory has Morton order because it is (probably) faster to access.
-			pChunk->changeLinearOrderingToMorton();
-		}
+			if (mUseChunkFilters)
+			{
+				// The first byte says which filter was used, and the rest is the compressed filtered data.
+				POLYVOX_THROW_IF(compressedLength < 1, CompressionError, "Filtered chunk is missing it's filter");
+				const ChunkFilter filter = static_cast<ChunkFilter>(compressedData[0]);
+				const uint32_t filteredLength = getFilteredChunkLength(filter, chunkDataLength, sizeof(VoxelType));
+
+				filteredBuffer.resize(filteredLength);
+				mChunkCodec->decompress(compressedData + 1, compressedLength - 1,
+					getFilteredChunkElementSize(filter, sizeof(VoxelType)), &(filteredBuffer[0]), filteredLength);
+				removeChunkFilter(filter, &(filteredBuffer[0]), filteredLength, sizeof(VoxelType), linearData, chunkDataLength);
+			}
+			else
+			{
+				mChunkCodec->decompress(compressedData, compressedLength, sizeof(VoxelType), linearData, chunkDataLength);
+			}
 
-		POLYVOX_LOG_TRACE("Paged chunk in in ", timer.elapsedTimeInMilliSeconds(), "ms");
+			pChunk->setDataFromLinearOrder(&(linearBuffer[0]));
+		}
 	}
 
 	template <typename VoxelType>
@@ -210,58 +373,172 @@ namespace Cubiquity
 	{
 		POLYVOX_ASSERT(pChunk, "Attempting to page out NULL chunk");
 
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		PolyVox::Timer timer;
 
 		POLYVOX_LOG_TRACE("Paging out data for ", region);
 
+		uint32_t compressedLength = compressChunk(region, pChunk, mLinearBuffer, mFilteredBuffer, mCompressedBuffer);
+		insertOverrideChunk(region, &(mCompressedBuffer[0]), compressedLength);
+
+		POLYVOX_LOG_TRACE("Paged chunk out in ", timer.elapsedTimeInMilliSeconds(), "ms (", pChunk->getDataSizeInBytes(), "bytes of data)");
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::pageOutBatch(const std::vector< std::pair<PolyVox::Region, typename PolyVox::PagedVolume<VoxelType>::Chunk*> >& chunks)
+	{
+		PolyVox::Timer timer;
+
+		// The compression is the slow part, and doesn't need the lock if we use our own buffers. Other threads can then page in
+		// chunks in the meantime, and only have to wait for the inserts.
+		std::vector<VoxelType> linearBuffer;
+		std::vector<uint8_t> filteredBuffer;
+		std::vector< std::vector<uint8_t> > compressedChunks(chunks.size());
+		for (uint32_t ct = 0; ct < chunks.size(); ct++)
+		{
+			POLYVOX_ASSERT(chunks[ct].second, "Attempting to page out NULL chunk");
+			uint32_t compressedLength = compressChunk(chunks[ct].first, chunks[ct].second, linearBuffer, filteredBuffer, compressedChunks[ct]);
+			compressedChunks[ct].resize(compressedLength);
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// Without an explicit transaction SQLite wraps each insert in it's own, which is much slower than committing them together.
+		EXECUTE_SQLITE_FUNC(sqlite3_exec(mDatabase, "BEGIN TRANSACTION;", 0, 0, 0));
+		try
+		{
+			for (uint32_t ct = 0; ct < chunks.size(); ct++)
+			{
+				insertOverrideChunk(chunks[ct].first, &(compressedChunks[ct][0]), static_cast<uint32_t>(compressedChunks[ct].size()));
+			}
+		}
+		catch (...)
+		{
+			// The PagedVolume keeps the chunks if paging them out fails, so none of the batch should be written.
+			sqlite3_exec(mDatabase, "ROLLBACK TRANSACTION;", 0, 0, 0);
+			throw;
+		}
+		EXECUTE_SQLITE_FUNC(sqlite3_exec(mDatabase, "COMMIT TRANSACTION;", 0, 0, 0));
+
+		POLYVOX_LOG_TRACE("Paged out batch of ", chunks.size(), " chunks in ", timer.elapsedTimeInMilliSeconds(), "ms");
+	}
+
+	template <typename VoxelType>
+	uint32_t VoxelDatabase<VoxelType>::compressChunk(const PolyVox::Region& region, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk,
+		std::vector<VoxelType>& linearBuffer, std::vector<uint8_t>& filteredBuffer, std::vector<uint8_t>& compressedBuffer)
+	{
 		// Data on disk is stored in linear order because so far we have not been able to show that Morton order
 		// has better compression. But data in memory has Morton order because it is (probably) faster to access.
-		pChunk->changeMortonOrderingToLinear();
+		// We reorder into a separate buffer because other threads may still be reading from the chunk.
+		const int32_t sideLength = region.getWidthInVoxels();
+		linearBuffer.resize(sideLength * sideLength * sideLength);
+		uint32_t linearIndex = 0;
+		for (int32_t z = 0; z < sideLength; z++)
+		{
+			for (int32_t y = 0; y < sideLength; y++)
+			{
+				for (int32_t x = 0; x < sideLength; x++)
+				{
+					linearBuffer[linearIndex] = pChunk->getVoxel(x, y, z);
+					linearIndex++;
+				}
+			}
+		}
+
+		const uint8_t* srcData = reinterpret_cast<const uint8_t*>(&(linearBuffer[0]));
+		uint32_t srcLength = pChunk->getDataSizeInBytes();
+		uint32_t elementSize = sizeof(VoxelType);
+
+		// With filters the chunk starts with a byte saying which was used, and we compress the filtered data instead.
+		uint32_t headerLength = 0;
+		uint8_t filter = ChunkFilters::None;
+		if (mUseChunkFilters)
+		{
+			filter = static_cast<uint8_t>(applyBestChunkFilter(srcData, srcLength, sizeof(VoxelType), mChunkCodec, filteredBuffer));
+			srcData = &(filteredBuffer[0]);
+			srcLength = static_cast<uint32_t>(filteredBuffer.size());
+			elementSize = getFilteredChunkElementSize(static_cast<ChunkFilter>(filter), sizeof(VoxelType));
+			headerLength = 1;
+		}
 
 		// Prepare for compression
-		uLong srcLength = pChunk->getDataSizeInBytes();
-		uLong compressedLength = compressBound(srcLength); // Gets update when compression happens
-		if (mCompressedBuffer.size() != compressedLength)
+		uint32_t maxCompressedLength = headerLength + mChunkCodec->getMaxCompressedLength(srcLength, elementSize);
+		if (compressedBuffer.size() < maxCompressedLength)
 		{
-			// All chunks are the same size so should have the same upper bound. Therefore this should only happen once.
-			POLYVOX_LOG_INFO("Resizing compressed data buffer to ", compressedLength, "bytes. This should only happen once");
-			mCompressedBuffer.resize(compressedLength);
+			compressedBuffer.resize(maxCompressedLength);
 		}
 
-		// Perform the compression, and update passed parameter with the new length.
-		int status = compress(&(mCompressedBuffer[0]), &compressedLength, (const unsigned char *)pChunk->getData(), srcLength);
-		POLYVOX_THROW_IF(status != Z_OK, CompressionError, "Compression failed with error message \'", mz_error(status), "\'");
+		if (headerLength > 0)
+		{
+			compressedBuffer[0] = filter;
+		}
+
+		return headerLength + mChunkCodec->compress(srcData, srcLength, elementSize,
+			&(compressedBuffer[headerLength]), static_cast<uint32_t>(compressedBuffer.size()) - headerLength);
+	}
 
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::insertOverrideChunk(const PolyVox::Region& region, const uint8_t* compressedData, uint32_t compressedLength)
+	{
 		int64_t key = regionToKey(region);
 
 		// Based on: http://stackoverflow.com/a/5308188
 		sqlite3_reset(mInsertOrReplaceOverrideChunkStatement);
 		sqlite3_bind_int64(mInsertOrReplaceOverrideChunkStatement, 1, key);
-		sqlite3_bind_blob(mInsertOrReplaceOverrideChunkStatement, 2, static_cast<const void*>(&(mCompressedBuffer[0])), compressedLength, SQLITE_TRANSIENT);
+		sqlite3_bind_blob(mInsertOrReplaceOverrideChunkStatement, 2, static_cast<const void*>(compressedData), compressedLength, SQLITE_TRANSIENT);
 		sqlite3_step(mInsertOrReplaceOverrideChunkStatement);
 
-		POLYVOX_LOG_TRACE("Paged chunk out in ", timer.elapsedTimeInMilliSeconds(), "ms (", pChunk->getDataSizeInBytes(), "bytes of data)");
+		mHasOverrideChunks = true;
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::vacuum(void)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (sqlite3_db_readonly(mDatabase, "main") == 0)
+		{
+			vacuumWithoutLock();
+		}
+	}
+
+	template <typename VoxelType>
+	void VoxelDatabase<VoxelType>::vacuumWithoutLock(void)
+	{
+		POLYVOX_LOG_TRACE("Vacuuming database...");
+		PolyVox::Timer timer;
+		EXECUTE_SQLITE_FUNC(sqlite3_exec(mDatabase, "VACUUM;", 0, 0, 0));
+		POLYVOX_LOG_TRACE("Vacuumed database in ", timer.elapsedTimeInMilliSeconds(), "ms");
 	}
 
 	template <typename VoxelType>
 	void VoxelDatabase<VoxelType>::acceptOverrideChunks(void)
 	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		EXECUTE_SQLITE_FUNC( sqlite3_exec(mDatabase, "INSERT OR REPLACE INTO Blocks (Region, Data) SELECT Region, Data from OverrideChunks;", 0, 0, 0) );
 
 		// The override chunks have been copied accross so we
 		// can now discard the contents of the override table.
-		discardOverrideChunks();
+		EXECUTE_SQLITE_FUNC( sqlite3_exec(mDatabase, "DELETE FROM OverrideChunks;", 0, 0, 0) );
+		mHasOverrideChunks = false;
 	}
 
 	template <typename VoxelType>
 	void VoxelDatabase<VoxelType>::discardOverrideChunks(void)
 	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		EXECUTE_SQLITE_FUNC( sqlite3_exec(mDatabase, "DELETE FROM OverrideChunks;", 0, 0, 0) );
+		mHasOverrideChunks = false;
 	}
 
 	template <typename VoxelType>
 	bool VoxelDatabase<VoxelType>::getProperty(const std::string& name, std::string& value)
 	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		EXECUTE_SQLITE_FUNC(sqlite3_reset(mSelectPropertyStatement));
 		EXECUTE_SQLITE_FUNC(sqlite3_bind_text(mSelectPropertyStatement, 1, name.c_str(), -1, SQLITE_TRANSIENT));
 		if (sqlite3_step(mSelectPropertyStatement) == SQLITE_ROW)
@@ -332,6 +609,8 @@ namespace Cubiquity
 	template <typename VoxelType>
 	void VoxelDatabase<VoxelType>::setProperty(const std::string& name, const std::string& value)
 	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
 		// Based on: http://stackoverflow.com/a/5308188
 		EXECUTE_SQLITE_FUNC(sqlite3_reset(mInsertOrReplacePropertyStatement));
 		EXECUTE_SQLITE_FUNC(sqlite3_bind_text(mInsertOrReplacePropertyStatement, 1, name.c_str(), -1, SQLITE_TRANSIENT));
@@ -94,10 +94,10 @@ public:
 	int32_t posY;
 	int32_t posZ;
 
-	uint32_t structureLastSynced;
-	uint32_t propertiesLastSynced;
-	uint32_t meshLastSynced;
-	uint32_t nodeAndChildrenLastSynced;
+	uint64_t structureLastSynced;
+	uint64_t propertiesLastSynced;
+	uint64_t meshLastSynced;
+	uint64_t nodeAndChildrenLastSynced;
 
 	uint32_t renderThisNode;
 
@@ -0,0 +1,263 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+// Reports the compression ratio and speed of each chunk codec (with and without the chunk filters) over the chunks stored in some voxel
+// databases, to help choose between them. The chunks are read however the database stores them, and then recompressed in memory by each one.
+//
+// Sample command line:
+// ChunkCodecBenchmark "C:\code\cubiquity\Data\VoxelDatabases\Version 0\VoxeliensTerrain.vdb" "C:\code\cubiquity\Data\VoxelDatabases\Version 0\SmoothVoxeliensTerrain.vdb"
+
+#include "ChunkCodec.h"
+#include "ChunkFilter.h"
+
+#include "PolyVox/Impl/Timer.h"
+
+#include "SQLite/sqlite3.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Cubiquity;
+using namespace std;
+
+// Each codec is run over all the chunks repeatedly until at least this long has passed, to get stable timings.
+const float MinimumTimeInSeconds = 0.5f;
+
+// Compresses the same way as the VoxelDatabase, with the filter (if used) in the first byte.
+uint32_t compressChunk(const ChunkCodec* codec, bool useFilters, const vector<uint8_t>& chunk, uint32_t voxelSizeInBytes,
+	vector<uint8_t>& filtered, vector<uint8_t>& compressed)
+{
+	const uint8_t* src = &(chunk[0]);
+	uint32_t srcLength = static_cast<uint32_t>(chunk.size());
+	uint32_t elementSize = voxelSizeInBytes;
+	uint32_t headerLength = 0;
+	if (useFilters)
+	{
+		ChunkFilter filter = applyBestChunkFilter(src, srcLength, voxelSizeInBytes, codec, filtered);
+		src = &(filtered[0]);
+		srcLength = static_cast<uint32_t>(filtered.size());
+		elementSize = getFilteredChunkElementSize(filter, voxelSizeInBytes);
+		headerLength = 1;
+
+		compressed.resize(headerLength + codec->getMaxCompressedLength(srcLength, elementSize));
+		compressed[0] = static_cast<uint8_t>(filter);
+	}
+	else
+	{
+		compressed.resize(codec->getMaxCompressedLength(srcLength, elementSize));
+	}
+
+	return headerLength + codec->compress(src, srcLength, elementSize, &(compressed[headerLength]), static_cast<uint32_t>(compressed.size()) - headerLength);
+}
+
+void decompressChunk(const ChunkCodec* codec, bool useFilters, const uint8_t* src, uint32_t srcLength, uint32_t voxelSizeInBytes,
+	vector<uint8_t>& filtered, uint8_t* dst, uint32_t dstLength)
+{
+	if (useFilters)
+	{
+		if (srcLength < 1)
+		{
+			throw runtime_error("Filtered chunk is missing it's filter");
+		}
+		const ChunkFilter filter = static_cast<ChunkFilter>(src[0]);
+		filtered.resize(getFilteredChunkLength(filter, dstLength, voxelSizeInBytes));
+		codec->decompress(src + 1, srcLength - 1, getFilteredChunkElementSize(filter, voxelSizeInBytes), &(filtered[0]), static_cast<uint32_t>(filtered.size()));
+		removeChunkFilter(filter, &(filtered[0]), static_cast<uint32_t>(filtered.size()), voxelSizeInBytes, dst, dstLength);
+	}
+	else
+	{
+		codec->decompress(src, srcLength, voxelSizeInBytes, dst, dstLength);
+	}
+}
+
+string getProperty(sqlite3* database, const string& name, const string& defaultValue)
+{
+	string value = defaultValue;
+	sqlite3_stmt* statement = 0;
+	if (sqlite3_prepare_v2(database, "SELECT Value FROM Properties WHERE Name = ?", -1, &statement, NULL) == SQLITE_OK)
+	{
+		sqlite3_bind_text(statement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+		if (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			value = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+		}
+	}
+	sqlite3_finalize(statement);
+	return value;
+}
+
+// Reads and decompresses every chunk, returning the voxel size.
+uint32_t loadChunks(const string& path, vector< vector<uint8_t> >& chunks)
+{
+	sqlite3* database = 0;
+	if (sqlite3_open_v2(path.c_str(), &database, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+	{
+		sqlite3_close(database);
+		throw runtime_error("Failed to open '" + path + "'");
+	}
+
+	// Older databases don't store the chunk size or codec, in which case they use the defaults.
+	const string voxelType = getProperty(database, "VoxelType", "");
+	const uint32_t chunkSideLength = atoi(getProperty(database, "chunkSideLength", "32").c_str());
+	const string codecName = getProperty(database, "chunkCodec", "zlib");
+	const bool useFilters = atoi(getProperty(database, "chunkFilters", "0").c_str()) != 0;
+
+	uint32_t voxelSizeInBytes = 0;
+	if (voxelType == "Color")
+	{
+		voxelSizeInBytes = 4;
+	}
+	else if (voxelType == "MaterialSet")
+	{
+		voxelSizeInBytes = 8;
+	}
+
+	const ChunkCodec* codec = ChunkCodec::find(codecName);
+	if ((voxelSizeInBytes == 0) || (codec == 0))
+	{
+		sqlite3_close(database);
+		throw runtime_error("Unrecognised voxel type ('" + voxelType + "') or chunk codec ('" + codecName + "') in '" + path + "'");
+	}
+
+	const uint32_t chunkSizeInBytes = chunkSideLength * chunkSideLength * chunkSideLength * voxelSizeInBytes;
+
+	vector<uint8_t> filtered;
+	sqlite3_stmt* statement = 0;
+	sqlite3_prepare_v2(database, "SELECT Data FROM Blocks", -1, &statement, NULL);
+	while (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		chunks.push_back(vector<uint8_t>(chunkSizeInBytes));
+		decompressChunk(codec, useFilters, static_cast<const uint8_t*>(sqlite3_column_blob(statement, 0)), sqlite3_column_bytes(statement, 0),
+			voxelSizeInBytes, filtered, &(chunks.back()[0]), chunkSizeInBytes);
+	}
+	sqlite3_finalize(statement);
+	sqlite3_close(database);
+
+	cout << path << ": " << chunks.size() << " chunks of " << voxelType << " (" << chunkSideLength << " voxels per side), stored as '" << codecName << "'" << (useFilters ? " with filters" : "") << endl;
+	return voxelSizeInBytes;
+}
+
+void benchmarkCodec(const ChunkCodec* codec, bool useFilters, const vector< vector<uint8_t> >& chunks, uint32_t voxelSizeInBytes)
+{
+	// Compress everything once up front, which gives us the data to decompress and the compressed size.
+	vector< vector<uint8_t> > compressedChunks(chunks.size());
+	vector<uint8_t> filtered;
+	uint64_t uncompressedSize = 0;
+	uint64_t compressedSize = 0;
+	for (uint32_t ct = 0; ct < chunks.size(); ct++)
+	{
+		uint32_t compressedLength = compressChunk(codec, useFilters, chunks[ct], voxelSizeInBytes, filtered, compressedChunks[ct]);
+		compressedChunks[ct].resize(compressedLength);
+
+		uncompressedSize += chunks[ct].size();
+		compressedSize += compressedLength;
+	}
+
+	vector<uint8_t> buffer;
+	uint32_t noOfPasses = 0;
+	PolyVox::Timer compressTimer;
+	do
+	{
+		for (uint32_t ct = 0; ct < chunks.size(); ct++)
+		{
+			compressChunk(codec, useFilters, chunks[ct], voxelSizeInBytes, filtered, buffer);
+		}
+		noOfPasses++;
+	} while (compressTimer.elapsedTimeInSeconds() < MinimumTimeInSeconds);
+	const float compressSeconds = compressTimer.elapsedTimeInSeconds() / noOfPasses;
+
+	noOfPasses = 0;
+	PolyVox::Timer decompressTimer;
+	do
+	{
+		for (uint32_t ct = 0; ct < chunks.size(); ct++)
+		{
+			buffer.resize(chunks[ct].size());
+			decompressChunk(codec, useFilters, &(compressedChunks[ct][0]), static_cast<uint32_t>(compressedChunks[ct].size()),
+				voxelSizeInBytes, filtered, &(buffer[0]), static_cast<uint32_t>(buffer.size()));
+		}
+		noOfPasses++;
+	} while (decompressTimer.elapsedTimeInSeconds() < MinimumTimeInSeconds);
+	const float decompressSeconds = decompressTimer.elapsedTimeInSeconds() / noOfPasses;
+
+	// Check the last pass actually gave us back the original data.
+	for (uint32_t ct = 0; ct < chunks.size(); ct++)
+	{
+		buffer.resize(chunks[ct].size());
+		decompressChunk(codec, useFilters, &(compressedChunks[ct][0]), static_cast<uint32_t>(compressedChunks[ct].size()),
+			voxelSizeInBytes, filtered, &(buffer[0]), static_cast<uint32_t>(buffer.size()));
+		if (memcmp(&(buffer[0]), &(chunks[ct][0]), chunks[ct].size()) != 0)
+		{
+			throw runtime_error(string("Codec '") + codec->getName() + "' did not reproduce the original data");
+		}
+	}
+
+	// Speeds are in terms of the uncompressed data, so they can be compared between codecs.
+	const double uncompressedMB = uncompressedSize / (1024.0 * 1024.0);
+	const string name = string(codec->getName()) + (useFilters ? "+filters" : "");
+	printf("  %-16s ratio %6.2f:1  %10.2f MB  compress %8.1f MB/s  decompress %8.1f MB/s\n", name.c_str(),
+		static_cast<double>(uncompressedSize) / compressedSize, compressedSize / (1024.0 * 1024.0),
+		uncompressedMB / compressSeconds, uncompressedMB / decompressSeconds);
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: ChunkCodecBenchmark <path to VDB> [<path to VDB> ...]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		for (int arg = 1; arg < argc; arg++)
+		{
+			vector< vector<uint8_t> > chunks;
+			uint32_t voxelSizeInBytes = loadChunks(argv[arg], chunks);
+			if (chunks.empty())
+			{
+				continue;
+			}
+
+			for (uint32_t compression = ChunkCompressions::Zlib; compression <= ChunkCompressions::RunLength; compression++)
+			{
+				benchmarkCodec(ChunkCodec::get(static_cast<ChunkCompression>(compression)), false, chunks, voxelSizeInBytes);
+				benchmarkCodec(ChunkCodec::get(static_cast<ChunkCompression>(compression)), true, chunks, voxelSizeInBytes);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
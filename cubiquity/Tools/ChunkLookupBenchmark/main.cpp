@@ -0,0 +1,154 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+// Measures how long a PagedVolume takes to find a chunk, both when it is already in memory and when it has to be paged in (which also
+// means evicting the least recently used chunk, as the volume is kept full). The pager does almost nothing, so the times are just the
+// cost of the volume's own bookkeeping. This is repeated for several memory limits, as the cost should not grow with the number of chunks.
+//
+// Sample command line:
+// ChunkLookupBenchmark 200000
+
+#include "PolyVox/PagedVolume.h"
+#include "PolyVox/Impl/Timer.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Used if the number of lookups is not given on the command line.
+const uint32_t DefaultNoOfLookups = 200000;
+
+// Small chunks, so that large numbers of them fit in memory.
+const uint16_t ChunkSideLength = 16;
+
+// The volume is tested with each of these limits on the number of chunks in memory.
+const uint32_t ChunkCountLimits[] = { 256, 4096, 16384 };
+
+// Chunks are visited in order through a block of this many chunks across and up, and as deep as needed.
+const int32_t ChunkGridSize = 64;
+
+typedef PolyVox::PagedVolume<uint32_t> VolumeType;
+
+// Paging in just sets one voxel, so that the chunk is not uniform and takes up its full size in memory.
+class MinimalPager : public VolumeType::Pager
+{
+public:
+	virtual void pageIn(const PolyVox::Region& /*region*/, VolumeType::Chunk* pChunk)
+	{
+		pChunk->setVoxel(0, 0, 0, 1);
+	}
+
+	virtual void pageOut(const PolyVox::Region& /*region*/, VolumeType::Chunk* /*pChunk*/)
+	{
+	}
+};
+
+// Gets a voxel from the chunk with the given index in our order of visiting them, so that every chunk is different.
+uint32_t getVoxelFromChunk(VolumeType& volume, uint32_t chunkIndex)
+{
+	int32_t x = chunkIndex % ChunkGridSize;
+	int32_t y = (chunkIndex / ChunkGridSize) % ChunkGridSize;
+	int32_t z = chunkIndex / (ChunkGridSize * ChunkGridSize);
+	return volume.getVoxel(x * ChunkSideLength, y * ChunkSideLength, z * ChunkSideLength);
+}
+
+void benchmarkLookups(uint32_t chunkCountLimit, uint32_t noOfLookups)
+{
+	const uint64_t chunkSizeInBytes = ChunkSideLength * ChunkSideLength * ChunkSideLength * sizeof(uint32_t);
+
+	MinimalPager pager;
+	VolumeType volume(&pager, chunkCountLimit * chunkSizeInBytes, ChunkSideLength);
+
+	// Fill the volume up, so that every miss from here on has to evict a chunk.
+	uint32_t nextChunk = 0;
+	uint32_t checksum = 0;
+	for (; nextChunk < chunkCountLimit; nextChunk++)
+	{
+		checksum += getVoxelFromChunk(volume, nextChunk);
+	}
+
+	// Each lookup is of a chunk we haven't seen before.
+	PolyVox::Timer missTimer;
+	for (uint32_t ct = 0; ct < noOfLookups; ct++, nextChunk++)
+	{
+		checksum += getVoxelFromChunk(volume, nextChunk);
+	}
+	const float missSeconds = missTimer.elapsedTimeInSeconds();
+
+	// The most recent half of the chunks are certainly still in memory. Picking them at random means that each lookup is (almost always)
+	// a different chunk from the last one, so the volume can't just return the chunk it found last time.
+	mt19937 generator(12345);
+	uniform_int_distribution<uint32_t> distribution(nextChunk - chunkCountLimit / 2, nextChunk - 1);
+	PolyVox::Timer hitTimer;
+	for (uint32_t ct = 0; ct < noOfLookups; ct++)
+	{
+		checksum += getVoxelFromChunk(volume, distribution(generator));
+	}
+	const float hitSeconds = hitTimer.elapsedTimeInSeconds();
+
+	// Every chunk had one voxel set, so this stops the lookups being optimised away and checks that they all went through the pager.
+	if (checksum != chunkCountLimit + noOfLookups * 2)
+	{
+		throw runtime_error("Some lookups returned the wrong value");
+	}
+
+	cout << "\t" << chunkCountLimit << " chunks: " << (missSeconds * 1000000.0f) / noOfLookups << " us per miss, "
+		<< (hitSeconds * 1000000.0f) / noOfLookups << " us per hit" << endl;
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc > 2)
+	{
+		cout << "Usage: ChunkLookupBenchmark [<number of lookups>]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		const uint32_t noOfLookups = (argc > 1) ? static_cast<uint32_t>(stoul(argv[1])) : DefaultNoOfLookups;
+		if (noOfLookups == 0)
+		{
+			throw invalid_argument("The number of lookups must be greater than zero");
+		}
+
+		cout << noOfLookups << " lookups of " << ChunkSideLength << "^3 chunks" << endl;
+		for (uint32_t chunkCountLimit : ChunkCountLimits)
+		{
+			benchmarkLookups(chunkCountLimit, noOfLookups);
+		}
+	}
+	catch (const exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,515 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+
+// Reports how long it takes to read chunks from a voxel database under each of the database profiles, both on their own and while another
+// connection is writing to the same database (as happens when two volumes share a VDB). Each profile gets it's own copy of the database, so
+// that they all start out the same. The chunks are read in a random order but aren't decompressed, as that doesn't depend on the profile.
+//
+// Finally every chunk is paged in through the VoxelDatabase (decompressed and reordered, as for a volume), counting the time and the number
+// of memory allocations for each. Once the buffers have grown to fit, a page-in shouldn't need to allocate anything apart from within SQLite.
+//
+// Sample command line:
+// DatabaseBenchmark "C:\code\cubiquity\Data\VoxelDatabases\Version 0\VoxeliensTerrain.vdb" "C:\code\cubiquity\Data\VoxelDatabases\Version 0\SmoothVoxeliensTerrain.vdb"
+
+#include "Color.h"
+#include "DatabaseProfile.h"
+#include "MaterialSet.h"
+#include "VoxelDatabase.h"
+
+#include "PolyVox/Impl/Timer.h"
+
+#include "SQLite/sqlite3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Cubiquity;
+using namespace std;
+
+// The chunks are read this many times after the first (cold) pass, to get stable timings.
+const uint32_t NoOfWarmPasses = 4;
+
+// While another connection is writing we keep reading until at least this long has passed, so that the writer gets going.
+const float MinimumContendedTimeInSeconds = 0.5f;
+
+// The writer commits this many chunks at a time, like accepting a batch of override chunks.
+const uint32_t ChunksPerWriteTransaction = 64;
+
+// Counts all the allocations made by the benchmark, so that we can see how many there are during each page-in.
+atomic<uint64_t> gNoOfAllocations(0);
+
+void* operator new(size_t size)
+{
+	gNoOfAllocations++;
+	void* ptr = malloc(size ? size : 1);
+	if (ptr == 0)
+	{
+		throw bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+// SQLite doesn't use 'new', so it's allocations are counted separately by wrapping it's allocator.
+atomic<uint64_t> gNoOfSQLiteAllocations(0);
+sqlite3_mem_methods gDefaultSQLiteMemMethods;
+
+void* countingSQLiteMalloc(int size)
+{
+	gNoOfSQLiteAllocations++;
+	return gDefaultSQLiteMemMethods.xMalloc(size);
+}
+
+void* countingSQLiteRealloc(void* ptr, int size)
+{
+	gNoOfSQLiteAllocations++;
+	return gDefaultSQLiteMemMethods.xRealloc(ptr, size);
+}
+
+// Must be called before SQLite is used.
+void countSQLiteAllocations(void)
+{
+	sqlite3_config(SQLITE_CONFIG_GETMALLOC, &gDefaultSQLiteMemMethods);
+	sqlite3_mem_methods memMethods = gDefaultSQLiteMemMethods;
+	memMethods.xMalloc = countingSQLiteMalloc;
+	memMethods.xRealloc = countingSQLiteRealloc;
+	sqlite3_config(SQLITE_CONFIG_MALLOC, &memMethods);
+}
+
+void execute(sqlite3* database, const string& sql)
+{
+	char* errorMessage = 0;
+	if (sqlite3_exec(database, sql.c_str(), 0, 0, &errorMessage) != SQLITE_OK)
+	{
+		string message = string("'") + sql + "' failed: " + (errorMessage ? errorMessage : "unknown error");
+		sqlite3_free(errorMessage);
+		throw runtime_error(message);
+	}
+}
+
+sqlite3* openDatabase(const string& path, int flags)
+{
+	sqlite3* database = 0;
+	if (sqlite3_open_v2(path.c_str(), &database, flags, NULL) != SQLITE_OK)
+	{
+		sqlite3_close(database);
+		throw runtime_error("Failed to open '" + path + "'");
+	}
+	return database;
+}
+
+void removeDatabase(const string& path)
+{
+	remove(path.c_str());
+	remove((path + "-journal").c_str());
+	remove((path + "-wal").c_str());
+	remove((path + "-shm").c_str());
+}
+
+// Copies the chunks into a new database with the same tables as the VoxelDatabase creates.
+void copyDatabase(const string& srcPath, const string& dstPath)
+{
+	removeDatabase(dstPath);
+	sqlite3* database = openDatabase(dstPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+	execute(database, "CREATE TABLE Properties(Name TEXT PRIMARY KEY, Value TEXT);");
+	execute(database, "CREATE TABLE Blocks(Region INTEGER PRIMARY KEY ASC, Data BLOB);");
+	execute(database, "ATTACH DATABASE '" + srcPath + "' AS source;");
+	execute(database, "INSERT INTO Properties SELECT Name, Value FROM source.Properties;");
+	execute(database, "INSERT INTO Blocks SELECT Region, Data FROM source.Blocks;");
+	execute(database, "DETACH DATABASE source;");
+	sqlite3_close(database);
+}
+
+vector<int64_t> loadKeys(sqlite3* database)
+{
+	vector<int64_t> keys;
+	sqlite3_stmt* statement = 0;
+	sqlite3_prepare_v2(database, "SELECT Region FROM Blocks", -1, &statement, NULL);
+	while (sqlite3_step(statement) == SQLITE_ROW)
+	{
+		keys.push_back(sqlite3_column_int64(statement, 0));
+	}
+	sqlite3_finalize(statement);
+
+	// A fixed seed so that every profile reads the chunks in the same order.
+	shuffle(keys.begin(), keys.end(), mt19937(0));
+	return keys;
+}
+
+struct Latencies
+{
+	Latencies() :noOfBusyReads(0) {}
+
+	vector<float> microseconds;
+	uint32_t noOfBusyReads;
+};
+
+// Reads each chunk in the same way as VoxelDatabase::pageIn(), copying the data out as the batched version does.
+void readChunks(sqlite3* database, const vector<int64_t>& keys, Latencies& latencies)
+{
+	sqlite3_stmt* statement = 0;
+	sqlite3_prepare_v2(database, "SELECT Data FROM Blocks WHERE Region = ?", -1, &statement, NULL);
+	vector<uint8_t> data;
+	for (uint32_t ct = 0; ct < keys.size(); ct++)
+	{
+		PolyVox::Timer timer;
+		sqlite3_reset(statement);
+		sqlite3_bind_int64(statement, 1, keys[ct]);
+		int result = sqlite3_step(statement);
+		if (result == SQLITE_ROW)
+		{
+			const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(statement, 0));
+			data.assign(blob, blob + sqlite3_column_bytes(statement, 0));
+			latencies.microseconds.push_back(timer.elapsedTimeInMicroSeconds());
+		}
+		else if (result == SQLITE_BUSY)
+		{
+			latencies.noOfBusyReads++;
+		}
+	}
+	sqlite3_finalize(statement);
+}
+
+// Keeps rewriting the chunks (with the same data) until told to stop.
+void writeChunks(sqlite3* database, const vector<int64_t>& keys, const atomic<bool>& stop, atomic<uint32_t>& noOfChunksWritten)
+{
+	vector< vector<uint8_t> > chunks(keys.size());
+	sqlite3_stmt* select = 0;
+	sqlite3_prepare_v2(database, "SELECT Data FROM Blocks WHERE Region = ?", -1, &select, NULL);
+	for (uint32_t ct = 0; ct < keys.size(); ct++)
+	{
+		sqlite3_reset(select);
+		sqlite3_bind_int64(select, 1, keys[ct]);
+		if (sqlite3_step(select) == SQLITE_ROW)
+		{
+			const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(select, 0));
+			chunks[ct].assign(blob, blob + sqlite3_column_bytes(select, 0));
+		}
+	}
+	sqlite3_finalize(select);
+
+	sqlite3_stmt* insert = 0;
+	sqlite3_prepare_v2(database, "INSERT OR REPLACE INTO Blocks (Region, Data) VALUES (?, ?)", -1, &insert, NULL);
+	uint32_t index = 0;
+	while (!stop)
+	{
+		if (sqlite3_exec(database, "BEGIN TRANSACTION;", 0, 0, 0) != SQLITE_OK)
+		{
+			continue;
+		}
+		for (uint32_t ct = 0; ct < ChunksPerWriteTransaction; ct++, index = (index + 1) % keys.size())
+		{
+			sqlite3_reset(insert);
+			sqlite3_bind_int64(insert, 1, keys[index]);
+			sqlite3_bind_blob(insert, 2, chunks[index].empty() ? 0 : &(chunks[index][0]), static_cast<int>(chunks[index].size()), SQLITE_STATIC);
+			sqlite3_step(insert);
+		}
+		// Readers can stop us committing in the normal journal mode, in which case we throw the batch away and try again.
+		if (sqlite3_exec(database, "COMMIT TRANSACTION;", 0, 0, 0) == SQLITE_OK)
+		{
+			noOfChunksWritten += ChunksPerWriteTransaction;
+		}
+		else
+		{
+			sqlite3_exec(database, "ROLLBACK TRANSACTION;", 0, 0, 0);
+		}
+	}
+	sqlite3_reset(insert);
+	sqlite3_finalize(insert);
+}
+
+void printLatencies(const char* name, Latencies& latencies)
+{
+	vector<float>& times = latencies.microseconds;
+	if (times.empty())
+	{
+		printf("    %-18s no chunks read, %u busy\n", name, latencies.noOfBusyReads);
+		return;
+	}
+
+	sort(times.begin(), times.end());
+	double total = 0.0;
+	for (uint32_t ct = 0; ct < times.size(); ct++)
+	{
+		total += times[ct];
+	}
+	printf("    %-18s mean %8.1f us  median %8.1f us  99th %8.1f us  max %9.1f us  busy %u\n", name, total / times.size(),
+		times[times.size() / 2], times[(times.size() * 99) / 100], times.back(), latencies.noOfBusyReads);
+}
+
+string getProperty(sqlite3* database, const string& name, const string& defaultValue)
+{
+	string value = defaultValue;
+	sqlite3_stmt* statement = 0;
+	if (sqlite3_prepare_v2(database, "SELECT Value FROM Properties WHERE Name = ?", -1, &statement, NULL) == SQLITE_OK)
+	{
+		sqlite3_bind_text(statement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+		if (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			value = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+		}
+	}
+	sqlite3_finalize(statement);
+	return value;
+}
+
+// Passes the page-ins on to the database, and keeps track of how long they take and how many allocations they make.
+template <typename VoxelType>
+class CountingPager : public PolyVox::PagedVolume<VoxelType>::Pager
+{
+public:
+	CountingPager(VoxelDatabase<VoxelType>* database)
+		:mDatabase(database)
+		,mNoOfAllocations(0)
+		,mNoOfSQLiteAllocations(0)
+	{
+	}
+
+	virtual void pageIn(const PolyVox::Region& region, typename PolyVox::PagedVolume<VoxelType>::Chunk* pChunk)
+	{
+		const uint64_t noOfAllocations = gNoOfAllocations;
+		const uint64_t noOfSQLiteAllocations = gNoOfSQLiteAllocations;
+		PolyVox::Timer timer;
+		mDatabase->pageIn(region, pChunk);
+		mMicroseconds.push_back(timer.elapsedTimeInMicroSeconds());
+		mNoOfAllocations += gNoOfAllocations - noOfAllocations;
+		mNoOfSQLiteAllocations += gNoOfSQLiteAllocations - noOfSQLiteAllocations;
+	}
+
+	virtual void pageOut(const PolyVox::Region& /*region*/, typename PolyVox::PagedVolume<VoxelType>::Chunk* /*pChunk*/)
+	{
+	}
+
+	void print(const char* name)
+	{
+		Latencies latencies;
+		latencies.microseconds.swap(mMicroseconds);
+		const size_t noOfPageIns = latencies.microseconds.size();
+		printLatencies(name, latencies);
+		if (noOfPageIns > 0)
+		{
+			printf("    %-18s %.2f allocations per page-in (%.2f by SQLite)\n", "", static_cast<double>(mNoOfAllocations + mNoOfSQLiteAllocations) / noOfPageIns,
+				static_cast<double>(mNoOfSQLiteAllocations) / noOfPageIns);
+		}
+		mNoOfAllocations = 0;
+		mNoOfSQLiteAllocations = 0;
+	}
+
+private:
+	VoxelDatabase<VoxelType>* mDatabase;
+	vector<float> mMicroseconds;
+	uint64_t mNoOfAllocations;
+	uint64_t mNoOfSQLiteAllocations;
+};
+
+int32_t floorDivide(int32_t value, int32_t divisor)
+{
+	return (value >= 0) ? (value / divisor) : -((-value + divisor - 1) / divisor);
+}
+
+// Pages in every chunk of the volume through the VoxelDatabase, as a volume would.
+template <typename VoxelType>
+void benchmarkPageIn(const string& path, DatabaseProfile profile)
+{
+	sqlite3* properties = openDatabase(path, SQLITE_OPEN_READONLY);
+	const int32_t chunkSideLength = atoi(getProperty(properties, "chunkSideLength", "32").c_str());
+	const ChunkCodec* codec = ChunkCodec::find(getProperty(properties, "chunkCodec", "zlib"));
+	const bool useFilters = atoi(getProperty(properties, "chunkFilters", "0").c_str()) != 0;
+	const int32_t lowerX = floorDivide(atoi(getProperty(properties, "lowerX", "0").c_str()), chunkSideLength);
+	const int32_t lowerY = floorDivide(atoi(getProperty(properties, "lowerY", "0").c_str()), chunkSideLength);
+	const int32_t lowerZ = floorDivide(atoi(getProperty(properties, "lowerZ", "0").c_str()), chunkSideLength);
+	const int32_t upperX = floorDivide(atoi(getProperty(properties, "upperX", "512").c_str()), chunkSideLength);
+	const int32_t upperY = floorDivide(atoi(getProperty(properties, "upperY", "512").c_str()), chunkSideLength);
+	const int32_t upperZ = floorDivide(atoi(getProperty(properties, "upperZ", "512").c_str()), chunkSideLength);
+	sqlite3_close(properties);
+	if (codec == 0)
+	{
+		throw runtime_error("Unrecognised chunk codec in '" + path + "'");
+	}
+
+	VoxelDatabase<VoxelType>* database = VoxelDatabase<VoxelType>::createFromVDB(path, WritePermissions::ReadOnly, profile);
+	database->setChunkCodec(codec);
+	database->setUseChunkFilters(useFilters);
+	CountingPager<VoxelType> pager(database);
+
+	// The first pass also fills the memory pools and grows the buffers, so only the later ones show the steady state.
+	for (uint32_t pass = 0; pass <= NoOfWarmPasses; pass++)
+	{
+		for (int32_t z = lowerZ; z <= upperZ; z++)
+		{
+			for (int32_t y = lowerY; y <= upperY; y++)
+			{
+				for (int32_t x = lowerX; x <= upperX; x++)
+				{
+					// Creating a chunk pages it in.
+					delete new typename PolyVox::PagedVolume<VoxelType>::Chunk(PolyVox::Vector3DInt32(x, y, z), static_cast<uint16_t>(chunkSideLength), &pager);
+				}
+			}
+		}
+		if (pass == 0)
+		{
+			pager.print("page-in cold");
+		}
+	}
+	pager.print("page-in warm");
+
+	delete database;
+}
+
+void benchmarkProfile(const string& srcPath, DatabaseProfile profile, const char* profileName)
+{
+	const string path = srcPath + ".benchmark";
+	copyDatabase(srcPath, path);
+
+	printf("  %s\n", profileName);
+
+	// A new connection has an empty page cache, so the first pass shows the cost of the first read of each chunk. The file is
+	// probably still in the operating system's cache though, so this is the best case for a chunk which has not been read before.
+	{
+		sqlite3* database = openDatabase(path, SQLITE_OPEN_READWRITE);
+		applyDatabaseProfile(database, profile);
+		const vector<int64_t> keys = loadKeys(database);
+
+		Latencies cold;
+		readChunks(database, keys, cold);
+		printLatencies("cold", cold);
+
+		Latencies warm;
+		for (uint32_t pass = 0; pass < NoOfWarmPasses; pass++)
+		{
+			readChunks(database, keys, warm);
+		}
+		printLatencies("warm", warm);
+
+		restoreRollbackJournal(database);
+		sqlite3_close(database);
+	}
+
+	// Now read while a second connection writes, which is where the journal mode matters.
+	{
+		sqlite3* writer = openDatabase(path, SQLITE_OPEN_READWRITE);
+		applyDatabaseProfile(writer, profile);
+		sqlite3* reader = openDatabase(path, SQLITE_OPEN_READWRITE);
+		applyDatabaseProfile(reader, profile);
+		const vector<int64_t> keys = loadKeys(reader);
+
+		atomic<bool> stop(false);
+		atomic<uint32_t> noOfChunksWritten(0);
+		thread writerThread(writeChunks, writer, cref(keys), cref(stop), ref(noOfChunksWritten));
+
+		PolyVox::Timer timer;
+		Latencies contended;
+		do
+		{
+			readChunks(reader, keys, contended);
+		} while (timer.elapsedTimeInSeconds() < MinimumContendedTimeInSeconds);
+		const float seconds = timer.elapsedTimeInSeconds();
+		stop = true;
+		writerThread.join();
+
+		printLatencies("while writing", contended);
+		printf("    %-18s %.0f chunks/s written\n", "", noOfChunksWritten / seconds);
+
+		sqlite3_close(reader);
+		restoreRollbackJournal(writer);
+		sqlite3_close(writer);
+	}
+
+	// Rewriting the chunks leaves the database fragmented, so this is roughly what vacuuming on close costs.
+	{
+		sqlite3* database = openDatabase(path, SQLITE_OPEN_READWRITE);
+		applyDatabaseProfile(database, profile);
+		PolyVox::Timer timer;
+		execute(database, "VACUUM;");
+		printf("    %-18s %.1f ms\n", "vacuum", timer.elapsedTimeInMilliSeconds());
+		restoreRollbackJournal(database);
+		sqlite3_close(database);
+	}
+
+	sqlite3* database = openDatabase(path, SQLITE_OPEN_READONLY);
+	const string voxelType = getProperty(database, "VoxelType", "");
+	sqlite3_close(database);
+	if (voxelType == "Color")
+	{
+		benchmarkPageIn<Color>(path, profile);
+	}
+	else if (voxelType == "MaterialSet")
+	{
+		benchmarkPageIn<MaterialSet>(path, profile);
+	}
+
+	removeDatabase(path);
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: DatabaseBenchmark <path to VDB> [<path to VDB> ...]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	countSQLiteAllocations();
+
+	try
+	{
+		for (int arg = 1; arg < argc; arg++)
+		{
+			cout << argv[arg] << endl;
+			benchmarkProfile(argv[arg], DatabaseProfiles::Compatible, "Compatible");
+			benchmarkProfile(argv[arg], DatabaseProfiles::Fast, "Fast");
+		}
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+// Measures the throughput of the concurrent_queue with 1, 4 and 16 threads pushing into it while a few others pop, which is roughly
+// what happens when the main thread and the workers are all adding tasks. The consumers either pop one item at a time or take them in
+// batches, and the same total number of items goes through the queue in each run so that the rates can be compared directly.
+//
+// Sample command line:
+// QueueBenchmark 1000000
+
+#include "ConcurrentQueue.h"
+
+#include "PolyVox/Impl/Timer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Cubiquity;
+using namespace std;
+
+// Used if the number of items is not given on the command line.
+const uint32_t DefaultNoOfItems = 1000000;
+
+// The number of threads popping items. This matches a typical number of background workers.
+const uint32_t NoOfConsumers = 4;
+
+// The most items a consumer takes at once when popping in batches.
+const uint32_t BatchSize = 16;
+
+// Each run is repeated and the fastest is reported, as the first can be slowed down by the threads starting up.
+const uint32_t NoOfRepetitions = 3;
+
+// Stands in for a task. The queue holds pointers and orders them by priority, in the same way as it does for tasks.
+struct Item
+{
+	uint32_t mPriority;
+};
+
+class ItemSortCriterion
+{
+public:
+	bool operator()(const Item* item1, const Item* item2) const
+	{
+		return item1->mPriority < item2->mPriority;
+	}
+};
+
+typedef concurrent_queue<Item*, ItemSortCriterion> ItemQueue;
+
+void produce(ItemQueue* queue, Item* items, uint32_t noOfItems, atomic<bool>* start)
+{
+	while (!start->load())
+	{
+		this_thread::yield();
+	}
+
+	for (uint32_t ct = 0; ct < noOfItems; ct++)
+	{
+		queue->push(&(items[ct]));
+	}
+}
+
+void consume(ItemQueue* queue, bool useBatches, uint32_t noOfItems, atomic<uint32_t>* noOfPoppedItems, atomic<bool>* start)
+{
+	while (!start->load())
+	{
+		this_thread::yield();
+	}
+
+	vector<Item*> poppedItems;
+	poppedItems.reserve(BatchSize);
+	while (noOfPoppedItems->load() < noOfItems)
+	{
+		uint32_t noOfPopped = 0;
+		if (useBatches)
+		{
+			poppedItems.clear();
+			noOfPopped = queue->try_pop_batch(poppedItems, BatchSize);
+		}
+		else
+		{
+			Item* item = 0;
+			noOfPopped = queue->try_pop(item) ? 1 : 0;
+		}
+
+		if (noOfPopped > 0)
+		{
+			noOfPoppedItems->fetch_add(noOfPopped);
+		}
+		else
+		{
+			// The producers are behind, so give them a chance rather than spinning on the lock.
+			this_thread::yield();
+		}
+	}
+}
+
+// Returns the number of items which went through the queue per second.
+double runBenchmark(uint32_t noOfProducers, bool useBatches, vector<Item>& items)
+{
+	const uint32_t noOfItems = static_cast<uint32_t>(items.size());
+	const uint32_t itemsPerProducer = noOfItems / noOfProducers;
+
+	ItemQueue queue;
+	atomic<bool> start(false);
+	atomic<uint32_t> noOfPoppedItems(0);
+
+	vector<thread> threads;
+	for (uint32_t ct = 0; ct < noOfProducers; ct++)
+	{
+		// The last producer also pushes whatever is left over from the division.
+		uint32_t count = (ct == noOfProducers - 1) ? noOfItems - (itemsPerProducer * ct) : itemsPerProducer;
+		threads.push_back(thread(produce, &queue, &(items[itemsPerProducer * ct]), count, &start));
+	}
+	for (uint32_t ct = 0; ct < NoOfConsumers; ct++)
+	{
+		threads.push_back(thread(consume, &queue, useBatches, noOfItems, &noOfPoppedItems, &start));
+	}
+
+	PolyVox::Timer timer;
+	start = true;
+	for (uint32_t ct = 0; ct < threads.size(); ct++)
+	{
+		threads[ct].join();
+	}
+	const float seconds = timer.elapsedTimeInSeconds();
+
+	if (noOfPoppedItems.load() != noOfItems || !queue.empty())
+	{
+		throw runtime_error("Not every item came back out of the queue");
+	}
+
+	return noOfItems / seconds;
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc > 2)
+	{
+		cout << "Usage: QueueBenchmark [<number of items>]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		const uint32_t noOfItems = (argc > 1) ? static_cast<uint32_t>(stoul(argv[1])) : DefaultNoOfItems;
+		if (noOfItems == 0)
+		{
+			throw invalid_argument("The number of items must be greater than zero");
+		}
+
+		// Random priorities, so the heap has some work to do.
+		vector<Item> items(noOfItems);
+		mt19937 generator(12345);
+		for (uint32_t ct = 0; ct < noOfItems; ct++)
+		{
+			items[ct].mPriority = generator();
+		}
+
+		cout << noOfItems << " items, " << NoOfConsumers << " consumers" << endl;
+
+		const uint32_t producerCounts[] = { 1, 4, 16 };
+		for (uint32_t producerCount : producerCounts)
+		{
+			for (int useBatches = 0; useBatches < 2; useBatches++)
+			{
+				double bestItemsPerSecond = 0.0;
+				for (uint32_t repetition = 0; repetition < NoOfRepetitions; repetition++)
+				{
+					double itemsPerSecond = runBenchmark(producerCount, useBatches != 0, items);
+					bestItemsPerSecond = (itemsPerSecond > bestItemsPerSecond) ? itemsPerSecond : bestItemsPerSecond;
+				}
+
+				cout << "\t" << producerCount << " producer(s), " << (useBatches ? "try_pop_batch()" : "try_pop()      ") << ": "
+					<< bestItemsPerSecond / 1000000.0 << " million items per second" << endl;
+			}
+		}
+	}
+	catch (const exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
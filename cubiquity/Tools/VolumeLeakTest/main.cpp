@@ -0,0 +1,217 @@
+/*******************************************************************************
+* The MIT License (MIT)
+*
+* Copyright (c) 2016 David Williams and Matthew Williams
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+// Opens and closes volumes thousands of times, checking that the memory used by the process stays steady. Each volume is given a few
+// updates before it is deleted, so that it is usually destroyed while surface extraction tasks are still queued or running on the
+// background threads. Every so often a temporary volume is created and written to as well, so that there are modified chunks to discard.
+//
+// The memory is measured once the first iterations have warmed up the caches and memory pools, and again at the end. If it has grown by
+// more than a small allowance then the test fails. This only works on Windows and Linux, as elsewhere we don't know how to measure it.
+//
+// Sample command line:
+// VolumeLeakTest "C:\code\cubiquity\Data\VoxelDatabases\Version 0\VoxeliensTerrain.vdb" 5000
+
+#include "CubiquityC.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+	#include <windows.h>
+	#include <psapi.h>
+#elif defined(__linux__)
+	#include <fstream>
+#endif
+
+using namespace std;
+
+// The memory is measured after this fraction of the iterations.
+const uint32_t WarmUpFraction = 10;
+
+// How much the memory is allowed to grow by between the warm up and the end. Leaking the PagedVolume alone would use this up within a few
+// hundred iterations, but it leaves room for the heap to be a little more fragmented than it was.
+const uint64_t AllowedGrowthInBytes = 16 * 1024 * 1024;
+
+// How many updates each volume gets. These are given no time on the main thread, so the tasks are mostly still in progress at the end.
+const uint32_t NoOfUpdatesPerVolume = 4;
+
+// Every this many iterations we also create a temporary volume and write to it.
+const uint32_t TemporaryVolumeInterval = 16;
+
+void validate(int returnCode)
+{
+	if (returnCode != CU_OK)
+	{
+		throw runtime_error(string(cuGetErrorCodeAsString(returnCode)) + " : " + cuGetLastErrorMessage());
+	}
+}
+
+// Returns zero if we don't know how to find out.
+uint64_t getResidentMemoryInBytes(void)
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize;
+	}
+#elif defined(__linux__)
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0)
+		{
+			return strtoull(line.c_str() + 6, 0, 10) * 1024;
+		}
+	}
+#endif
+	return 0;
+}
+
+// The path can be to either type of volume, so we try each in turn. This is only done once, as the failure gets logged.
+bool isTerrainVDB(const string& path)
+{
+	uint32_t volumeHandle;
+	if (cuNewColoredCubesVolumeFromVDB(path.c_str(), CU_READONLY, 32, &volumeHandle) == CU_OK)
+	{
+		validate(cuDeleteVolume(volumeHandle));
+		return false;
+	}
+
+	validate(cuNewTerrainVolumeFromVDB(path.c_str(), CU_READONLY, 32, &volumeHandle));
+	validate(cuDeleteVolume(volumeHandle));
+	return true;
+}
+
+void openAndCloseVolume(const string& path, bool isTerrain)
+{
+	uint32_t volumeHandle;
+	if (isTerrain)
+	{
+		validate(cuNewTerrainVolumeFromVDB(path.c_str(), CU_READONLY, 32, &volumeHandle));
+	}
+	else
+	{
+		validate(cuNewColoredCubesVolumeFromVDB(path.c_str(), CU_READONLY, 32, &volumeHandle));
+	}
+
+	int32_t lowerX, lowerY, lowerZ, upperX, upperY, upperZ;
+	validate(cuGetEnclosingRegion(volumeHandle, &lowerX, &lowerY, &lowerZ, &upperX, &upperY, &upperZ));
+
+	for (uint32_t update = 0; update < NoOfUpdatesPerVolume; update++)
+	{
+		uint32_t isUpToDate;
+		validate(cuUpdateVolumeWithBudget(volumeHandle, (lowerX + upperX) / 2.0f, upperY + 10.0f, (lowerZ + upperZ) / 2.0f, 1.0f, 0, &isUpToDate));
+	}
+
+	validate(cuDeleteVolume(volumeHandle));
+}
+
+void createAndCloseTemporaryVolume(void)
+{
+	// An empty path means a temporary database, which is deleted along with the volume.
+	uint32_t volumeHandle;
+	validate(cuNewEmptyColoredCubesVolume(0, 0, 0, 63, 31, 63, "", 32, &volumeHandle));
+
+	CuColor color = cuMakeColor(255, 0, 0, 255);
+	for (int32_t z = 0; z < 64; z++)
+	{
+		for (int32_t x = 0; x < 64; x++)
+		{
+			validate(cuSetVoxel(volumeHandle, x, 0, z, &color));
+		}
+	}
+
+	uint32_t isUpToDate;
+	validate(cuUpdateVolumeWithBudget(volumeHandle, 32.0f, 40.0f, 32.0f, 1.0f, 0, &isUpToDate));
+	validate(cuDeleteVolume(volumeHandle));
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: VolumeLeakTest <path to VDB> [<number of iterations>]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	const string path = argv[1];
+	const uint32_t noOfIterations = (argc > 2) ? static_cast<uint32_t>(atoi(argv[2])) : 5000;
+	const uint32_t noOfWarmUpIterations = noOfIterations / WarmUpFraction;
+
+	try
+	{
+		const bool isTerrain = isTerrainVDB(path);
+
+		uint64_t warmResidentMemoryInBytes = 0;
+		for (uint32_t iteration = 0; iteration < noOfIterations; iteration++)
+		{
+			if (iteration == noOfWarmUpIterations)
+			{
+				warmResidentMemoryInBytes = getResidentMemoryInBytes();
+			}
+
+			openAndCloseVolume(path, isTerrain);
+			if (iteration % TemporaryVolumeInterval == 0)
+			{
+				createAndCloseTemporaryVolume();
+			}
+
+			if ((iteration % 500 == 0) || (iteration == noOfIterations - 1))
+			{
+				uint64_t usageInBytes;
+				validate(cuGetProcessMemoryUsage(&usageInBytes));
+				printf("Iteration %u: resident memory = %.1fMb, Cubiquity memory usage = %.1fMb\n", iteration,
+					getResidentMemoryInBytes() / (1024.0 * 1024.0), usageInBytes / (1024.0 * 1024.0));
+			}
+		}
+
+		const uint64_t finalResidentMemoryInBytes = getResidentMemoryInBytes();
+		if ((warmResidentMemoryInBytes == 0) || (finalResidentMemoryInBytes == 0))
+		{
+			cout << "Resident memory can't be measured on this platform, so leaks can't be detected." << endl;
+			return EXIT_SUCCESS;
+		}
+
+		const double growthInMb = (static_cast<double>(finalResidentMemoryInBytes) - static_cast<double>(warmResidentMemoryInBytes)) / (1024.0 * 1024.0);
+		printf("Resident memory grew by %.1fMb after the first %u iterations\n", growthInMb, noOfWarmUpIterations);
+		if (finalResidentMemoryInBytes > warmResidentMemoryInBytes + AllowedGrowthInBytes)
+		{
+			cout << "FAILED: Resident memory grew by more than " << AllowedGrowthInBytes / (1024 * 1024) << "Mb" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Error: " << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "PASSED" << endl;
+	return EXIT_SUCCESS;
+}